@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	AlignedAllocator.h
+//	------------------------
+//
+//	An allocator for vectors aligned to a SIMD
+//	register width or a cache line
+//
+///////////////////////////////////////////////////
+
+#ifndef _ALIGNED_ALLOCATOR_H
+#define _ALIGNED_ALLOCATOR_H
+
+#include <vector>
+#include <new>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// minimal allocator that aligns to a SIMD register width
+template <typename T, int Alignment>
+class AlignedAllocator
+	{ // class AlignedAllocator
+	public:
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+		{ // struct rebind
+		typedef AlignedAllocator<U, Alignment> other;
+		}; // struct rebind
+
+	AlignedAllocator() {}
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+	T *allocate(std::size_t n)
+		{ // allocate()
+		void *memory = NULL;
+#ifdef _WIN32
+		memory = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+		if (posix_memalign(&memory, Alignment, n * sizeof(T)) != 0)
+			memory = NULL;
+#endif
+		if (memory == NULL)
+			throw std::bad_alloc();
+		return static_cast<T *>(memory);
+		} // allocate()
+
+	void deallocate(T *pointer, std::size_t)
+		{ // deallocate()
+#ifdef _WIN32
+		_aligned_free(pointer);
+#else
+		free(pointer);
+#endif
+		} // deallocate()
+
+	template <typename U>
+	bool operator ==(const AlignedAllocator<U, Alignment> &) const { return true; }
+	template <typename U>
+	bool operator !=(const AlignedAllocator<U, Alignment> &) const { return false; }
+	}; // class AlignedAllocator
+
+// a float array aligned for AVX loads
+typedef std::vector<float, AlignedAllocator<float, 32> > FloatArray;
+
+#endif
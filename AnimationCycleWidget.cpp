@@ -100,29 +100,29 @@ void AnimationCycleWidget::keyPressEvent(QKeyEvent *event)
 	// just do a big switch statement
 	switch (event->key())
 		{ // end of key switch
-		// exit the program
+		// exit the program, saving any recording first
 		case Qt::Key_X:
-			exit(0);
-			break;
 		case Qt::Key_Escape:
+			theScene->StopRecording();
 			exit(0);
+			break;
 	
 		// camera controls
 		case Qt::Key_W:
-			theScene->EventCharacterForward();
+			theScene->KeyPressed('W');
 			break;
 
 		case Qt::Key_S:
-			theScene->EventCharacterBackward();
+			theScene->KeyPressed('S');
 			break;
 		case Qt::Key_Space:
-			theScene->ResetGame();
+			theScene->KeyPressed(' ');
 			break;
 		case Qt::Key_L:
-			theScene->SwitchLand();
+			theScene->KeyPressed('L');
 			break;
 		case Qt::Key_M:
-			theScene->SwitchModel();
+			theScene->KeyPressed('M');
 			break;
 				
 		// just in case
@@ -0,0 +1,274 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	BodyStore.cpp
+//	------------------------
+//
+//	Structure-of-arrays storage for the simulated
+//	bodies, with SIMD kernels for integration
+//
+///////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include "BodyStore.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// constructor
+BodyStore::BodyStore()
+	:
+	capacity(0)
+	{ // constructor
+	} // constructor
+
+// number of bodies stored
+int BodyStore::Size() const
+	{ // Size()
+	return (int) creationFrame.size();
+	} // Size()
+
+// remove all bodies
+void BodyStore::Clear()
+	{ // Clear()
+	creationFrame.clear();
+	positionX.clear();		positionY.clear();		positionZ.clear();
+	previousX.clear();		previousY.clear();		previousZ.clear();
+	velocityX.clear();		velocityY.clear();		velocityZ.clear();
+	angularX.clear();		angularY.clear();		angularZ.clear();
+	orientationX.clear();	orientationY.clear();	orientationZ.clear();	orientationW.clear();
+	sleepTimer.clear();
+	supportHint.clear();
+	indexToSlot.clear();
+
+	// every slot goes back on the free list, with stale handles left stale
+	freeSlots.clear();
+	for (int slot = (int) slotToIndex.size() - 1; slot >= 0; slot--)
+		{ // per slot
+		if (slotToIndex[slot] >= 0)
+			slotGeneration[slot]++;
+		slotToIndex[slot] = -1;
+		freeSlots.push_back(slot);
+		} // per slot
+	} // Clear()
+
+// set the most bodies the store will hold, allocating all the space up front
+void BodyStore::SetCapacity(int Capacity)
+	{ // SetCapacity()
+	capacity = Capacity;
+
+	creationFrame.reserve(capacity);
+	positionX.reserve(capacity);	positionY.reserve(capacity);	positionZ.reserve(capacity);
+	previousX.reserve(capacity);	previousY.reserve(capacity);	previousZ.reserve(capacity);
+	velocityX.reserve(capacity);	velocityY.reserve(capacity);	velocityZ.reserve(capacity);
+	angularX.reserve(capacity);		angularY.reserve(capacity);		angularZ.reserve(capacity);
+	orientationX.reserve(capacity);	orientationY.reserve(capacity);	orientationZ.reserve(capacity);	orientationW.reserve(capacity);
+	sleepTimer.reserve(capacity);
+	supportHint.reserve(capacity);
+	indexToSlot.reserve(capacity);
+
+	// new slots go on the free list so that the lowest is handed out first
+	int oldSlots = (int) slotToIndex.size();
+	if (capacity > oldSlots)
+		{ // more slots
+		slotToIndex.resize(capacity, -1);
+		slotGeneration.resize(capacity, 0);
+		freeSlots.reserve(capacity);
+		std::vector<int> newSlots;
+		for (int slot = capacity - 1; slot >= oldSlots; slot--)
+			newSlots.push_back(slot);
+		freeSlots.insert(freeSlots.begin(), newSlots.begin(), newSlots.end());
+		} // more slots
+	} // SetCapacity()
+
+// append a body with identity orientation at index Size() - 1
+BodyHandle BodyStore::Add(int frame, const Cartesian3 &position, const Cartesian3 &linearVelocity, const Cartesian3 &angularVelocity)
+	{ // Add()
+	BodyHandle handle;
+	if (Size() >= capacity || freeSlots.empty())
+		return handle;
+
+	// take a slot off the free list
+	handle.slot = freeSlots.back();
+	freeSlots.pop_back();
+	handle.generation = slotGeneration[handle.slot];
+	slotToIndex[handle.slot] = Size();
+	indexToSlot.push_back(handle.slot);
+
+	creationFrame.push_back(frame);
+	positionX.push_back(position.x);	positionY.push_back(position.y);	positionZ.push_back(position.z);
+	previousX.push_back(position.x);	previousY.push_back(position.y);	previousZ.push_back(position.z);
+	velocityX.push_back(linearVelocity.x);	velocityY.push_back(linearVelocity.y);	velocityZ.push_back(linearVelocity.z);
+	angularX.push_back(angularVelocity.x);	angularY.push_back(angularVelocity.y);	angularZ.push_back(angularVelocity.z);
+	orientationX.push_back(0.0);	orientationY.push_back(0.0);	orientationZ.push_back(0.0);	orientationW.push_back(1.0);
+	sleepTimer.push_back(0.0);
+	supportHint.push_back(0);
+	return handle;
+	} // Add()
+
+// find the current index of a body, or -1 if the handle is stale
+int BodyStore::IndexOf(const BodyHandle &handle) const
+	{ // IndexOf()
+	if (handle.slot < 0 || handle.slot >= (int) slotToIndex.size())
+		return -1;
+	if (slotGeneration[handle.slot] != handle.generation)
+		return -1;
+	return slotToIndex[handle.slot];
+	} // IndexOf()
+
+// the handle of the body at an index
+BodyHandle BodyStore::HandleAt(int index) const
+	{ // HandleAt()
+	BodyHandle handle;
+	handle.slot = indexToSlot[index];
+	handle.generation = slotGeneration[handle.slot];
+	return handle;
+	} // HandleAt()
+
+// remove the body at an index by moving the last body into its place
+void BodyStore::RemoveAt(int index)
+	{ // RemoveAt()
+	int last = Size() - 1;
+	if (index != last)
+		Swap(index, last);
+
+	// retire the slot, which makes any outstanding handles to it stale
+	int slot = indexToSlot[last];
+	slotToIndex[slot] = -1;
+	slotGeneration[slot]++;
+	freeSlots.push_back(slot);
+
+	creationFrame.pop_back();
+	positionX.pop_back();		positionY.pop_back();		positionZ.pop_back();
+	previousX.pop_back();		previousY.pop_back();		previousZ.pop_back();
+	velocityX.pop_back();		velocityY.pop_back();		velocityZ.pop_back();
+	angularX.pop_back();		angularY.pop_back();		angularZ.pop_back();
+	orientationX.pop_back();	orientationY.pop_back();	orientationZ.pop_back();	orientationW.pop_back();
+	sleepTimer.pop_back();
+	supportHint.pop_back();
+	indexToSlot.pop_back();
+	} // RemoveAt()
+
+// exchange two bodies
+void BodyStore::Swap(int first, int second)
+	{ // Swap()
+	std::swap(creationFrame[first], creationFrame[second]);
+	std::swap(positionX[first], positionX[second]);		std::swap(positionY[first], positionY[second]);		std::swap(positionZ[first], positionZ[second]);
+	std::swap(previousX[first], previousX[second]);		std::swap(previousY[first], previousY[second]);		std::swap(previousZ[first], previousZ[second]);
+	std::swap(velocityX[first], velocityX[second]);		std::swap(velocityY[first], velocityY[second]);		std::swap(velocityZ[first], velocityZ[second]);
+	std::swap(angularX[first], angularX[second]);		std::swap(angularY[first], angularY[second]);		std::swap(angularZ[first], angularZ[second]);
+	std::swap(orientationX[first], orientationX[second]);	std::swap(orientationY[first], orientationY[second]);
+	std::swap(orientationZ[first], orientationZ[second]);	std::swap(orientationW[first], orientationW[second]);
+	std::swap(sleepTimer[first], sleepTimer[second]);
+	std::swap(supportHint[first], supportHint[second]);
+
+	// and keep the slots pointing at the right places
+	std::swap(indexToSlot[first], indexToSlot[second]);
+	slotToIndex[indexToSlot[first]] = first;
+	slotToIndex[indexToSlot[second]] = second;
+	} // Swap()
+
+// accessors that gather a body's fields back into vectors
+Cartesian3 BodyStore::Position(int index) const
+	{ // Position()
+	return Cartesian3(positionX[index], positionY[index], positionZ[index]);
+	} // Position()
+
+Cartesian3 BodyStore::PreviousPosition(int index) const
+	{ // PreviousPosition()
+	return Cartesian3(previousX[index], previousY[index], previousZ[index]);
+	} // PreviousPosition()
+
+Cartesian3 BodyStore::LinearVelocity(int index) const
+	{ // LinearVelocity()
+	return Cartesian3(velocityX[index], velocityY[index], velocityZ[index]);
+	} // LinearVelocity()
+
+Cartesian3 BodyStore::AngularVelocity(int index) const
+	{ // AngularVelocity()
+	return Cartesian3(angularX[index], angularY[index], angularZ[index]);
+	} // AngularVelocity()
+
+Quaternion BodyStore::Orientation(int index) const
+	{ // Orientation()
+	return Quaternion(orientationX[index], orientationY[index], orientationZ[index], orientationW[index]);
+	} // Orientation()
+
+Matrix4 BodyStore::OrientationMatrix(int index) const
+	{ // OrientationMatrix()
+	return Orientation(index).GetMatrix();
+	} // OrientationMatrix()
+
+// and the matching setters
+void BodyStore::SetPosition(int index, const Cartesian3 &value)
+	{ // SetPosition()
+	positionX[index] = value.x;	positionY[index] = value.y;	positionZ[index] = value.z;
+	} // SetPosition()
+
+void BodyStore::SetLinearVelocity(int index, const Cartesian3 &value)
+	{ // SetLinearVelocity()
+	velocityX[index] = value.x;	velocityY[index] = value.y;	velocityZ[index] = value.z;
+	} // SetLinearVelocity()
+
+void BodyStore::SetAngularVelocity(int index, const Cartesian3 &value)
+	{ // SetAngularVelocity()
+	angularX[index] = value.x;	angularY[index] = value.y;	angularZ[index] = value.z;
+	} // SetAngularVelocity()
+
+void BodyStore::SetOrientation(int index, const Quaternion &value)
+	{ // SetOrientation()
+	orientationX[index] = value.coords.x;
+	orientationY[index] = value.coords.y;
+	orientationZ[index] = value.coords.z;
+	orientationW[index] = value.coords.w;
+	} // SetOrientation()
+
+// v = v + a * dt for every entry, a being constant
+void IntegrateConstantAcceleration(float *velocity, int count, float acceleration, float dt)
+	{ // IntegrateConstantAcceleration()
+	float deltaV = acceleration * dt;
+	int i = 0;
+#if defined(__AVX__)
+	__m256 deltaV8 = _mm256_set1_ps(deltaV);
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(velocity + i, _mm256_add_ps(_mm256_loadu_ps(velocity + i), deltaV8));
+#elif defined(__SSE2__)
+	__m128 deltaV4 = _mm_set1_ps(deltaV);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(velocity + i, _mm_add_ps(_mm_loadu_ps(velocity + i), deltaV4));
+#endif
+	// scalar tail
+	for (; i < count; i++)
+		velocity[i] += deltaV;
+	} // IntegrateConstantAcceleration()
+
+// p = p + v * dt for every entry
+void IntegrateVelocity(float *position, const float *velocity, int count, float dt)
+	{ // IntegrateVelocity()
+	int i = 0;
+#if defined(__AVX__)
+	__m256 dt8 = _mm256_set1_ps(dt);
+	for (; i + 8 <= count; i += 8)
+		{ // 8 at a time
+		__m256 p = _mm256_loadu_ps(position + i);
+		__m256 v = _mm256_loadu_ps(velocity + i);
+#if defined(__FMA__)
+		p = _mm256_fmadd_ps(v, dt8, p);
+#else
+		p = _mm256_add_ps(p, _mm256_mul_ps(v, dt8));
+#endif
+		_mm256_storeu_ps(position + i, p);
+		} // 8 at a time
+#elif defined(__SSE2__)
+	__m128 dt4 = _mm_set1_ps(dt);
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(position + i, _mm_add_ps(_mm_loadu_ps(position + i), _mm_mul_ps(_mm_loadu_ps(velocity + i), dt4)));
+#endif
+	// scalar tail
+	for (; i < count; i++)
+		position[i] += velocity[i] * dt;
+	} // IntegrateVelocity()
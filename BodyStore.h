@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	BodyStore.h
+//	------------------------
+//
+//	Structure-of-arrays storage for the simulated
+//	bodies, with SIMD kernels for integration
+//
+///////////////////////////////////////////////////
+
+#ifndef _BODY_STORE_H
+#define _BODY_STORE_H
+
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+
+// a reference to a body that stays valid however the body moves around in
+// the arrays, and is detectably stale once the body has been removed
+struct BodyHandle
+	{ // struct BodyHandle
+	int slot;
+	unsigned int generation;
+
+	// handles default to invalid
+	BodyHandle() : slot(-1), generation(0) {}
+
+	bool IsValid() const { return slot >= 0; }
+	}; // struct BodyHandle
+
+class BodyStore
+	{ // class BodyStore
+	public:
+	// the bodies are kept densely packed in the arrays below, and handles
+	// reach them through a table of slots, each with a generation count
+	// that is bumped whenever the slot is freed
+	std::vector<int> slotToIndex;
+	std::vector<unsigned int> slotGeneration;
+	std::vector<int> freeSlots;
+
+	// and the slot of each packed body
+	std::vector<int> indexToSlot;
+
+	// the most bodies the store will hold
+	int capacity;
+
+	// constructor
+	BodyStore();
+
+	// frame on which each body was created
+	std::vector<int> creationFrame;
+
+	// position, split by coordinate
+	FloatArray positionX, positionY, positionZ;
+
+	// position at the start of the last step, for render interpolation
+	FloatArray previousX, previousY, previousZ;
+
+	// linear velocity
+	FloatArray velocityX, velocityY, velocityZ;
+
+	// angular velocity
+	FloatArray angularX, angularY, angularZ;
+
+	// orientation as a unit quaternion (x, y, z imaginary, w real)
+	FloatArray orientationX, orientationY, orientationZ, orientationW;
+
+	// how long each body has been below the sleep thresholds, in seconds
+	FloatArray sleepTimer;
+
+	// hull vertex found by the last support query, to start the next one from
+	std::vector<int> supportHint;
+
+	// number of bodies stored
+	int Size() const;
+
+	// remove all bodies
+	void Clear();
+
+	// set the most bodies the store will hold, allocating all the space up front
+	// so that adding a body never reallocates
+	void SetCapacity(int Capacity);
+
+	// append a body with identity orientation at index Size() - 1
+	// returns an invalid handle if the store is full
+	BodyHandle Add(int frame, const Cartesian3 &position, const Cartesian3 &linearVelocity, const Cartesian3 &angularVelocity);
+
+	// find the current index of a body, or -1 if the handle is stale
+	int IndexOf(const BodyHandle &handle) const;
+
+	// the handle of the body at an index
+	BodyHandle HandleAt(int index) const;
+
+	// remove the body at an index by moving the last body into its place
+	void RemoveAt(int index);
+
+	// exchange two bodies
+	void Swap(int first, int second);
+
+	// accessors that gather a body's fields back into vectors
+	Cartesian3 Position(int index) const;
+	Cartesian3 PreviousPosition(int index) const;
+	Cartesian3 LinearVelocity(int index) const;
+	Cartesian3 AngularVelocity(int index) const;
+	Quaternion Orientation(int index) const;
+	Matrix4 OrientationMatrix(int index) const;
+
+	// and the matching setters
+	void SetPosition(int index, const Cartesian3 &value);
+	void SetLinearVelocity(int index, const Cartesian3 &value);
+	void SetAngularVelocity(int index, const Cartesian3 &value);
+	void SetOrientation(int index, const Quaternion &value);
+	}; // class BodyStore
+
+// v = v + a * dt for every entry, a being constant
+void IntegrateConstantAcceleration(float *velocity, int count, float acceleration, float dt);
+
+// p = p + v * dt for every entry
+void IntegrateVelocity(float *position, const float *velocity, int count, float dt);
+
+#endif
@@ -0,0 +1,581 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	ConvexCollision.cpp
+//	------------------------
+//
+//	Narrowphase between a convex hull and terrain
+//	triangles: GJK for the distance between them,
+//	EPA for the depth when they overlap, and the
+//	manifold of contact points that results
+//
+///////////////////////////////////////////////////
+
+#include <math.h>
+#include <algorithm>
+
+#include "ConvexCollision.h"
+
+// squared distances below this are taken as zero, in world units squared
+const float gjkTolerance = 1.0e-10;
+
+// GJK stops once a step gains less than this fraction of the distance squared
+const float gjkRelativeTolerance = 1.0e-6;
+
+// EPA stops once the polytope is this close to the true surface
+const float epaTolerance = 1.0e-4;
+
+// limits on the work done for one pair
+const int maxGJKIterations = 32;
+const int maxEPAIterations = 32;
+const int maxEPAVertices = 4 + maxEPAIterations;
+const int maxEPAFaces = 2 * maxEPAVertices;
+
+// two contact points closer than this are the same point
+const float duplicateDistance = 1.0e-3;
+
+// a point of the difference of the hull and the triangle, with the points of
+// each that it came from
+struct SupportPoint
+	{ // struct SupportPoint
+	Cartesian3 w, a, b;
+	}; // struct SupportPoint
+
+// the hull vertex furthest in a world direction
+int PlacedHull::SupportVertex(const Cartesian3 &direction, int startVertex) const
+	{ // SupportVertex()
+	// the direction in body coordinates is the transposed rotation times it
+	Cartesian3 local(
+		rotation[0][0] * direction.x + rotation[1][0] * direction.y + rotation[2][0] * direction.z,
+		rotation[0][1] * direction.x + rotation[1][1] * direction.y + rotation[2][1] * direction.z,
+		rotation[0][2] * direction.x + rotation[1][2] * direction.y + rotation[2][2] * direction.z);
+	return hull->Support(local, startVertex);
+	} // SupportVertex()
+
+// a hull vertex in world coordinates
+Cartesian3 PlacedHull::Vertex(int vertex) const
+	{ // Vertex()
+	const Cartesian3 &v = hull->vertices[vertex];
+	return Cartesian3(
+		rotation[0][0] * v.x + rotation[0][1] * v.y + rotation[0][2] * v.z + position.x,
+		rotation[1][0] * v.x + rotation[1][1] * v.y + rotation[1][2] * v.z + position.y,
+		rotation[2][0] * v.x + rotation[2][1] * v.y + rotation[2][2] * v.z + position.z);
+	} // Vertex()
+
+// true if a point lies over a triangle, seen along its face normal (of any length)
+static bool OverTriangle(const Cartesian3 *triangle, const Cartesian3 &faceNormal, const Cartesian3 &point)
+	{ // OverTriangle()
+	for (int edge = 0; edge < 3; edge++)
+		if (faceNormal.cross(triangle[(edge + 1) % 3] - triangle[edge]).dot(point - triangle[edge]) < 0.0)
+			return false;
+	return true;
+	} // OverTriangle()
+
+// the point of the hull minus the triangle furthest in a direction
+static SupportPoint Support(const PlacedHull &hull, const Cartesian3 *triangle, const Cartesian3 &direction, int &hint)
+	{ // Support()
+	SupportPoint point;
+	hint = hull.SupportVertex(direction, hint);
+	point.a = hull.Vertex(hint);
+	int lowest = 0;
+	for (int corner = 1; corner < 3; corner++)
+		if (triangle[corner].dot(direction) < triangle[lowest].dot(direction))
+			lowest = corner;
+	point.b = triangle[lowest];
+	point.w = point.a - point.b;
+	return point;
+	} // Support()
+
+// the point of triangle abc nearest the origin, with its barycentric
+// coordinates, and the corners of the feature it lies on (Ericson's regions)
+static Cartesian3 NearestOnTriangle(const Cartesian3 &a, const Cartesian3 &b, const Cartesian3 &c, float *lambda, int *kept, int &nKept)
+	{ // NearestOnTriangle()
+	Cartesian3 ab = b - a, ac = c - a;
+	float d1 = -ab.dot(a), d2 = -ac.dot(a);
+	if (d1 <= 0.0 && d2 <= 0.0)
+		{ kept[0] = 0; lambda[0] = 1.0; nKept = 1; return a; }
+	float d3 = -ab.dot(b), d4 = -ac.dot(b);
+	if (d3 >= 0.0 && d4 <= d3)
+		{ kept[0] = 1; lambda[0] = 1.0; nKept = 1; return b; }
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+		{ // edge ab
+		float t = d1 / (d1 - d3);
+		kept[0] = 0; kept[1] = 1; lambda[0] = 1.0 - t; lambda[1] = t; nKept = 2;
+		return a + ab * t;
+		} // edge ab
+	float d5 = -ab.dot(c), d6 = -ac.dot(c);
+	if (d6 >= 0.0 && d5 <= d6)
+		{ kept[0] = 2; lambda[0] = 1.0; nKept = 1; return c; }
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+		{ // edge ac
+		float t = d2 / (d2 - d6);
+		kept[0] = 0; kept[1] = 2; lambda[0] = 1.0 - t; lambda[1] = t; nKept = 2;
+		return a + ac * t;
+		} // edge ac
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+		{ // edge bc
+		float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		kept[0] = 1; kept[1] = 2; lambda[0] = 1.0 - t; lambda[1] = t; nKept = 2;
+		return b + (c - b) * t;
+		} // edge bc
+	float denominator = 1.0 / (va + vb + vc);
+	float v = vb * denominator, w = vc * denominator;
+	kept[0] = 0; kept[1] = 1; kept[2] = 2; lambda[0] = 1.0 - v - w; lambda[1] = v; lambda[2] = w; nKept = 3;
+	return a + ab * v + ac * w;
+	} // NearestOnTriangle()
+
+// reduce a simplex to the smallest part holding its point nearest the origin,
+// returning that point and setting its barycentric coordinates; a
+// tetrahedron containing the origin is left whole, returning the origin
+static Cartesian3 NearestOnSimplex(SupportPoint *simplex, int &count, float *lambda, bool &containsOrigin)
+	{ // NearestOnSimplex()
+	containsOrigin = false;
+	int kept[3], nKept = 0;
+	float keptLambda[3];
+	Cartesian3 nearest;
+	switch (count)
+		{ // count
+		case 1:
+			lambda[0] = 1.0;
+			return simplex[0].w;
+		case 2:
+			{ // segment
+			Cartesian3 ab = simplex[1].w - simplex[0].w;
+			float lengthSquared = ab.dot(ab);
+			float t = lengthSquared > 0.0 ? -simplex[0].w.dot(ab) / lengthSquared : 0.0;
+			if (t <= 0.0)
+				{ count = 1; lambda[0] = 1.0; return simplex[0].w; }
+			if (t >= 1.0)
+				{ simplex[0] = simplex[1]; count = 1; lambda[0] = 1.0; return simplex[0].w; }
+			lambda[0] = 1.0 - t;
+			lambda[1] = t;
+			return simplex[0].w + ab * t;
+			} // segment
+		case 3:
+			nearest = NearestOnTriangle(simplex[0].w, simplex[1].w, simplex[2].w, keptLambda, kept, nKept);
+			break;
+		default:
+			{ // tetrahedron
+			// a flat one adds nothing to its first three corners
+			Cartesian3 base = (simplex[1].w - simplex[0].w).cross(simplex[2].w - simplex[0].w);
+			if (fabs(base.dot(simplex[3].w - simplex[0].w)) < 1.0e-9)
+				{ // flat
+				count = 3;
+				return NearestOnSimplex(simplex, count, lambda, containsOrigin);
+				} // flat
+
+			// the origin is outside a face if it is on the other side from the fourth corner
+			static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+			float bestDistance = -1.0;
+			for (int face = 0; face < 4; face++)
+				{ // per face
+				const Cartesian3 &a = simplex[faces[face][0]].w;
+				Cartesian3 normal = (simplex[faces[face][1]].w - a).cross(simplex[faces[face][2]].w - a);
+				float originSide = -normal.dot(a);
+				float otherSide = normal.dot(simplex[faces[face][3]].w - a);
+				if (originSide * otherSide >= 0.0)
+					continue;
+				int faceKept[3], faceCount = 0;
+				float faceLambda[3];
+				Cartesian3 point = NearestOnTriangle(a, simplex[faces[face][1]].w, simplex[faces[face][2]].w, faceLambda, faceKept, faceCount);
+				float distance = point.dot(point);
+				if (bestDistance >= 0.0 && distance >= bestDistance)
+					continue;
+				bestDistance = distance;
+				nearest = point;
+				nKept = faceCount;
+				for (int corner = 0; corner < faceCount; corner++)
+					{ kept[corner] = faces[face][faceKept[corner]]; keptLambda[corner] = faceLambda[corner]; }
+				} // per face
+			if (bestDistance < 0.0)
+				{ // inside
+				containsOrigin = true;
+				return Cartesian3(0.0, 0.0, 0.0);
+				} // inside
+			} // tetrahedron
+		} // count
+
+	// keep only the corners of the feature, in order
+	SupportPoint reduced[3];
+	for (int corner = 0; corner < nKept; corner++)
+		{ reduced[corner] = simplex[kept[corner]]; lambda[corner] = keptLambda[corner]; }
+	for (int corner = 0; corner < nKept; corner++)
+		simplex[corner] = reduced[corner];
+	count = nKept;
+	return nearest;
+	} // NearestOnSimplex()
+
+// a face of the EPA polytope, with its outward unit normal and its distance from the origin
+struct PolytopeFace
+	{ // struct PolytopeFace
+	int v[3];
+	Cartesian3 normal;
+	float distance;
+	}; // struct PolytopeFace
+
+// set up a polytope face, false if it is degenerate
+static bool MakeFace(const SupportPoint *vertices, int a, int b, int c, PolytopeFace &face)
+	{ // MakeFace()
+	face.v[0] = a;
+	face.v[1] = b;
+	face.v[2] = c;
+	Cartesian3 normal = (vertices[b].w - vertices[a].w).cross(vertices[c].w - vertices[a].w);
+	float length = normal.length();
+	if (length < 1.0e-12)
+		return false;
+	face.normal = normal / length;
+	face.distance = face.normal.dot(vertices[a].w);
+	return true;
+	} // MakeFace()
+
+// grow a simplex whose nearest point is the origin into a tetrahedron, false if
+// the difference is too flat for one
+static bool GrowSimplex(const PlacedHull &hull, const Cartesian3 *triangle, SupportPoint *simplex, int &count, int &hint)
+	{ // GrowSimplex()
+	static const Cartesian3 axes[6] = { Cartesian3(1, 0, 0), Cartesian3(-1, 0, 0), Cartesian3(0, 1, 0),
+		Cartesian3(0, -1, 0), Cartesian3(0, 0, 1), Cartesian3(0, 0, -1) };
+	if (count == 1)
+		for (const Cartesian3 &axis : axes)
+			{ // per axis
+			SupportPoint point = Support(hull, triangle, axis, hint);
+			if ((point.w - simplex[0].w).dot(point.w - simplex[0].w) > gjkTolerance)
+				{ simplex[count++] = point; break; }
+			} // per axis
+	if (count == 2)
+		{ // off the line
+		Cartesian3 line = (simplex[1].w - simplex[0].w).unit();
+		int axis = fabs(line.x) < fabs(line.y) ? (fabs(line.x) < fabs(line.z) ? 0 : 4) : (fabs(line.y) < fabs(line.z) ? 2 : 4);
+		Cartesian3 across = line.cross(axes[axis]).unit();
+		Cartesian3 across2 = line.cross(across);
+		for (int turn = 0; turn < 6; turn++)
+			{ // per direction round the line
+			float angle = turn * M_PI / 3.0;
+			SupportPoint point = Support(hull, triangle, across * cos(angle) + across2 * sin(angle), hint);
+			Cartesian3 offset = point.w - simplex[0].w;
+			Cartesian3 perpendicular = offset - line * offset.dot(line);
+			if (perpendicular.dot(perpendicular) > gjkTolerance)
+				{ simplex[count++] = point; break; }
+			} // per direction round the line
+		} // off the line
+	if (count == 3)
+		{ // off the plane
+		Cartesian3 normal = (simplex[1].w - simplex[0].w).cross(simplex[2].w - simplex[0].w);
+		if (normal.length() < 1.0e-12)
+			return false;
+		normal = normal.unit();
+		SupportPoint point = Support(hull, triangle, normal, hint);
+		if (fabs(normal.dot(point.w - simplex[0].w)) < 1.0e-5)
+			point = Support(hull, triangle, -normal, hint);
+		if (fabs(normal.dot(point.w - simplex[0].w)) < 1.0e-5)
+			return false;
+		simplex[count++] = point;
+		} // off the plane
+	return count == 4;
+	} // GrowSimplex()
+
+// the depth of an overlap by expanding a polytope inside the difference of the
+// shapes towards its surface nearest the origin
+static bool ExpandPolytope(const PlacedHull &hull, const Cartesian3 *triangle, const SupportPoint *simplex, int &hint,
+	Cartesian3 &normal, float &depth, Cartesian3 &hullPoint, Cartesian3 &trianglePoint)
+	{ // ExpandPolytope()
+	SupportPoint vertices[maxEPAVertices];
+	PolytopeFace faces[maxEPAFaces];
+	int nVertices = 4, nFaces = 0;
+	for (int vertex = 0; vertex < 4; vertex++)
+		vertices[vertex] = simplex[vertex];
+
+	// the faces of the tetrahedron, wound outwards
+	Cartesian3 centre = (vertices[0].w + vertices[1].w + vertices[2].w + vertices[3].w) * 0.25;
+	static const int tetrahedron[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+	for (int face = 0; face < 4; face++)
+		{ // per face
+		int a = tetrahedron[face][0], b = tetrahedron[face][1], c = tetrahedron[face][2];
+		if (!MakeFace(vertices, a, b, c, faces[nFaces]))
+			return false;
+		if (faces[nFaces].normal.dot(vertices[a].w - centre) < 0.0)
+			MakeFace(vertices, a, c, b, faces[nFaces]);
+		nFaces++;
+		} // per face
+
+	int nearest = 0;
+	for (int iteration = 0; ; iteration++)
+		{ // per expansion
+		nearest = 0;
+		for (int face = 1; face < nFaces; face++)
+			if (faces[face].distance < faces[nearest].distance)
+				nearest = face;
+		if (iteration == maxEPAIterations || nVertices == maxEPAVertices)
+			break;
+
+		// done if the surface is no further out that way than the face
+		SupportPoint point = Support(hull, triangle, faces[nearest].normal, hint);
+		if (point.w.dot(faces[nearest].normal) - faces[nearest].distance < epaTolerance)
+			break;
+
+		// remove the faces the new point sees, keeping the edges of the hole
+		int edges[maxEPAFaces * 3][2], nEdges = 0;
+		for (int face = 0; face < nFaces; )
+			{ // per face
+			if (faces[face].normal.dot(point.w - vertices[faces[face].v[0]].w) <= 0.0)
+				{ face++; continue; }
+			for (int corner = 0; corner < 3; corner++)
+				{ // per edge
+				int from = faces[face].v[corner], to = faces[face].v[(corner + 1) % 3];
+				// an edge shared with another removed face is inside the hole
+				int shared = -1;
+				for (int edge = 0; edge < nEdges && shared < 0; edge++)
+					if (edges[edge][0] == to && edges[edge][1] == from)
+						shared = edge;
+				if (shared >= 0)
+					{ edges[shared][0] = edges[nEdges - 1][0]; edges[shared][1] = edges[nEdges - 1][1]; nEdges--; }
+				else
+					{ edges[nEdges][0] = from; edges[nEdges][1] = to; nEdges++; }
+				} // per edge
+			faces[face] = faces[--nFaces];
+			} // per face
+
+		// and fill the hole with a fan from the new point
+		if (nFaces + nEdges > maxEPAFaces)
+			return false;
+		vertices[nVertices] = point;
+		for (int edge = 0; edge < nEdges; edge++)
+			if (MakeFace(vertices, edges[edge][0], edges[edge][1], nVertices, faces[nFaces]))
+				nFaces++;
+		nVertices++;
+		if (nFaces == 0)
+			return false;
+		} // per expansion
+
+	// the nearest point of that face to the origin, and where it came from on each shape
+	const PolytopeFace &face = faces[nearest];
+	const Cartesian3 &a = vertices[face.v[0]].w, &b = vertices[face.v[1]].w, &c = vertices[face.v[2]].w;
+	Cartesian3 projection = face.normal * face.distance;
+	float area = face.normal.dot((b - a).cross(c - a));
+	float u = face.normal.dot((b - projection).cross(c - projection)) / area;
+	float v = face.normal.dot((c - projection).cross(a - projection)) / area;
+	float w = 1.0 - u - v;
+	hullPoint = vertices[face.v[0]].a * u + vertices[face.v[1]].a * v + vertices[face.v[2]].a * w;
+	trianglePoint = vertices[face.v[0]].b * u + vertices[face.v[1]].b * v + vertices[face.v[2]].b * w;
+
+	// moving the hull back along the normal by the depth separates them
+	normal = -face.normal;
+	depth = std::max(face.distance, 0.0f);
+	return true;
+	} // ExpandPolytope()
+
+// the distance between a hull and a triangle, or their overlap
+bool ConvexCollision::TriangleContact(const PlacedHull &hull, const Cartesian3 *triangle, float margin, int &hint,
+	Cartesian3 &normal, float &separation, Cartesian3 &hullPoint, Cartesian3 &trianglePoint)
+	{ // TriangleContact()
+	// start from the centre of the hull less the centre of the triangle
+	SupportPoint simplex[4];
+	int count = 0;
+	float lambda[4] = { 1.0, 0.0, 0.0, 0.0 };
+	Cartesian3 v = hull.position - (triangle[0] + triangle[1] + triangle[2]) / 3.0;
+	bool overlapping = false;
+
+	for (int iteration = 0; iteration < maxGJKIterations; iteration++)
+		{ // per GJK step
+		float distanceSquared = v.dot(v);
+		if (distanceSquared <= gjkTolerance)
+			{ overlapping = true; break; }
+
+		SupportPoint point = Support(hull, triangle, -v, hint);
+
+		// the support plane puts a lower bound on the distance
+		float bound = v.dot(point.w);
+		if (bound > 0.0 && bound * bound > margin * margin * distanceSquared)
+			return false;
+
+		// no nearer point to be had, or one we already have
+		bool repeated = false;
+		for (int corner = 0; corner < count; corner++)
+			repeated = repeated || (point.w - simplex[corner].w).dot(point.w - simplex[corner].w) <= gjkTolerance;
+		if (count > 0 && (repeated || distanceSquared - bound <= gjkRelativeTolerance * distanceSquared))
+			break;
+
+		simplex[count++] = point;
+		bool containsOrigin = false;
+		v = NearestOnSimplex(simplex, count, lambda, containsOrigin);
+		if (containsOrigin)
+			{ overlapping = true; break; }
+		} // per GJK step
+
+	if (!overlapping && v.dot(v) > gjkTolerance)
+		{ // apart
+		separation = v.length();
+		if (separation > margin)
+			return false;
+		normal = v / separation;
+		hullPoint = Cartesian3(0.0, 0.0, 0.0);
+		trianglePoint = Cartesian3(0.0, 0.0, 0.0);
+		for (int corner = 0; corner < count; corner++)
+			{ // per corner
+			hullPoint = hullPoint + simplex[corner].a * lambda[corner];
+			trianglePoint = trianglePoint + simplex[corner].b * lambda[corner];
+			} // per corner
+		return true;
+		} // apart
+
+	// overlapping, or touching to within rounding: find the depth
+	float depth = 0.0;
+	if (count == 0)
+		simplex[count++] = Support(hull, triangle, Cartesian3(0.0, 0.0, 1.0), hint);
+	if (!GrowSimplex(hull, triangle, simplex, count, hint)
+		|| !ExpandPolytope(hull, triangle, simplex, hint, normal, depth, hullPoint, trianglePoint))
+		{ // too flat for EPA
+		// push the hull out along the triangle's normal by the depth of its lowest vertex
+		normal = (triangle[1] - triangle[0]).cross(triangle[2] - triangle[0]).unit();
+		hint = hull.SupportVertex(-normal, hint);
+		hullPoint = hull.Vertex(hint);
+		depth = normal.dot(triangle[0] - hullPoint);
+		trianglePoint = hullPoint + normal * depth;
+		} // too flat for EPA
+	separation = -depth;
+	return true;
+	} // TriangleContact()
+
+// the squared distance from a point to a triangle
+float ConvexCollision::DistanceSquared(const Cartesian3 *triangle, const Cartesian3 &point)
+	{ // DistanceSquared()
+	int kept[3], nKept;
+	float lambda[3];
+	Cartesian3 nearest = NearestOnTriangle(triangle[0] - point, triangle[1] - point, triangle[2] - point, lambda, kept, nKept);
+	return nearest.dot(nearest);
+	} // DistanceSquared()
+
+// add the contacts of a hull with the face of a triangle
+bool ConvexCollision::AddFaceContacts(const PlacedHull &hull, const Cartesian3 *triangle, float margin, float tolerance,
+	int &hint, bool &clear, ContactManifold &manifold)
+	{ // AddFaceContacts()
+	Cartesian3 faceNormal = (triangle[1] - triangle[0]).cross(triangle[2] - triangle[0]).unit();
+	hint = hull.SupportVertex(-faceNormal, hint);
+	float lowest = faceNormal.dot(hull.Vertex(hint) - triangle[0]);
+	clear = lowest > margin;
+	if (clear)
+		return false;
+
+	// the vertices near the lowest are found by walking out from it over the
+	// adjacency graph; a hull with no graph is scanned instead
+	const ConvexHull &convex = *hull.hull;
+	const int maxVisited = 64;
+	int stack[maxVisited], nStack = 0, visited[maxVisited], nVisited = 0;
+	stack[nStack++] = hint;
+	visited[nVisited++] = hint;
+	int nVertices = (int) convex.vertices.size();
+	bool scan = convex.adjacency.empty();
+	bool added = false;
+	for (int next = 0; scan ? next < nVertices : nStack > 0; next++)
+		{ // per vertex
+		int vertex = scan ? next : stack[--nStack];
+		Cartesian3 position = hull.Vertex(vertex);
+		float height = faceNormal.dot(position - triangle[0]);
+		if (height > lowest + tolerance)
+			continue;
+
+		if (OverTriangle(triangle, faceNormal, position))
+			{ // over the triangle
+			ContactPoint point = { position, faceNormal, -height };
+			manifold.Add(point);
+			added = true;
+			} // over the triangle
+
+		// and its neighbours may be near the plane too
+		if (!scan)
+			for (int slot = convex.adjacencyStart[vertex]; slot < convex.adjacencyStart[vertex + 1]; slot++)
+				{ // per neighbour
+				int neighbour = convex.adjacency[slot];
+				if (nVisited == maxVisited || std::find(visited, visited + nVisited, neighbour) != visited + nVisited)
+					continue;
+				visited[nVisited++] = neighbour;
+				stack[nStack++] = neighbour;
+				} // per neighbour
+		} // per vertex
+	return added;
+	} // AddFaceContacts()
+
+// the area of the polygon through some points, taken in order of angle around
+// their centre in the plane across a normal
+static float SpannedArea(const Cartesian3 *corners, int nCorners, const Cartesian3 &normal)
+	{ // SpannedArea()
+	Cartesian3 centre(0.0, 0.0, 0.0);
+	for (int corner = 0; corner < nCorners; corner++)
+		centre = centre + corners[corner];
+	centre = centre / (float) nCorners;
+
+	// two directions across the normal
+	Cartesian3 other = fabs(normal.x) < 0.6 ? Cartesian3(1.0, 0.0, 0.0) : Cartesian3(0.0, 1.0, 0.0);
+	Cartesian3 u = normal.cross(other).unit();
+	Cartesian3 v = normal.cross(u);
+
+	float angles[ContactManifold::maxPoints];
+	int order[ContactManifold::maxPoints];
+	for (int corner = 0; corner < nCorners; corner++)
+		{ // per corner
+		Cartesian3 offset = corners[corner] - centre;
+		angles[corner] = atan2f(offset.dot(v), offset.dot(u));
+		order[corner] = corner;
+		} // per corner
+	std::sort(order, order + nCorners, [&angles](int a, int b) { return angles[a] < angles[b]; });
+
+	Cartesian3 twiceArea(0.0, 0.0, 0.0);
+	for (int corner = 0; corner < nCorners; corner++)
+		twiceArea = twiceArea + (corners[order[corner]] - centre).cross(corners[order[(corner + 1) % nCorners]] - centre);
+	return 0.5 * twiceArea.length();
+	} // SpannedArea()
+
+// add a point to a manifold
+void ContactManifold::Add(const ContactPoint &point)
+	{ // Add()
+	// the same point found from two triangles keeps the deeper
+	for (int existing = 0; existing < count; existing++)
+		if ((points[existing].position - point.position).length() < duplicateDistance)
+			{ // duplicate
+			if (point.depth > points[existing].depth)
+				points[existing] = point;
+			return;
+			} // duplicate
+	if (count < maxPoints)
+		{ points[count++] = point; return; }
+
+	// full: of the six, drop the one (never the deepest) that leaves the most area
+	ContactPoint candidates[maxPoints + 1];
+	std::copy(points, points + maxPoints, candidates);
+	candidates[maxPoints] = point;
+	int deepest = 0;
+	for (int candidate = 1; candidate <= maxPoints; candidate++)
+		if (candidates[candidate].depth > candidates[deepest].depth)
+			deepest = candidate;
+	int dropped = -1;
+	float bestArea = -1.0;
+	for (int drop = 0; drop <= maxPoints; drop++)
+		{ // per candidate to drop
+		if (drop == deepest)
+			continue;
+		Cartesian3 corners[maxPoints];
+		int nCorners = 0;
+		for (int candidate = 0; candidate <= maxPoints; candidate++)
+			if (candidate != drop)
+				corners[nCorners++] = candidates[candidate].position;
+		float area = SpannedArea(corners, nCorners, candidates[deepest].normal);
+		if (area > bestArea)
+			{ bestArea = area; dropped = drop; }
+		} // per candidate to drop
+	count = 0;
+	for (int candidate = 0; candidate <= maxPoints; candidate++)
+		if (candidate != dropped)
+			points[count++] = candidates[candidate];
+	} // Add()
+
+// the deepest point of a manifold
+int ContactManifold::Deepest() const
+	{ // Deepest()
+	int deepest = -1;
+	for (int point = 0; point < count; point++)
+		if (deepest < 0 || points[point].depth > points[deepest].depth)
+			deepest = point;
+	return deepest;
+	} // Deepest()
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	ConvexCollision.h
+//	------------------------
+//
+//	Narrowphase between a convex hull and terrain
+//	triangles: GJK for the distance between them,
+//	EPA for the depth when they overlap, and the
+//	manifold of contact points that results
+//
+///////////////////////////////////////////////////
+
+#ifndef _CONVEX_COLLISION_H
+#define _CONVEX_COLLISION_H
+
+#include "Cartesian3.h"
+#include "ConvexHull.h"
+
+// a point where a body meets the terrain, with the normal pointing from the
+// terrain to the body, and how far it is pushed in (negative if it is still
+// that far from touching)
+struct ContactPoint
+	{ // struct ContactPoint
+	Cartesian3 position;
+	Cartesian3 normal;
+	float depth;
+	}; // struct ContactPoint
+
+// the points where a body meets the terrain, at most five: the deepest, and
+// those that span the most area with it, so that a face resting on the
+// ground (up to a pentagon, as on the dodecahedron) is held at every corner
+struct ContactManifold
+	{ // struct ContactManifold
+	static const int maxPoints = 5;
+	ContactPoint points[maxPoints];
+	int count;
+
+	ContactManifold() : count(0) {}
+
+	// add a point, merging it into a point it duplicates, and once there are
+	// five dropping whichever leaves the largest area
+	void Add(const ContactPoint &point);
+
+	// the deepest point, or -1 if there are none
+	int Deepest() const;
+	}; // struct ContactManifold
+
+// a hull placed in the world by a rotation (rows of a 3x3 matrix) and a translation
+struct PlacedHull
+	{ // struct PlacedHull
+	const ConvexHull *hull;
+	float rotation[3][3];
+	Cartesian3 position;
+
+	// the hull vertex furthest in a world direction, climbing from startVertex
+	int SupportVertex(const Cartesian3 &direction, int startVertex) const;
+
+	// a hull vertex in world coordinates
+	Cartesian3 Vertex(int vertex) const;
+	}; // struct PlacedHull
+
+class ConvexCollision
+	{ // class ConvexCollision
+	public:
+	// the squared distance from a point to a triangle, for culling the
+	// triangles a body's bounding sphere is clear of
+	static float DistanceSquared(const Cartesian3 *triangle, const Cartesian3 &point);
+
+	// add the contacts of a hull with the face of a triangle: the hull vertices
+	// within tolerance of its lowest along the face normal that lie over the
+	// triangle, at the depth each is below its plane.  This settles a body on the
+	// ground with one support query and a short walk.  Returns false if there are
+	// none, setting clear if the hull is more than margin above the plane, and
+	// otherwise leaving the contact to the edges and corners of the triangle.
+	// hint is the vertex the hull's support searches start from
+	static bool AddFaceContacts(const PlacedHull &hull, const Cartesian3 *triangle, float margin, float tolerance,
+		int &hint, bool &clear, ContactManifold &manifold);
+
+	// the distance between a hull and a triangle by GJK, or if they overlap, the
+	// depth by EPA.  Returns false if they are further apart than margin; else
+	// normal is the unit direction from the triangle to the hull, separation the
+	// distance between them (negative when overlapping), and hullPoint and
+	// trianglePoint the nearest (or deepest) points of each
+	static bool TriangleContact(const PlacedHull &hull, const Cartesian3 *triangle, float margin, int &hint,
+		Cartesian3 &normal, float &separation, Cartesian3 &hullPoint, Cartesian3 &trianglePoint);
+	}; // class ConvexCollision
+
+#endif
@@ -0,0 +1,293 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	ConvexHull.cpp
+//	------------------------
+//
+//	The convex hull of a point set, with a vertex
+//	adjacency graph for fast support-point queries
+//
+///////////////////////////////////////////////////
+
+#include <math.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include "ConvexHull.h"
+
+// a triangle of the hull under construction
+struct HullFace
+	{ // struct HullFace
+	int v[3];
+	Cartesian3 normal;
+	float offset;
+	bool alive;
+	}; // struct HullFace
+
+// set up a face through three points, with its plane
+static HullFace MakeFace(const std::vector<Cartesian3> &points, int a, int b, int c)
+	{ // MakeFace()
+	HullFace face;
+	face.v[0] = a;
+	face.v[1] = b;
+	face.v[2] = c;
+	face.normal = (points[b] - points[a]).cross(points[c] - points[a]);
+	float length = face.normal.length();
+	if (length > 0.0)
+		face.normal = face.normal / length;
+	face.offset = face.normal.dot(points[a]);
+	face.alive = true;
+	return face;
+	} // MakeFace()
+
+// key for a directed edge
+static long long EdgeKey(int from, int to)
+	{ // EdgeKey()
+	return ((long long) from << 32) | (unsigned int) to;
+	} // EdgeKey()
+
+// constructor
+ConvexHull::ConvexHull()
+	{ // constructor
+	} // constructor
+
+// compute the hull of a point set
+bool ConvexHull::Build(const std::vector<Cartesian3> &points)
+	{ // Build()
+	vertices.clear();
+	faceVertices.clear();
+	adjacencyStart.assign(1, 0);
+	adjacency.clear();
+
+	int nPoints = (int) points.size();
+
+	// the degenerate fallback keeps every point with no adjacency
+	vertices = points;
+	adjacencyStart.assign(nPoints + 1, 0);
+	if (nPoints < 4)
+		return false;
+
+	// tolerance scaled to the size of the point set
+	float extent = 0.0;
+	for (int point = 0; point < nPoints; point++)
+		for (int axis = 0; axis < 3; axis++)
+			extent = std::max(extent, (float) fabs(points[point][axis]));
+	float epsilon = 1.0e-5 * (extent > 0.0 ? extent : 1.0);
+
+	// initial tetrahedron: the lowest x, the point furthest from it, then
+	// the point furthest from that line, then the one furthest from that plane
+	int p0 = 0;
+	for (int point = 1; point < nPoints; point++)
+		if (points[point].x < points[p0].x)
+			p0 = point;
+
+	int p1 = -1;
+	float best = epsilon;
+	for (int point = 0; point < nPoints; point++)
+		{ // furthest point
+		float distance = (points[point] - points[p0]).length();
+		if (distance > best)
+			{ best = distance; p1 = point; }
+		} // furthest point
+	if (p1 < 0)
+		return false;
+
+	int p2 = -1;
+	best = epsilon;
+	Cartesian3 axis = (points[p1] - points[p0]).unit();
+	for (int point = 0; point < nPoints; point++)
+		{ // furthest from line
+		float distance = (points[point] - points[p0]).cross(axis).length();
+		if (distance > best)
+			{ best = distance; p2 = point; }
+		} // furthest from line
+	if (p2 < 0)
+		return false;
+
+	int p3 = -1;
+	best = epsilon;
+	Cartesian3 planeNormal = (points[p1] - points[p0]).cross(points[p2] - points[p0]).unit();
+	for (int point = 0; point < nPoints; point++)
+		{ // furthest from plane
+		float distance = fabs((points[point] - points[p0]).dot(planeNormal));
+		if (distance > best)
+			{ best = distance; p3 = point; }
+		} // furthest from plane
+	if (p3 < 0)
+		return false;
+
+	// orient the tetrahedron so that its faces point outwards
+	if ((points[p3] - points[p0]).dot(planeNormal) > 0.0)
+		std::swap(p1, p2);
+
+	std::vector<HullFace> faces;
+	faces.push_back(MakeFace(points, p0, p1, p2));
+	faces.push_back(MakeFace(points, p0, p3, p1));
+	faces.push_back(MakeFace(points, p1, p3, p2));
+	faces.push_back(MakeFace(points, p2, p3, p0));
+
+	// directed edge to the face that owns it
+	std::unordered_map<long long, int> edgeFace;
+	for (int face = 0; face < 4; face++)
+		for (int edge = 0; edge < 3; edge++)
+			edgeFace[EdgeKey(faces[face].v[edge], faces[face].v[(edge + 1) % 3])] = face;
+
+	// now add the points one at a time
+	std::vector<int> visible;
+	std::vector<int> horizon;
+	for (int point = 0; point < nPoints; point++)
+		{ // per point
+		if (point == p0 || point == p1 || point == p2 || point == p3)
+			continue;
+
+		// find the faces that can see the point
+		visible.clear();
+		for (int face = 0; face < (int) faces.size(); face++)
+			if (faces[face].alive && faces[face].normal.dot(points[point]) - faces[face].offset > epsilon)
+				visible.push_back(face);
+
+		// inside the hull so far
+		if (visible.empty())
+			continue;
+
+		for (int face : visible)
+			faces[face].alive = false;
+
+		// the horizon is every edge of a visible face whose twin is on a hidden face
+		horizon.clear();
+		for (int face : visible)
+			for (int edge = 0; edge < 3; edge++)
+				{ // per edge
+				int from = faces[face].v[edge], to = faces[face].v[(edge + 1) % 3];
+				if (!faces[edgeFace[EdgeKey(to, from)]].alive)
+					continue;
+				horizon.push_back(from);
+				horizon.push_back(to);
+				} // per edge
+
+		// remove the old edges
+		for (int face : visible)
+			for (int edge = 0; edge < 3; edge++)
+				edgeFace.erase(EdgeKey(faces[face].v[edge], faces[face].v[(edge + 1) % 3]));
+
+		// and fan new faces from the horizon to the point
+		for (int edge = 0; edge < (int) horizon.size(); edge += 2)
+			{ // per horizon edge
+			int face = (int) faces.size();
+			faces.push_back(MakeFace(points, horizon[edge], horizon[edge + 1], point));
+			for (int side = 0; side < 3; side++)
+				edgeFace[EdgeKey(faces[face].v[side], faces[face].v[(side + 1) % 3])] = face;
+			} // per horizon edge
+		} // per point
+
+	// compact the vertices that ended up on the hull
+	std::vector<int> newIndex(nPoints, -1);
+	vertices.clear();
+	for (const auto& face : faces)
+		{ // per face
+		if (!face.alive)
+			continue;
+		for (int corner = 0; corner < 3; corner++)
+			{ // per corner
+			if (newIndex[face.v[corner]] < 0)
+				{ // new vertex
+				newIndex[face.v[corner]] = (int) vertices.size();
+				vertices.push_back(points[face.v[corner]]);
+				} // new vertex
+			faceVertices.push_back(newIndex[face.v[corner]]);
+			} // per corner
+		} // per face
+
+	// build the neighbour lists from the triangle edges
+	int nVertices = (int) vertices.size();
+	std::vector<std::vector<int> > neighbours(nVertices);
+	for (int corner = 0; corner < (int) faceVertices.size(); corner++)
+		{ // per corner
+		int first = corner - corner % 3;
+		int from = faceVertices[corner];
+		int to = faceVertices[first + (corner - first + 1) % 3];
+		neighbours[from].push_back(to);
+		neighbours[to].push_back(from);
+		} // per corner
+
+	adjacencyStart.assign(1, 0);
+	for (int vertex = 0; vertex < nVertices; vertex++)
+		{ // per vertex
+		std::sort(neighbours[vertex].begin(), neighbours[vertex].end());
+		neighbours[vertex].erase(std::unique(neighbours[vertex].begin(), neighbours[vertex].end()), neighbours[vertex].end());
+		adjacency.insert(adjacency.end(), neighbours[vertex].begin(), neighbours[vertex].end());
+		adjacencyStart.push_back((int) adjacency.size());
+		} // per vertex
+
+	return true;
+	} // Build()
+
+// index of the hull vertex furthest in a direction
+int ConvexHull::Support(const Cartesian3 &direction, int startVertex) const
+	{ // Support()
+	int nVertices = (int) vertices.size();
+	if (nVertices == 0)
+		return -1;
+	if (startVertex < 0 || startVertex >= nVertices)
+		startVertex = 0;
+
+	// no adjacency (degenerate hull): just scan
+	if (adjacency.empty())
+		{ // linear scan
+		int bestVertex = 0;
+		float bestDot = vertices[0].dot(direction);
+		for (int vertex = 1; vertex < nVertices; vertex++)
+			{ // per vertex
+			float dot = vertices[vertex].dot(direction);
+			if (dot > bestDot)
+				{ bestDot = dot; bestVertex = vertex; }
+			} // per vertex
+		return bestVertex;
+		} // linear scan
+
+	// on a convex hull, a vertex with no better neighbour is the global best,
+	// so move to the best neighbour until there is none
+	int current = startVertex;
+	float currentDot = vertices[current].dot(direction);
+	while (true)
+		{ // climb
+		int next = current;
+		for (int slot = adjacencyStart[current]; slot < adjacencyStart[current + 1]; slot++)
+			{ // per neighbour
+			int neighbour = adjacency[slot];
+			float dot = vertices[neighbour].dot(direction);
+			if (dot > currentDot)
+				{ next = neighbour; currentDot = dot; }
+			} // per neighbour
+		if (next == current)
+			return current;
+		current = next;
+		} // climb
+	} // Support()
+
+// the moment of inertia of the solid hull per unit mass
+float ConvexHull::MomentOfInertia() const
+	{ // MomentOfInertia()
+	// split the hull into tetrahedra from the origin to each face: one with
+	// corners 0, a, b, c has volume a.(b x c) / 6 and integral of |r|^2 over it
+	// of volume (|a|^2 + |b|^2 + |c|^2 + |a + b + c|^2) / 20
+	double volume = 0.0, secondMoment = 0.0;
+	for (size_t face = 0; face + 2 < faceVertices.size(); face += 3)
+		{ // per face
+		const Cartesian3 &a = vertices[faceVertices[face]];
+		const Cartesian3 &b = vertices[faceVertices[face + 1]];
+		const Cartesian3 &c = vertices[faceVertices[face + 2]];
+		double tetrahedron = a.dot(b.cross(c)) / 6.0;
+		Cartesian3 sum = a + b + c;
+		volume += tetrahedron;
+		secondMoment += tetrahedron * (a.dot(a) + b.dot(b) + c.dot(c) + sum.dot(sum)) / 20.0;
+		} // per face
+
+	// the trace of the inertia tensor is twice the second moment
+	if (volume > 0.0)
+		return (float) (2.0 / 3.0 * secondMoment / volume);
+	float radius = 0.0;
+	for (const Cartesian3 &vertex : vertices)
+		radius = std::max(radius, vertex.length());
+	return 0.4 * radius * radius;
+	} // MomentOfInertia()
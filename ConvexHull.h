@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	ConvexHull.h
+//	------------------------
+//
+//	The convex hull of a point set, with a vertex
+//	adjacency graph for fast support-point queries
+//
+///////////////////////////////////////////////////
+
+#ifndef _CONVEX_HULL_H
+#define _CONVEX_HULL_H
+
+#include <vector>
+
+#include "Cartesian3.h"
+
+class ConvexHull
+	{ // class ConvexHull
+	public:
+	// the vertices on the hull
+	std::vector<Cartesian3> vertices;
+
+	// hull triangles as vertex index triples, CCW seen from outside
+	std::vector<int> faceVertices;
+
+	// neighbours of vertex v are adjacency[adjacencyStart[v] .. adjacencyStart[v+1])
+	std::vector<int> adjacencyStart;
+	std::vector<int> adjacency;
+
+	// constructor
+	ConvexHull();
+
+	// compute the hull of a point set: returns false if the points are
+	// degenerate (fewer than four, or all coplanar), in which case every
+	// point is kept and Support() falls back to a linear scan
+	bool Build(const std::vector<Cartesian3> &points);
+
+	// index of the hull vertex furthest in a direction
+	// the search climbs the adjacency graph from startVertex, so passing the
+	// previous answer for a slowly rotating body makes it nearly constant time
+	int Support(const Cartesian3 &direction, int startVertex = 0) const;
+
+	// the moment of inertia per unit mass of the solid hull about the origin,
+	// averaged over the three axes (exact for a shape as symmetric as a
+	// dodecahedron or a sphere); 0.4 r^2 of the furthest vertex if it has no faces
+	float MomentOfInertia() const;
+	}; // class ConvexHull
+
+#endif
@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	HeightGrid.cpp
+//	------------------------
+//
+//	A grid of height samples in one contiguous
+//	buffer, stored row-major, in 8x8 tiles, or in
+//	Morton (Z) order
+//
+///////////////////////////////////////////////////
+
+#include "HeightGrid.h"
+
+// spread the bits of a value out to the even bit positions
+static long SpreadBits(long value)
+	{ // SpreadBits()
+	long spread = 0;
+	for (int bit = 0; value >> bit; bit++)
+		spread |= ((value >> bit) & 1L) << (2 * bit);
+	return spread;
+	} // SpreadBits()
+
+// constructor
+HeightGrid::HeightGrid()
+	:
+	nRows(0),
+	nColumns(0),
+	layout(Tiled),
+	data(NULL),
+	bufferSize(0)
+	{ // constructor
+	} // constructor
+
+// copies own their samples if the original did
+HeightGrid::HeightGrid(const HeightGrid &other)
+	{ // copy constructor
+	*this = other;
+	} // copy constructor
+
+HeightGrid &HeightGrid::operator =(const HeightGrid &other)
+	{ // operator =()
+	if (this == &other)
+		return *this;
+	nRows = other.nRows;
+	nColumns = other.nColumns;
+	layout = other.layout;
+	samples = other.samples;
+	bufferSize = other.bufferSize;
+	rowOffset = other.rowOffset;
+	columnOffset = other.columnOffset;
+	data = other.IsView() ? other.data : samples.data();
+	return *this;
+	} // operator =()
+
+// take a row-major array of samples, storing it in a layout
+void HeightGrid::Assign(long NRows, long NColumns, const std::vector<float> &rowMajor, Layout NewLayout)
+	{ // Assign()
+	nRows = NRows;
+	nColumns = NColumns;
+	layout = NewLayout;
+	bufferSize = BuildIndexing();
+
+	// the padding reads as zero
+	samples.assign(bufferSize, 0.0);
+	data = samples.data();
+
+	for (long row = 0; row < nRows; row++)
+		for (long column = 0; column < nColumns; column++)
+			Set(row, column, rowMajor[row * nColumns + column]);
+	} // Assign()
+
+// look at samples stored elsewhere in a layout, without copying
+bool HeightGrid::View(long NRows, long NColumns, Layout NewLayout, const float *external, long sampleCount)
+	{ // View()
+	nRows = NRows;
+	nColumns = NColumns;
+	layout = NewLayout;
+	bufferSize = BuildIndexing();
+	samples.clear();
+	samples.shrink_to_fit();
+	data = external;
+
+	if (sampleCount != bufferSize)
+		{ // wrong size
+		nRows = nColumns = bufferSize = 0;
+		data = NULL;
+		return false;
+		} // wrong size
+	return true;
+	} // View()
+
+// reorder the samples into another layout
+void HeightGrid::SetLayout(Layout newLayout)
+	{ // SetLayout()
+	if (newLayout == layout && !IsView())
+		return;
+	std::vector<float> rowMajor;
+	CopyRowMajor(rowMajor);
+	Assign(nRows, nColumns, rowMajor, newLayout);
+	} // SetLayout()
+
+// copy the samples out in row-major order
+void HeightGrid::CopyRowMajor(std::vector<float> &rowMajor) const
+	{ // CopyRowMajor()
+	rowMajor.resize(nRows * nColumns);
+	for (long row = 0; row < nRows; row++)
+		for (long column = 0; column < nColumns; column++)
+			rowMajor[row * nColumns + column] = At(row, column);
+	} // CopyRowMajor()
+
+// set up the index tables for the current layout, returning the padded size
+long HeightGrid::BuildIndexing()
+	{ // BuildIndexing()
+	// there is a guard row and column past the last, so that the lookup of the
+	// square beyond the far edge (which getHeight() makes for points off the
+	// grid) stays inside the buffer
+	rowOffset.resize(nRows + 1);
+	columnOffset.resize(nColumns + 1);
+
+	long size = 0;
+	if (layout == Tiled)
+		{ // tiled
+		// pad out to whole tiles
+		long tilesPerRow = (nColumns + tileSize) / tileSize;
+		long tileRows = (nRows + tileSize) / tileSize;
+		long tileArea = tileSize * tileSize;
+		for (long row = 0; row <= nRows; row++)
+			rowOffset[row] = (int) ((row / tileSize) * tilesPerRow * tileArea + (row % tileSize) * tileSize);
+		for (long column = 0; column <= nColumns; column++)
+			columnOffset[column] = (int) ((column / tileSize) * tileArea + column % tileSize);
+		size = tilesPerRow * tileRows * tileArea;
+		} // tiled
+	else if (layout == Morton)
+		{ // Morton
+		// pad out to a power-of-two square, rows on the odd bits and columns on the even
+		long side = 1;
+		while (side <= nRows || side <= nColumns)
+			side *= 2;
+		for (long row = 0; row <= nRows; row++)
+			rowOffset[row] = (int) (SpreadBits(row) << 1);
+		for (long column = 0; column <= nColumns; column++)
+			columnOffset[column] = (int) SpreadBits(column);
+		size = side * side;
+		} // Morton
+	else
+		{ // row-major
+		for (long row = 0; row <= nRows; row++)
+			rowOffset[row] = (int) (row * nColumns);
+		for (long column = 0; column <= nColumns; column++)
+			columnOffset[column] = (int) column;
+		size = (nRows + 1) * nColumns + 1;
+		} // row-major
+
+	return size;
+	} // BuildIndexing()
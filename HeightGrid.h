@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	HeightGrid.h
+//	------------------------
+//
+//	A grid of height samples in one contiguous
+//	buffer, stored row-major, in 8x8 tiles, or in
+//	Morton (Z) order
+//
+///////////////////////////////////////////////////
+
+#ifndef _HEIGHT_GRID_H
+#define _HEIGHT_GRID_H
+
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+class HeightGrid
+	{ // class HeightGrid
+	public:
+	// how the samples are ordered in memory
+	enum Layout
+		{ // enum Layout
+		// row after row, as in the .dem file
+		RowMajor,
+		// 8x8 tiles, each row-major, tiles in row-major order: a 2x2 lookup
+		// touches one 64-byte line unless it straddles a tile edge
+		Tiled,
+		// bits of row and column interleaved over a power-of-two square
+		Morton
+		}; // enum Layout
+
+	// edge length of a tile in the Tiled layout
+	static const int tileSize = 8;
+
+	// the grid is logically nRows x nColumns
+	long nRows, nColumns;
+
+	// the ordering in use
+	Layout layout;
+
+	// the samples, in the order given by layout (padded for Tiled and Morton),
+	// aligned so that each pair of rows in a tile shares a cache line
+	// this is empty when the grid is a view of memory it doesn't own
+	std::vector<float, AlignedAllocator<float, 64> > samples;
+
+	// constructor
+	HeightGrid();
+
+	// copies own their samples if the original did
+	HeightGrid(const HeightGrid &other);
+	HeightGrid &operator =(const HeightGrid &other);
+
+	// take a row-major array of samples (as loaded from a file), storing it in a layout
+	void Assign(long NRows, long NColumns, const std::vector<float> &rowMajor, Layout NewLayout = Tiled);
+
+	// look at samples stored elsewhere (such as a mapped file) in a layout, without copying
+	// returns false if sampleCount doesn't match the padded size of the layout
+	bool View(long NRows, long NColumns, Layout NewLayout, const float *external, long sampleCount);
+
+	// true if the samples are a view, which can be read but not Set()
+	bool IsView() const { return nRows > 0 && samples.empty(); }
+
+	// the number of floats in the buffer, counting padding
+	long BufferSize() const { return bufferSize; }
+
+	// reorder the samples into another layout (a view becomes a copy)
+	void SetLayout(Layout newLayout);
+
+	// copy the samples out in row-major order
+	void CopyRowMajor(std::vector<float> &rowMajor) const;
+
+	// number of rows and columns
+	long Rows() const { return nRows; }
+	long Columns() const { return nColumns; }
+	bool Empty() const { return nRows == 0 || nColumns == 0; }
+
+	// position of a sample in the buffer: every layout separates into a row
+	// part and a column part, so this is two small table lookups and no branch
+	inline long Index(long row, long column) const
+		{ return rowOffset[row] + columnOffset[column]; }
+
+	// the raw tables, for vectorised lookups that gather through them
+	// (rows and columns 0 .. nRows and 0 .. nColumns, counting the guard)
+	const int *RowOffsets() const { return rowOffset.data(); }
+	const int *ColumnOffsets() const { return columnOffset.data(); }
+	const float *Data() const { return data; }
+
+	// read and write a sample
+	inline float At(long row, long column) const
+		{ return data[Index(row, column)]; }
+	inline void Set(long row, long column, float value)
+		{ samples[Index(row, column)] = value; }
+
+	private:
+	// the samples being read: either samples.data() or external memory
+	const float *data;
+	long bufferSize;
+
+	// the row and column parts of each sample's index
+	// (32-bit so that AVX2 can gather them eight at a time)
+	std::vector<int> rowOffset, columnOffset;
+
+	// set up the index tables for the current layout, returning the padded size
+	long BuildIndexing();
+	}; // class HeightGrid
+
+#endif
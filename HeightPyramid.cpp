@@ -0,0 +1,208 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	HeightPyramid.cpp
+//	------------------------
+//
+//	A min/max mip pyramid over the squares of a
+//	height grid, so that queries can skip whole
+//	regions the terrain can't reach
+//
+///////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include "HeightPyramid.h"
+
+// constructor
+HeightPyramid::HeightPyramid()
+	:
+	cellSize(1),
+	nSquareRows(0),
+	nSquareColumns(0)
+	{ // constructor
+	} // constructor
+
+// build from a grid, with one level 0 cell per square
+void HeightPyramid::Build(const HeightGrid &grid)
+	{ // Build()
+	levels.clear();
+	cellSize = 1;
+	nSquareRows = grid.Rows() - 1;
+	nSquareColumns = grid.Columns() - 1;
+	if (nSquareRows < 1 || nSquareColumns < 1)
+		{ nSquareRows = nSquareColumns = 0; return; }
+
+	levels.resize(1);
+	levels[0].nRows = nSquareRows;
+	levels[0].nColumns = nSquareColumns;
+	levels[0].low.resize(nSquareRows * nSquareColumns);
+	levels[0].high.resize(nSquareRows * nSquareColumns);
+	Update(grid, 0, 0, nSquareRows - 1, nSquareColumns - 1);
+	} // Build()
+
+// build from level 0 bounds computed elsewhere
+void HeightPyramid::Build(long NSquareRows, long NSquareColumns, long CellSize, const std::vector<float> &low, const std::vector<float> &high)
+	{ // Build()
+	levels.clear();
+	cellSize = CellSize;
+	nSquareRows = NSquareRows;
+	nSquareColumns = NSquareColumns;
+	if (nSquareRows < 1 || nSquareColumns < 1)
+		{ nSquareRows = nSquareColumns = 0; return; }
+
+	levels.resize(1);
+	levels[0].nRows = (nSquareRows + cellSize - 1) / cellSize;
+	levels[0].nColumns = (nSquareColumns + cellSize - 1) / cellSize;
+	levels[0].low = low;
+	levels[0].high = high;
+	BuildLevels();
+	} // Build()
+
+// add the levels above level 0
+void HeightPyramid::BuildLevels()
+	{ // BuildLevels()
+	levels.resize(1);
+	while (levels.back().nRows > 1 || levels.back().nColumns > 1)
+		{ // per level
+		Level next;
+		next.nRows = (levels.back().nRows + 1) / 2;
+		next.nColumns = (levels.back().nColumns + 1) / 2;
+		next.low.resize(next.nRows * next.nColumns);
+		next.high.resize(next.nRows * next.nColumns);
+		levels.push_back(next);
+		MergeCells((int) levels.size() - 1, 0, 0, next.nRows - 1, next.nColumns - 1);
+		} // per level
+	} // BuildLevels()
+
+// merge 2x2 cells of the level below into a block of cells
+void HeightPyramid::MergeCells(int level, long firstRow, long firstColumn, long lastRow, long lastColumn)
+	{ // MergeCells()
+	const Level &below = levels[level - 1];
+	Level &above = levels[level];
+	for (long row = firstRow; row <= lastRow; row++)
+		for (long column = firstColumn; column <= lastColumn; column++)
+			{ // per cell
+			// the last row or column below may have no partner
+			long lastChildRow = std::min(2 * row + 1, below.nRows - 1);
+			long lastChildColumn = std::min(2 * column + 1, below.nColumns - 1);
+			float low = below.low[2 * row * below.nColumns + 2 * column];
+			float high = below.high[2 * row * below.nColumns + 2 * column];
+			for (long childRow = 2 * row; childRow <= lastChildRow; childRow++)
+				for (long childColumn = 2 * column; childColumn <= lastChildColumn; childColumn++)
+					{ // per child
+					low = std::min(low, below.low[childRow * below.nColumns + childColumn]);
+					high = std::max(high, below.high[childRow * below.nColumns + childColumn]);
+					} // per child
+			above.low[row * above.nColumns + column] = low;
+			above.high[row * above.nColumns + column] = high;
+			} // per cell
+	} // MergeCells()
+
+// recompute the cells over a block of squares after their samples changed
+void HeightPyramid::Update(const HeightGrid &grid, long firstRow, long firstColumn, long lastRow, long lastColumn)
+	{ // Update()
+	if (levels.empty() || cellSize != 1)
+		return;
+	firstRow = std::max(firstRow, 0L);
+	firstColumn = std::max(firstColumn, 0L);
+	lastRow = std::min(lastRow, nSquareRows - 1);
+	lastColumn = std::min(lastColumn, nSquareColumns - 1);
+	if (firstRow > lastRow || firstColumn > lastColumn)
+		return;
+
+	// level 0 from the corners of each square
+	Level &base = levels[0];
+	for (long row = firstRow; row <= lastRow; row++)
+		for (long column = firstColumn; column <= lastColumn; column++)
+			{ // per square
+			float upperLeft = grid.At(row, column), upperRight = grid.At(row, column + 1);
+			float lowerLeft = grid.At(row + 1, column), lowerRight = grid.At(row + 1, column + 1);
+			base.low[row * base.nColumns + column] = std::min(std::min(upperLeft, upperRight), std::min(lowerLeft, lowerRight));
+			base.high[row * base.nColumns + column] = std::max(std::max(upperLeft, upperRight), std::max(lowerLeft, lowerRight));
+			} // per square
+
+	if (levels.size() == 1)
+		{ // first build
+		BuildLevels();
+		return;
+		} // first build
+
+	// then only the cells above the changed block
+	for (int level = 1; level < (int) levels.size(); level++)
+		{ // per level
+		firstRow /= 2;
+		firstColumn /= 2;
+		lastRow /= 2;
+		lastColumn /= 2;
+		MergeCells(level, firstRow, firstColumn, lastRow, lastColumn);
+		} // per level
+	} // Update()
+
+// the lowest and highest height over a block of squares
+void HeightPyramid::Range(long firstRow, long firstColumn, long lastRow, long lastColumn, float &low, float &high) const
+	{ // Range()
+	low = levels.back().high[0];
+	high = levels.back().low[0];
+	RangeCell((int) levels.size() - 1, 0, 0, firstRow / cellSize, firstColumn / cellSize, lastRow / cellSize, lastColumn / cellSize, low, high);
+	} // Range()
+
+// true if every height over a block of squares is below z
+bool HeightPyramid::Below(long firstRow, long firstColumn, long lastRow, long lastColumn, float z) const
+	{ // Below()
+	return BelowCell((int) levels.size() - 1, 0, 0, firstRow / cellSize, firstColumn / cellSize, lastRow / cellSize, lastColumn / cellSize, z);
+	} // Below()
+
+// widen low and high by the part of a cell inside the query
+void HeightPyramid::RangeCell(int level, long row, long column, long firstRow, long firstColumn, long lastRow, long lastColumn, float &low, float &high) const
+	{ // RangeCell()
+	// the level 0 cells this one covers
+	long cellFirstRow = row << level, cellLastRow = std::min(((row + 1) << level) - 1, levels[0].nRows - 1);
+	long cellFirstColumn = column << level, cellLastColumn = std::min(((column + 1) << level) - 1, levels[0].nColumns - 1);
+	if (cellFirstRow > lastRow || cellLastRow < firstRow || cellFirstColumn > lastColumn || cellLastColumn < firstColumn)
+		return;
+
+	// a cell wholly inside the query (or at the bottom) counts as it is
+	const Level &here = levels[level];
+	if (level == 0 || (cellFirstRow >= firstRow && cellLastRow <= lastRow && cellFirstColumn >= firstColumn && cellLastColumn <= lastColumn))
+		{ // inside
+		low = std::min(low, here.low[row * here.nColumns + column]);
+		high = std::max(high, here.high[row * here.nColumns + column]);
+		return;
+		} // inside
+
+	// and one it only overlaps is split, unless it can't change the answer
+	if (here.low[row * here.nColumns + column] >= low && here.high[row * here.nColumns + column] <= high)
+		return;
+	const Level &below = levels[level - 1];
+	for (long childRow = 2 * row; childRow <= std::min(2 * row + 1, below.nRows - 1); childRow++)
+		for (long childColumn = 2 * column; childColumn <= std::min(2 * column + 1, below.nColumns - 1); childColumn++)
+			RangeCell(level - 1, childRow, childColumn, firstRow, firstColumn, lastRow, lastColumn, low, high);
+	} // RangeCell()
+
+// true if every height in the part of a cell inside the query is below z
+bool HeightPyramid::BelowCell(int level, long row, long column, long firstRow, long firstColumn, long lastRow, long lastColumn, float z) const
+	{ // BelowCell()
+	long cellFirstRow = row << level, cellLastRow = std::min(((row + 1) << level) - 1, levels[0].nRows - 1);
+	long cellFirstColumn = column << level, cellLastColumn = std::min(((column + 1) << level) - 1, levels[0].nColumns - 1);
+	if (cellFirstRow > lastRow || cellLastRow < firstRow || cellFirstColumn > lastColumn || cellLastColumn < firstColumn)
+		return true;
+
+	// the whole cell is below, or none of it is
+	const Level &here = levels[level];
+	if (here.high[row * here.nColumns + column] < z)
+		return true;
+	if (here.low[row * here.nColumns + column] >= z)
+		return false;
+
+	// the highest point is in the query if the cell is inside it
+	if (level == 0 || (cellFirstRow >= firstRow && cellLastRow <= lastRow && cellFirstColumn >= firstColumn && cellLastColumn <= lastColumn))
+		return false;
+
+	const Level &below = levels[level - 1];
+	for (long childRow = 2 * row; childRow <= std::min(2 * row + 1, below.nRows - 1); childRow++)
+		for (long childColumn = 2 * column; childColumn <= std::min(2 * column + 1, below.nColumns - 1); childColumn++)
+			if (!BelowCell(level - 1, childRow, childColumn, firstRow, firstColumn, lastRow, lastColumn, z))
+				return false;
+	return true;
+	} // BelowCell()
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	HeightPyramid.h
+//	------------------------
+//
+//	A min/max mip pyramid over the squares of a
+//	height grid, so that queries can skip whole
+//	regions the terrain can't reach
+//
+///////////////////////////////////////////////////
+
+#ifndef _HEIGHT_PYRAMID_H
+#define _HEIGHT_PYRAMID_H
+
+#include <vector>
+
+#include "HeightGrid.h"
+
+class HeightPyramid
+	{ // class HeightPyramid
+	public:
+	// one level: the lowest and highest height in each cell, row-major
+	struct Level
+		{ // struct Level
+		long nRows, nColumns;
+		std::vector<float> low, high;
+		}; // struct Level
+
+	// level 0 has a cell per cellSize x cellSize squares, and each level above
+	// merges 2x2 cells of the one below, up to a single cell
+	std::vector<Level> levels;
+
+	// squares along the edge of a level 0 cell
+	long cellSize;
+
+	// the number of squares down and across
+	long nSquareRows, nSquareColumns;
+
+	// constructor
+	HeightPyramid();
+
+	// build from a grid, with one level 0 cell per square
+	void Build(const HeightGrid &grid);
+
+	// build from level 0 bounds computed elsewhere (such as once per page of a
+	// paged terrain), each cell covering CellSize x CellSize of the squares
+	void Build(long NSquareRows, long NSquareColumns, long CellSize, const std::vector<float> &low, const std::vector<float> &high);
+
+	// recompute the cells over the squares [firstRow, lastRow] x [firstColumn, lastColumn]
+	// after their samples in grid have changed (one square per cell only)
+	void Update(const HeightGrid &grid, long firstRow, long firstColumn, long lastRow, long lastColumn);
+
+	// true if nothing has been built
+	bool Empty() const { return levels.empty(); }
+
+	// the lowest and highest height over the squares [firstRow, lastRow] x
+	// [firstColumn, lastColumn], which must lie on the grid.  Bounds are exact
+	// to the level 0 cells, so a coarse level 0 may widen them
+	void Range(long firstRow, long firstColumn, long lastRow, long lastColumn, float &low, float &high) const;
+
+	// true if every height over the squares is below z; unlike Range(), this
+	// stops descending as soon as a cell settles the answer
+	bool Below(long firstRow, long firstColumn, long lastRow, long lastColumn, float z) const;
+
+	private:
+	// merge 2x2 cells of level - 1 into the cells [firstRow, lastRow] x [firstColumn, lastColumn] of level
+	void MergeCells(int level, long firstRow, long firstColumn, long lastRow, long lastColumn);
+
+	// add the levels above level 0
+	void BuildLevels();
+
+	// the recursive parts of Range() and Below(), with the query in level 0 cells
+	void RangeCell(int level, long row, long column, long firstRow, long firstColumn, long lastRow, long lastColumn, float &low, float &high) const;
+	bool BelowCell(int level, long row, long column, long firstRow, long firstColumn, long lastRow, long lastColumn, float z) const;
+	}; // class HeightPyramid
+
+#endif
@@ -18,14 +18,30 @@
 
 
 #include "IndexedFaceSurface.h"
+#include "MappedMesh.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
 #include <iostream>
 #include <iomanip>
 #include <fstream>
 #include <math.h>
 #include <cstring>
+#include <algorithm>
+#include <cstddef>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// PHYSICS_HEADLESS builds (the benchmark) have no GL, and Render() does nothing
+// buffer objects are GL 1.5, which Windows only offers through its extension
+// loader, so there the same draw call reads the render mesh from client memory
+#ifndef PHYSICS_HEADLESS
 #ifdef _WIN32
 #include <windows.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#define INDEXED_FACE_BUFFERS
 #endif
 #ifdef __APPLE__
 #include <OpenGL/gl.h>
@@ -34,21 +50,54 @@
 #include <GL/gl.h>
 #include <GL/glu.h>
 #endif
+#endif
 
 // constructor will initialise to safe values
 IndexedFaceSurface::IndexedFaceSurface()
+	:
+	vertexBuffer(0),
+	indexBuffer(0),
+	buffersStale(true)
 	{ // IndexedFaceSurface::IndexedFaceSurface()
 	// force the size to nil (should not be necessary, but . . .)
 	vertices.resize(0);
 	normals.resize(0);
 	} // IndexedFaceSurface::IndexedFaceSurface()
 
+// copies share the mesh but not the GL buffers
+IndexedFaceSurface::IndexedFaceSurface(const IndexedFaceSurface &other)
+	:
+	faceVertices(other.faceVertices),
+	vertices(other.vertices),
+	normals(other.normals),
+	renderVertices(other.renderVertices),
+	renderIndices(other.renderIndices),
+	renderShortIndices(other.renderShortIndices),
+	vertexBuffer(0),
+	indexBuffer(0),
+	buffersStale(true)
+	{ // IndexedFaceSurface::IndexedFaceSurface()
+	} // IndexedFaceSurface::IndexedFaceSurface()
+
+// assignment keeps our own buffers, and uploads the new mesh into them
+IndexedFaceSurface &IndexedFaceSurface::operator =(const IndexedFaceSurface &other)
+	{ // IndexedFaceSurface::operator =()
+	faceVertices = other.faceVertices;
+	vertices = other.vertices;
+	normals = other.normals;
+	renderVertices = other.renderVertices;
+	renderIndices = other.renderIndices;
+	renderShortIndices = other.renderShortIndices;
+	buffersStale = true;
+	return *this;
+	} // IndexedFaceSurface::operator =()
+
 // read routine returns true on success, failure otherwise
 bool IndexedFaceSurface::ReadFileIndexedFace(const char *fileName)
 	{ // IndexedFaceSurface::ReadFileIndexedFace()
 	// open the input file
 	std::ifstream inFile(fileName);
-	if (inFile.bad())
+	if (!inFile.is_open())
 		return false;
 	
 	// assume that file format is ABSOLUTELY predictable and the lines aren't too long
@@ -85,11 +134,11 @@ bool IndexedFaceSurface::ReadFileIndexedFace(const char *fileName)
 		// scan in the vertex ID
 		inFile >> token >> vertexID;
 
-		// if it didn't scan properly, or was the wrong ID, exit
-		if ((strcmp(token, "Vertex") != 0) || (vertexID != vertex))
+		// if it didn't scan properly, or was the wrong ID, give up
+		if (!inFile || (strcmp(token, "Vertex") != 0) || (vertexID != vertex))
 			{ // scan failed
 			printf("Invalid vertex %ld\n", vertex); 
-			exit(0); 
+			return false;
 			} // scan failed
 
 		// now read in the vertex
@@ -103,15 +152,21 @@ bool IndexedFaceSurface::ReadFileIndexedFace(const char *fileName)
 		long faceID;
 		// scan in the vertex ID
 		inFile >> token >> faceID;
-		// if it didn't scan, or was the wrong ID, exit
-		if ((strcmp("Face", token) != 0) || (faceID != face))
+		// if it didn't scan, or was the wrong ID, give up
+		if (!inFile || (strcmp("Face", token) != 0) || (faceID != face))
 			{ // scan failed
 			printf("Invalid face %ld\n", face); 
-			exit(0); 
+			return false;
 			} // scan failed
 
-		// read in the vertex IDs
+		// read in the vertex IDs, which must name vertices we have
 		inFile >> faceVertices[3*face] >> faceVertices[3*face+1] >> faceVertices[3*face+2];
+		for (int corner = 0; corner < 3; corner++)
+			if (!inFile || faceVertices[3*face+corner] < 0 || faceVertices[3*face+corner] >= nVertices)
+				{ // bad vertex
+				printf("Invalid face %ld\n", face); 
+				return false;
+				} // bad vertex
 		} // for each face		
 
 	// call the routine to compute normals
@@ -120,14 +175,143 @@ bool IndexedFaceSurface::ReadFileIndexedFace(const char *fileName)
 	return true;
 	} // IndexedFaceSurface::ReadFileIndexedFace()
 
+static const char binaryMeshMagic[4] = { 'B', 'F', 'A', 'C' };
+static const uint32_t binaryMeshByteOrder = 0x01020304;
+static const uint32_t binaryMeshVersion = 1;
+
+// round a file offset up to a cache line
+static uint64_t AlignOffset(uint64_t offset)
+	{ // AlignOffset()
+	return (offset + 63) & ~(uint64_t) 63;
+	} // AlignOffset()
+
+// check that a header is one we can read and that its blocks fit in the file
+bool CheckBinaryMeshHeader(const BinaryMeshHeader &header, uint64_t fileSize)
+	{ // CheckBinaryMeshHeader()
+	// counts are checked against the file first, so that the block sizes can't overflow
+	return memcmp(header.magic, binaryMeshMagic, 4) == 0 && header.byteOrder == binaryMeshByteOrder
+		&& header.version == binaryMeshVersion
+		&& header.vertexCount <= fileSize && header.faceCount <= fileSize
+		&& header.verticesOffset % 64 == 0 && header.indicesOffset % 64 == 0 && header.normalsOffset % 64 == 0
+		&& header.verticesOffset >= sizeof(header) && header.verticesOffset + header.vertexCount * sizeof(Cartesian3) <= fileSize
+		&& header.indicesOffset + header.faceCount * 3 * sizeof(int) <= fileSize
+		&& header.normalsOffset + header.faceCount * sizeof(Cartesian3) <= fileSize;
+	} // CheckBinaryMeshHeader()
+
+// read a binary mesh
+bool IndexedFaceSurface::ReadFileBinaryMesh(const char *fileName)
+	{ // IndexedFaceSurface::ReadFileBinaryMesh()
+	MappedMesh mesh;
+	if (!mesh.Open(fileName))
+		return false;
+
+	// the arrays are laid out as ours are, so each is one copy
+	vertices.assign(mesh.Vertices(), mesh.Vertices() + mesh.VertexCount());
+	faceVertices.assign(mesh.FaceVertices(), mesh.FaceVertices() + 3 * mesh.FaceCount());
+	normals.assign(mesh.Normals(), mesh.Normals() + mesh.FaceCount());
+	buffersStale = true;
+	return true;
+	} // IndexedFaceSurface::ReadFileBinaryMesh()
+
+// write the mesh as a binary file
+bool IndexedFaceSurface::WriteFileBinaryMesh(const char *fileName) const
+	{ // IndexedFaceSurface::WriteFileBinaryMesh()
+	if (normals.size() * 3 != faceVertices.size())
+		return false;
+	std::ofstream outFile(fileName, std::ios::binary);
+	if (!outFile.good())
+		return false;
+
+	BinaryMeshHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, binaryMeshMagic, 4);
+	header.byteOrder = binaryMeshByteOrder;
+	header.version = binaryMeshVersion;
+	header.vertexCount = vertices.size();
+	header.faceCount = normals.size();
+	header.verticesOffset = AlignOffset(sizeof(header));
+	header.indicesOffset = AlignOffset(header.verticesOffset + header.vertexCount * sizeof(Cartesian3));
+	header.normalsOffset = AlignOffset(header.indicesOffset + header.faceCount * 3 * sizeof(int));
+
+	// each block starts on a cache line
+	static const char zeroes[64] = { 0 };
+	outFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	outFile.write(zeroes, header.verticesOffset - sizeof(header));
+	outFile.write(reinterpret_cast<const char *>(vertices.data()), header.vertexCount * sizeof(Cartesian3));
+	outFile.write(zeroes, header.indicesOffset - (header.verticesOffset + header.vertexCount * sizeof(Cartesian3)));
+	outFile.write(reinterpret_cast<const char *>(faceVertices.data()), header.faceCount * 3 * sizeof(int));
+	outFile.write(zeroes, header.normalsOffset - (header.indicesOffset + header.faceCount * 3 * sizeof(int)));
+	outFile.write(reinterpret_cast<const char *>(normals.data()), header.faceCount * sizeof(Cartesian3));
+	return outFile.good();
+	} // IndexedFaceSurface::WriteFileBinaryMesh()
+
 // routine to compute unit normal vectors
-void IndexedFaceSurface::ComputeUnitNormalVectors()
+void IndexedFaceSurface::ComputeUnitNormalVectors(JobSystem *jobSystem)
 	{ // ComputeUnitNormalVectors()
 	// assume that the triangle vertices are set correctly, and allocate one third of that for normals
 	normals.resize(faceVertices.size() / 3);
-	
+	long nTriangles = (long) normals.size();
+	buffersStale = true;
+
+	// and compute all of them, in chunks across the cores if we can
+	const int trianglesPerJob = 16384;
+	if (jobSystem != NULL && nTriangles > trianglesPerJob)
+		jobSystem->ParallelFor((int) nTriangles, trianglesPerJob, [this](int begin, int end)
+			{ ComputeUnitNormalVectors(begin, end - 1); });
+	else
+		ComputeUnitNormalVectors(0, nTriangles - 1);
+	} // ComputeUnitNormalVectors()
+
+// recompute the normals of a range of triangles
+void IndexedFaceSurface::ComputeUnitNormalVectors(long firstTriangle, long lastTriangle)
+	{ // ComputeUnitNormalVectors()
+	if (firstTriangle > lastTriangle)
+		return;
+	buffersStale = true;
+#if defined(__AVX2__)
+	// eight triangles at a time, gathering their corners out of the arrays of
+	// Cartesian3; every triangle goes through this path, those past the end
+	// repeating the last, so a normal doesn't depend on where a range starts
+	const float *vertexData = &vertices[0].x;
+	const int *faceData = faceVertices.data();
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i three = _mm256_set1_epi32(3);
+	const __m256i last = _mm256_set1_epi32((int) lastTriangle);
+	for (long triangle = firstTriangle; triangle <= lastTriangle; triangle += 8)
+		{ // per eight triangles
+		__m256i ids = _mm256_min_epi32(_mm256_add_epi32(_mm256_set1_epi32((int) triangle), lanes), last);
+		__m256i corner = _mm256_mullo_epi32(ids, three);
+		__m256i p = _mm256_mullo_epi32(_mm256_i32gather_epi32(faceData, corner, 4), three);
+		__m256i q = _mm256_mullo_epi32(_mm256_i32gather_epi32(faceData + 1, corner, 4), three);
+		__m256i r = _mm256_mullo_epi32(_mm256_i32gather_epi32(faceData + 2, corner, 4), three);
+
+		// the two edge vectors
+		__m256 px = _mm256_i32gather_ps(vertexData, p, 4);
+		__m256 py = _mm256_i32gather_ps(vertexData + 1, p, 4);
+		__m256 pz = _mm256_i32gather_ps(vertexData + 2, p, 4);
+		__m256 ux = _mm256_sub_ps(_mm256_i32gather_ps(vertexData, q, 4), px);
+		__m256 uy = _mm256_sub_ps(_mm256_i32gather_ps(vertexData + 1, q, 4), py);
+		__m256 uz = _mm256_sub_ps(_mm256_i32gather_ps(vertexData + 2, q, 4), pz);
+		__m256 vx = _mm256_sub_ps(_mm256_i32gather_ps(vertexData, r, 4), px);
+		__m256 vy = _mm256_sub_ps(_mm256_i32gather_ps(vertexData + 1, r, 4), py);
+		__m256 vz = _mm256_sub_ps(_mm256_i32gather_ps(vertexData + 2, r, 4), pz);
+
+		// their cross product, normalised
+		__m256 nx = _mm256_sub_ps(_mm256_mul_ps(uy, vz), _mm256_mul_ps(uz, vy));
+		__m256 ny = _mm256_sub_ps(_mm256_mul_ps(uz, vx), _mm256_mul_ps(ux, vz));
+		__m256 nz = _mm256_sub_ps(_mm256_mul_ps(ux, vy), _mm256_mul_ps(uy, vx));
+		__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+		float x[8], y[8], z[8];
+		_mm256_storeu_ps(x, _mm256_div_ps(nx, length));
+		_mm256_storeu_ps(y, _mm256_div_ps(ny, length));
+		_mm256_storeu_ps(z, _mm256_div_ps(nz, length));
+		int count = (int) std::min(8L, lastTriangle - triangle + 1);
+		for (int lane = 0; lane < count; lane++)
+			normals[triangle + lane] = Cartesian3(x[lane], y[lane], z[lane]);
+		} // per eight triangles
+#else
 	// loop through the triangles, computing normal vectors
-	for (int triangle = 0; triangle < (int) normals.size(); triangle++)
+	for (long triangle = firstTriangle; triangle <= lastTriangle; triangle++)
 		{ // per triangle
 		// retrieve the three vertices in Cartesian form
 		Cartesian3 vertexP = vertices[faceVertices[3 * triangle		]	];
@@ -139,26 +323,142 @@ void IndexedFaceSurface::ComputeUnitNormalVectors()
 		// compute a normal with the cross-product
 		normals[triangle] = vectorU.cross(vectorV).unit();
 		} // per triangle
+#endif
 	} // ComputeUnitNormalVectors()
 
+// build the mesh as drawn from the faces
+void IndexedFaceSurface::BuildRenderMesh(bool optimize)
+	{ // BuildRenderMesh()
+	renderVertices.clear();
+	renderIndices.clear();
+	renderShortIndices.clear();
+	renderIndices.reserve(3 * normals.size());
+
+	// the corners made so far for each vertex, with their normals; a corner is
+	// shared by the faces around the vertex with the same normal (to within
+	// rounding), as the triangles of a flat polygon have
+	std::vector<std::vector<unsigned int> > cornersOfVertex(vertices.size());
+	for (long triangle = 0; triangle < (long) normals.size(); triangle++)
+		for (int corner = 0; corner < 3; corner++)
+			{ // per corner
+			int vertex = faceVertices[3 * triangle + corner];
+			const Cartesian3 &normal = normals[triangle];
+			unsigned int index = (unsigned int) renderVertices.size();
+			for (unsigned int candidate : cornersOfVertex[vertex])
+				if ((renderVertices[candidate].normal - normal).length() < 1.0e-5)
+					{ index = candidate; break; }
+			if (index == renderVertices.size())
+				{ // new corner
+				RenderVertex renderVertex = { vertices[vertex], normal };
+				renderVertices.push_back(renderVertex);
+				cornersOfVertex[vertex].push_back(index);
+				} // new corner
+			renderIndices.push_back(index);
+			} // per corner
+
+	// a mesh whose every corner is its own, as a flat-shaded curved surface's
+	// are, gains nothing from the cache, so it is left in face order
+	if (optimize && renderVertices.size() < renderIndices.size())
+		{ // optimize
+		// triangles sharing corners together, then the corners in the order they are used
+		MeshOptimizer::ReorderTriangles(renderIndices, (long) renderVertices.size());
+		std::vector<unsigned int> oldIndices;
+		MeshOptimizer::ReorderVertices(renderIndices, (long) renderVertices.size(), oldIndices);
+		std::vector<RenderVertex> reordered(oldIndices.size());
+		for (size_t corner = 0; corner < oldIndices.size(); corner++)
+			reordered[corner] = renderVertices[oldIndices[corner]];
+		renderVertices.swap(reordered);
+		} // optimize
+
+	// half the index memory when the corners can be numbered in 16 bits
+	if (renderVertices.size() <= 65536)
+		{ // short indices
+		renderShortIndices.assign(renderIndices.begin(), renderIndices.end());
+		std::vector<unsigned int>().swap(renderIndices);
+		} // short indices
+	} // BuildRenderMesh()
+
+// reorder the faces and vertices for the vertex cache
+void IndexedFaceSurface::OptimizeFaceOrder()
+	{ // OptimizeFaceOrder()
+	std::vector<unsigned int> indices(faceVertices.begin(), faceVertices.end());
+	MeshOptimizer::ReorderTriangles(indices, (long) vertices.size());
+	std::vector<unsigned int> oldIndices;
+	MeshOptimizer::ReorderVertices(indices, (long) vertices.size(), oldIndices);
+
+	std::vector<Cartesian3> reordered(vertices.size());
+	for (size_t vertex = 0; vertex < oldIndices.size(); vertex++)
+		reordered[vertex] = vertices[oldIndices[vertex]];
+	vertices.swap(reordered);
+	faceVertices.assign(indices.begin(), indices.end());
+
+	// each face's corners are in the same order, so its normal is the same
+	ComputeUnitNormalVectors();
+	} // OptimizeFaceOrder()
+
+// free the GL buffers
+void IndexedFaceSurface::ReleaseBuffers()
+	{ // ReleaseBuffers()
+#ifdef INDEXED_FACE_BUFFERS
+	if (vertexBuffer != 0)
+		glDeleteBuffers(1, &vertexBuffer);
+	if (indexBuffer != 0)
+		glDeleteBuffers(1, &indexBuffer);
+#endif
+	vertexBuffer = indexBuffer = 0;
+	buffersStale = true;
+	} // ReleaseBuffers()
+
 // routine to render
 void IndexedFaceSurface::Render()
 	{ // IndexedFaceSurface::Render()
-	// walk through the faces rendering each one
-	glBegin(GL_TRIANGLES);
-	
-	// we loop through all of the triangles
-	for (int triangle = 0; triangle < (int) normals.size(); triangle++)
-		{ // per triangle
-		// this works because C++ guarantees that the POD data is in exactly
-		// the order stated in the class with no padding.
-		glNormal3fv(&normals[triangle].x);
-		glVertex3fv(&vertices[faceVertices[3 * triangle		]	].x);
-		glVertex3fv(&vertices[faceVertices[3 * triangle + 1	]	].x);
-		glVertex3fv(&vertices[faceVertices[3 * triangle + 2	]	].x);
-		} // per triangle
-	
-	glEnd();
+#ifndef PHYSICS_HEADLESS
+	if (buffersStale)
+		{ // mesh changed
+		BuildRenderMesh();
+#ifdef INDEXED_FACE_BUFFERS
+		// upload it, reusing the buffers if we have them
+		if (vertexBuffer == 0)
+			glGenBuffers(1, &vertexBuffer);
+		if (indexBuffer == 0)
+			glGenBuffers(1, &indexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, renderVertices.size() * sizeof(RenderVertex), renderVertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		if (!renderShortIndices.empty())
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, renderShortIndices.size() * sizeof(uint16_t), renderShortIndices.data(), GL_STATIC_DRAW);
+		else
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, renderIndices.size() * sizeof(unsigned int), renderIndices.data(), GL_STATIC_DRAW);
+#endif
+		buffersStale = false;
+		} // mesh changed
+	if (RenderIndexCount() == 0)
+		return;
+	bool shortIndices = !renderShortIndices.empty();
+	GLenum indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	// the corners interleave position and normal
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+#ifdef INDEXED_FACE_BUFFERS
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glVertexPointer(3, GL_FLOAT, sizeof(RenderVertex), (const GLvoid *) offsetof(RenderVertex, position));
+	glNormalPointer(GL_FLOAT, sizeof(RenderVertex), (const GLvoid *) offsetof(RenderVertex, normal));
+	glDrawElements(GL_TRIANGLES, (GLsizei) RenderIndexCount(), indexType, NULL);
+
+	// leave no buffer bound, since other drawing uses client memory
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+#else
+	glVertexPointer(3, GL_FLOAT, sizeof(RenderVertex), &renderVertices[0].position.x);
+	glNormalPointer(GL_FLOAT, sizeof(RenderVertex), &renderVertices[0].normal.x);
+	glDrawElements(GL_TRIANGLES, (GLsizei) RenderIndexCount(), indexType,
+		shortIndices ? (const GLvoid *) renderShortIndices.data() : (const GLvoid *) renderIndices.data());
+#endif
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+#endif
 	} // IndexedFaceSurface::Render()
 
 // routine to dump out as indexed face file
@@ -17,10 +17,31 @@
 #define _INDEXED_FACE_SURFACE_H
 
 #include <vector>
+#include <stdint.h>
 
 #include "Cartesian3.h"
 #include "Matrix3.h"
 
+class JobSystem;
+
+// the header of a binary mesh file (.bface), which is followed by the vertices,
+// the three vertex indices of each face and the face normals, each block
+// starting on a cache line so that it can be used where it is mapped
+struct BinaryMeshHeader
+	{ // struct BinaryMeshHeader
+	char magic[4];
+	// written as 0x01020304, to catch files from a machine of the other endianness
+	uint32_t byteOrder;
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t vertexCount, faceCount;
+	// byte offsets from the start of the file, multiples of 64
+	uint64_t verticesOffset, indicesOffset, normalsOffset;
+	}; // struct BinaryMeshHeader
+
+// check that a header is one we can read and that its blocks fit in fileSize bytes
+bool CheckBinaryMeshHeader(const BinaryMeshHeader &header, uint64_t fileSize);
+
 class IndexedFaceSurface
 	{ // class IndexedFaceSurface
 	public:
@@ -33,21 +54,81 @@ class IndexedFaceSurface
 	// vector to hold corresponding normal vectors
 	std::vector<Cartesian3> normals;
 
+	// a corner as drawn: since the faces are flat shaded, a vertex is repeated
+	// for each different normal of the faces around it
+	struct RenderVertex
+		{ // struct RenderVertex
+		Cartesian3 position;
+		Cartesian3 normal;
+		}; // struct RenderVertex
+
+	// the mesh as drawn: the corners and the triangles as indices into them,
+	// built from the faces when they have changed, and uploaded to GL buffers.
+	// When there are few enough corners the indices are held in 16 bits instead,
+	// and renderIndices is left empty
+	std::vector<RenderVertex> renderVertices;
+	std::vector<unsigned int> renderIndices;
+	std::vector<uint16_t> renderShortIndices;
+
 	// constructor will initialise to safe values
 	IndexedFaceSurface();
+
+	// copies share the mesh but not the GL buffers, which each uploads itself
+	IndexedFaceSurface(const IndexedFaceSurface &other);
+	IndexedFaceSurface &operator =(const IndexedFaceSurface &other);
 	
 	// read routine returns true on success, failure otherwise
 	bool ReadFileIndexedFace(const char *fileName);
+
+	// read a binary mesh (.bface): the blocks are copied out of the mapped file
+	// as they are, with no parsing and no normals to compute
+	bool ReadFileBinaryMesh(const char *fileName);
+
+	// write the mesh, with its normals, as a .bface file
+	bool WriteFileBinaryMesh(const char *fileName) const;
 	
-	// routine to compute unit normal vectors
-	void ComputeUnitNormalVectors();
+	// routine to compute unit normal vectors, split across the job system if
+	// one is given; the result doesn't depend on how the work is split
+	void ComputeUnitNormalVectors(JobSystem *jobSystem = NULL);
+
+	// recompute the normals of triangles [firstTriangle, lastTriangle] only,
+	// after some of their vertices have moved, eight at a time with AVX2
+	void ComputeUnitNormalVectors(long firstTriangle, long lastTriangle);
 	
-	// routine to render
+	// routine to render: one glDrawElements from vertex and index buffers, which
+	// are uploaded on the first call and again after the mesh changes
 	void Render();
+
+	// note that vertices, faceVertices or normals have been changed directly, so
+	// that the next Render() uploads them again (reading the file and computing
+	// the normals do this themselves)
+	void MeshChanged() { buffersStale = true; }
+
+	// build renderVertices and renderIndices from the faces, by default with the
+	// triangles reordered for the vertex cache and the corners in the order the
+	// triangles use them, unless no corner is shared and there is nothing to gain
+	void BuildRenderMesh(bool optimize = true);
+
+	// reorder the faces for the vertex cache and the vertices in the order the
+	// faces use them, keeping each face's winding, and recompute the normals
+	void OptimizeFaceOrder();
+
+	// the number of indices drawn
+	long RenderIndexCount() const { return (long) (renderIndices.size() + renderShortIndices.size()); }
+
+	// free the GL buffers, which must be done while the context is current
+	// (otherwise they are freed with the context)
+	void ReleaseBuffers();
 	
 	// routine to dump out as indexed face file
 	void WriteIndexedFace();
 
+	protected:
+	// the GL buffer names (0 until the first upload), and whether the mesh has
+	// changed since they were uploaded
+	unsigned int vertexBuffer, indexBuffer;
+	bool buffersStale;
+
 	}; // class IndexedFaceSurface
 
 #endif
@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	JobSystem.cpp
+//	------------------------
+//
+//	A small work-stealing thread pool for splitting
+//	loops over bodies across cores
+//
+///////////////////////////////////////////////////
+
+#include "JobSystem.h"
+
+// constructor: nThreads of 0 uses one thread per hardware core
+JobSystem::JobSystem(int nThreads)
+	:
+	jobGeneration(0),
+	shuttingDown(false)
+	{ // constructor
+	if (nThreads <= 0)
+		nThreads = (int) std::thread::hardware_concurrency();
+	if (nThreads <= 0)
+		nThreads = 1;
+
+	for (int thread = 0; thread < nThreads; thread++)
+		queues.push_back(new WorkQueue);
+
+	// the calling thread is thread 0, so only start the others
+	for (int thread = 1; thread < nThreads; thread++)
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, thread));
+	} // constructor
+
+// destructor joins the workers
+JobSystem::~JobSystem()
+	{ // destructor
+		{ // lock
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		shuttingDown = true;
+		} // lock
+	wakeCondition.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+	for (auto queue : queues)
+		delete queue;
+	} // destructor
+
+// total number of threads that run jobs, including the caller
+int JobSystem::ThreadCount() const
+	{ // ThreadCount()
+	return (int) queues.size();
+	} // ThreadCount()
+
+// split [0, count) into chunks of chunkSize, run them all, and wait
+void JobSystem::ParallelFor(int count, int chunkSize, const RangeFunction &function)
+	{ // ParallelFor()
+	if (count <= 0)
+		return;
+	if (chunkSize < 1)
+		chunkSize = 1;
+
+	int nChunks = (count + chunkSize - 1) / chunkSize;
+
+	// with one thread or one chunk, there is nothing to share
+	if (queues.size() == 1 || nChunks == 1)
+		{ // serial
+		for (int begin = 0; begin < count; begin += chunkSize)
+			function(begin, begin + chunkSize < count ? begin + chunkSize : count);
+		return;
+		} // serial
+
+	std::atomic<int> remaining(nChunks);
+
+	// deal the chunks out to the queues in contiguous runs, so each thread
+	// starts on neighbouring memory and only steals when it runs dry
+	int nQueues = (int) queues.size();
+	for (int queue = 0; queue < nQueues; queue++)
+		{ // per queue
+		int firstChunk = (int) ((long) nChunks * queue / nQueues);
+		int lastChunk = (int) ((long) nChunks * (queue + 1) / nQueues);
+
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		for (int chunk = firstChunk; chunk < lastChunk; chunk++)
+			{ // per chunk
+			Job job;
+			job.function = &function;
+			job.begin = chunk * chunkSize;
+			job.end = job.begin + chunkSize < count ? job.begin + chunkSize : count;
+			job.remaining = &remaining;
+			queues[queue]->jobs.push_back(job);
+			} // per chunk
+		} // per queue
+
+	// wake the workers
+		{ // lock
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		jobGeneration++;
+		} // lock
+	wakeCondition.notify_all();
+
+	// and help out until every chunk has finished
+	Job job;
+	while (remaining.load(std::memory_order_acquire) > 0)
+		{ // until done
+		if (TakeJob(0, job))
+			RunJob(job);
+		else
+			std::this_thread::yield();
+		} // until done
+	} // ParallelFor()
+
+// main loop of a worker thread
+void JobSystem::WorkerLoop(int queueIndex)
+	{ // WorkerLoop()
+	unsigned long seenGeneration = 0;
+	Job job;
+	while (true)
+		{ // forever
+		// drain everything we can reach
+		while (TakeJob(queueIndex, job))
+			RunJob(job);
+
+		// then sleep until something new is posted
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wakeCondition.wait(lock, [&]() { return shuttingDown || jobGeneration != seenGeneration; });
+		if (shuttingDown)
+			return;
+		seenGeneration = jobGeneration;
+		} // forever
+	} // WorkerLoop()
+
+// pop from our own queue, or steal from another; false if all are empty
+bool JobSystem::TakeJob(int queueIndex, Job &job)
+	{ // TakeJob()
+	int nQueues = (int) queues.size();
+
+	// own queue: take from the back, where the most recent (warmest) work is
+		{ // lock
+		WorkQueue *own = queues[queueIndex];
+		std::lock_guard<std::mutex> lock(own->mutex);
+		if (!own->jobs.empty())
+			{ // found one
+			job = own->jobs.back();
+			own->jobs.pop_back();
+			return true;
+			} // found one
+		} // lock
+
+	// otherwise steal from the front of the others, starting with our neighbour
+	for (int offset = 1; offset < nQueues; offset++)
+		{ // per victim
+		WorkQueue *victim = queues[(queueIndex + offset) % nQueues];
+		std::lock_guard<std::mutex> lock(victim->mutex);
+		if (!victim->jobs.empty())
+			{ // stolen
+			job = victim->jobs.front();
+			victim->jobs.pop_front();
+			return true;
+			} // stolen
+		} // per victim
+
+	return false;
+	} // TakeJob()
+
+// run a job and mark it as done
+void JobSystem::RunJob(const Job &job)
+	{ // RunJob()
+	(*job.function)(job.begin, job.end);
+	job.remaining->fetch_sub(1, std::memory_order_release);
+	} // RunJob()
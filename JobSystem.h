@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	JobSystem.h
+//	------------------------
+//
+//	A small work-stealing thread pool for splitting
+//	loops over bodies across cores
+//
+///////////////////////////////////////////////////
+
+#ifndef _JOB_SYSTEM_H
+#define _JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class JobSystem
+	{ // class JobSystem
+	public:
+	// the work done by a job: a half-open range [begin, end)
+	typedef std::function<void(int, int)> RangeFunction;
+
+	// constructor: nThreads of 0 uses one thread per hardware core
+	// the calling thread always takes part, so 1 means no extra threads
+	explicit JobSystem(int nThreads = 0);
+
+	// destructor joins the workers
+	~JobSystem();
+
+	// total number of threads that run jobs, including the caller
+	int ThreadCount() const;
+
+	// split [0, count) into chunks of chunkSize, run them all, and wait
+	// chunk boundaries depend only on chunkSize, never on the thread count
+	void ParallelFor(int count, int chunkSize, const RangeFunction &function);
+
+	private:
+	// one chunk of a ParallelFor
+	struct Job
+		{ // struct Job
+		const RangeFunction *function;
+		int begin, end;
+		std::atomic<int> *remaining;
+		}; // struct Job
+
+	// each thread owns a queue, and steals from the others when it is empty
+	struct WorkQueue
+		{ // struct WorkQueue
+		std::mutex mutex;
+		std::deque<Job> jobs;
+		}; // struct WorkQueue
+
+	// queue 0 belongs to the calling thread, the rest to the workers
+	std::vector<WorkQueue *> queues;
+	std::vector<std::thread> workers;
+
+	// idle workers wait on this until new jobs are posted
+	std::mutex wakeMutex;
+	std::condition_variable wakeCondition;
+	unsigned long jobGeneration;
+	bool shuttingDown;
+
+	// no copying
+	JobSystem(const JobSystem &);
+	JobSystem &operator =(const JobSystem &);
+
+	// main loop of a worker thread
+	void WorkerLoop(int queueIndex);
+
+	// pop from our own queue, or steal from another; false if all are empty
+	bool TakeJob(int queueIndex, Job &job);
+
+	// run a job and mark it as done
+	void RunJob(const Job &job);
+	}; // class JobSystem
+
+#endif
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MappedFile.cpp
+//	------------------------
+//
+//	A read-only memory mapping of a whole file
+//
+///////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// constructor
+MappedFile::MappedFile()
+	:
+	data(NULL),
+	size(0)
+#ifdef _WIN32
+	,
+	fileHandle(INVALID_HANDLE_VALUE),
+	mappingHandle(NULL)
+#endif
+	{ // constructor
+	} // constructor
+
+// destructor unmaps
+MappedFile::~MappedFile()
+	{ // destructor
+	Close();
+	} // destructor
+
+// map a file, replacing any current mapping
+bool MappedFile::Open(const char *fileName)
+	{ // Open()
+	Close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+		{ Close(); return false; }
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+		{ Close(); return false; }
+	data = static_cast<const unsigned char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (data == NULL)
+		{ Close(); return false; }
+	size = (std::size_t) fileSize.QuadPart;
+#else
+	int descriptor = open(fileName, O_RDONLY);
+	if (descriptor < 0)
+		return false;
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+		{ close(descriptor); return false; }
+	void *mapping = mmap(NULL, (std::size_t) status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// the mapping holds its own reference to the file
+	close(descriptor);
+	if (mapping == MAP_FAILED)
+		return false;
+	data = static_cast<const unsigned char *>(mapping);
+	size = (std::size_t) status.st_size;
+#endif
+	return true;
+	} // Open()
+
+// unmap
+void MappedFile::Close()
+	{ // Close()
+#ifdef _WIN32
+	if (data != NULL)
+		UnmapViewOfFile(data);
+	if (mappingHandle != NULL)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (data != NULL)
+		munmap(const_cast<unsigned char *>(data), size);
+#endif
+	data = NULL;
+	size = 0;
+	} // Close()
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MappedFile.h
+//	------------------------
+//
+//	A read-only memory mapping of a whole file
+//
+///////////////////////////////////////////////////
+
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <cstddef>
+
+class MappedFile
+	{ // class MappedFile
+	public:
+	// constructor
+	MappedFile();
+
+	// destructor unmaps
+	~MappedFile();
+
+	// map a file, replacing any current mapping; returns false on failure
+	bool Open(const char *fileName);
+
+	// unmap
+	void Close();
+
+	// the mapped bytes, or NULL if nothing is mapped
+	const unsigned char *Data() const { return data; }
+	std::size_t Size() const { return size; }
+
+	private:
+	const unsigned char *data;
+	std::size_t size;
+
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#endif
+
+	// a mapping can't be shared
+	MappedFile(const MappedFile &);
+	MappedFile &operator =(const MappedFile &);
+	}; // class MappedFile
+
+#endif
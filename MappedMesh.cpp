@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MappedMesh.cpp
+//	------------------------
+//
+//	A binary mesh file (.bface) mapped into memory,
+//	whose vertices, faces and normals are used
+//	where they lie without being copied
+//
+///////////////////////////////////////////////////
+
+#include <cstring>
+
+#include "MappedMesh.h"
+
+// constructor
+MappedMesh::MappedMesh()
+	:
+	vertices(NULL),
+	faceVertices(NULL),
+	normals(NULL),
+	nVertices(0),
+	nFaces(0)
+	{ // constructor
+	} // constructor
+
+// map a .bface file
+bool MappedMesh::Open(const char *fileName)
+	{ // Open()
+	Close();
+	if (!file.Open(fileName))
+		return false;
+
+	// check the header before trusting any of it
+	BinaryMeshHeader header;
+	if (file.Size() < sizeof(header))
+		{ Close(); return false; }
+	memcpy(&header, file.Data(), sizeof(header));
+	if (!CheckBinaryMeshHeader(header, file.Size()))
+		{ Close(); return false; }
+
+	// and the faces, so that nothing drawing them reads past the vertices
+	const int *indices = reinterpret_cast<const int *>(file.Data() + header.indicesOffset);
+	for (uint64_t index = 0; index < 3 * header.faceCount; index++)
+		if (indices[index] < 0 || (uint64_t) indices[index] >= header.vertexCount)
+			{ Close(); return false; }
+
+	vertices = reinterpret_cast<const Cartesian3 *>(file.Data() + header.verticesOffset);
+	faceVertices = indices;
+	normals = reinterpret_cast<const Cartesian3 *>(file.Data() + header.normalsOffset);
+	nVertices = (long) header.vertexCount;
+	nFaces = (long) header.faceCount;
+	return true;
+	} // Open()
+
+// unmap
+void MappedMesh::Close()
+	{ // Close()
+	file.Close();
+	vertices = normals = NULL;
+	faceVertices = NULL;
+	nVertices = nFaces = 0;
+	} // Close()
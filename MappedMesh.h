@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MappedMesh.h
+//	------------------------
+//
+//	A binary mesh file (.bface) mapped into memory,
+//	whose vertices, faces and normals are used
+//	where they lie without being copied
+//
+///////////////////////////////////////////////////
+
+#ifndef _MAPPED_MESH_H
+#define _MAPPED_MESH_H
+
+#include "IndexedFaceSurface.h"
+#include "MappedFile.h"
+
+class MappedMesh
+	{ // class MappedMesh
+	public:
+	// constructor
+	MappedMesh();
+
+	// map a .bface file, replacing any current one; returns false if it can't
+	// be read, or if its header or any face's vertex indices are out of range
+	bool Open(const char *fileName);
+
+	// unmap, after which the arrays are no longer valid
+	void Close();
+
+	// the arrays in the file, valid until it is closed: faceVertices holds three
+	// indices per face, in CCW order, and normals one per face
+	const Cartesian3 *Vertices() const { return vertices; }
+	const int *FaceVertices() const { return faceVertices; }
+	const Cartesian3 *Normals() const { return normals; }
+	long VertexCount() const { return nVertices; }
+	long FaceCount() const { return nFaces; }
+
+	private:
+	MappedFile file;
+	const Cartesian3 *vertices;
+	const int *faceVertices;
+	const Cartesian3 *normals;
+	long nVertices, nFaces;
+	}; // class MappedMesh
+
+#endif
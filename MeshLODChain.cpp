@@ -0,0 +1,435 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MeshLODChain.cpp
+//	------------------------
+//
+//	Levels of detail for a mesh, simplified by
+//	quadric-error edge collapse, and the choice of
+//	level for each copy drawn from its size on screen
+//
+///////////////////////////////////////////////////
+
+#include <algorithm>
+#include <queue>
+#include <math.h>
+
+#include "MeshLODChain.h"
+
+// PHYSICS_HEADLESS builds have no GL, and ViewFromGL() gives a default view
+#ifndef PHYSICS_HEADLESS
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+#endif
+
+// the sum of the squared distances to a set of planes, as a symmetric 4x4
+// matrix: xx xy xz xw yy yz yw zz zw ww
+struct Quadric
+	{ // struct Quadric
+	double q[10];
+
+	Quadric() { std::fill(q, q + 10, 0.0); }
+
+	// add the plane ax + by + cz + d = 0, with a weight
+	void AddPlane(double a, double b, double c, double d, double weight)
+		{ // AddPlane()
+		double plane[4] = { a, b, c, d };
+		int entry = 0;
+		for (int row = 0; row < 4; row++)
+			for (int column = row; column < 4; column++)
+				q[entry++] += weight * plane[row] * plane[column];
+		} // AddPlane()
+
+	void Add(const Quadric &other)
+		{ for (int entry = 0; entry < 10; entry++) q[entry] += other.q[entry]; }
+
+	// the error at a point
+	double Error(const Cartesian3 &p) const
+		{ // Error()
+		double x = p.x, y = p.y, z = p.z;
+		return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+			+ q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+			+ q[7] * z * z + 2 * q[8] * z + q[9];
+		} // Error()
+
+	// the point of least error, if the matrix isn't close to singular
+	bool Minimum(Cartesian3 &p) const
+		{ // Minimum()
+		// solve the 3x3 system by Cramer's rule
+		double a = q[0], b = q[1], c = q[2], d = q[4], e = q[5], f = q[7];
+		double det = a * (d * f - e * e) - b * (b * f - e * c) + c * (b * e - d * c);
+		double scale = fabs(a) + fabs(d) + fabs(f);
+		if (fabs(det) <= 1.0e-9 * scale * scale * scale || scale == 0.0)
+			return false;
+		double rx = -q[3], ry = -q[6], rz = -q[8];
+		p.x = (float) ((rx * (d * f - e * e) - b * (ry * f - e * rz) + c * (ry * e - d * rz)) / det);
+		p.y = (float) ((a * (ry * f - e * rz) - rx * (b * f - e * c) + c * (b * rz - ry * c)) / det);
+		p.z = (float) ((a * (d * rz - ry * e) - b * (b * rz - ry * c) + rx * (b * e - d * c)) / det);
+		return true;
+		} // Minimum()
+	}; // struct Quadric
+
+// an edge waiting to be collapsed, stale once either end has changed since
+struct EdgeCollapse
+	{ // struct EdgeCollapse
+	double cost;
+	int keep, remove;
+	unsigned int keepVersion, removeVersion;
+	Cartesian3 position;
+
+	bool operator >(const EdgeCollapse &other) const { return cost > other.cost; }
+	}; // struct EdgeCollapse
+
+// the working state of a simplification
+class EdgeCollapser
+	{ // class EdgeCollapser
+	public:
+	std::vector<Cartesian3> positions;
+	std::vector<Quadric> quadrics;
+	std::vector<unsigned int> versions;
+	std::vector<bool> removedVertices;
+	std::vector<int> faces;
+	std::vector<bool> removedFaces;
+	std::vector<std::vector<int> > facesOfVertex;
+	std::priority_queue<EdgeCollapse, std::vector<EdgeCollapse>, std::greater<EdgeCollapse> > queue;
+	long faceCount;
+	double largestError;
+
+	// set up from a mesh, with the quadrics of its faces and open edges
+	explicit EdgeCollapser(const IndexedFaceSurface &mesh);
+
+	// collapse edges until there are targetFaces faces, or none can go
+	void CollapseTo(long targetFaces);
+
+	// the faces left, with the vertices they use renumbered
+	void Extract(IndexedFaceSurface &result) const;
+
+	private:
+	// queue the collapse of the edge from keep to remove
+	void QueueEdge(int keep, int remove);
+
+	// the normal of a face with one vertex moved, and whether it is degenerate
+	Cartesian3 FaceNormal(int face, int moved, const Cartesian3 &position) const;
+
+	// true if moving two vertices to position flips or squashes a face around them
+	bool Folds(int keep, int remove, const Cartesian3 &position) const;
+
+	// merge remove into keep at position
+	void Collapse(int keep, int remove, const Cartesian3 &position);
+	}; // class EdgeCollapser
+
+// set up from a mesh
+EdgeCollapser::EdgeCollapser(const IndexedFaceSurface &mesh)
+	:
+	positions(mesh.vertices),
+	quadrics(mesh.vertices.size()),
+	versions(mesh.vertices.size(), 0),
+	removedVertices(mesh.vertices.size(), false),
+	faces(mesh.faceVertices),
+	removedFaces(mesh.faceVertices.size() / 3, false),
+	facesOfVertex(mesh.vertices.size()),
+	faceCount((long) mesh.faceVertices.size() / 3),
+	largestError(0.0)
+	{ // EdgeCollapser()
+	// each vertex starts with the planes of the faces around it
+	for (long face = 0; face < faceCount; face++)
+		{ // per face
+		const Cartesian3 &p = positions[faces[3 * face]];
+		Cartesian3 normal = (positions[faces[3 * face + 1]] - p).cross(positions[faces[3 * face + 2]] - p);
+		if (normal.length() > 0.0)
+			normal = normal.unit();
+		for (int corner = 0; corner < 3; corner++)
+			{ // per corner
+			quadrics[faces[3 * face + corner]].AddPlane(normal.x, normal.y, normal.z, -normal.dot(p), 1.0);
+			facesOfVertex[faces[3 * face + corner]].push_back((int) face);
+			} // per corner
+		} // per face
+
+	// an open edge (used by one face) also holds its ends to a plane through it
+	// at right angles to the face, heavily weighted, so that holes keep their shape
+	for (long face = 0; face < faceCount; face++)
+		for (int corner = 0; corner < 3; corner++)
+			{ // per edge
+			int from = faces[3 * face + corner], to = faces[3 * face + (corner + 1) % 3];
+			int users = 0;
+			for (int other : facesOfVertex[from])
+				for (int otherCorner = 0; otherCorner < 3; otherCorner++)
+					if (faces[3 * other + otherCorner] == to)
+						users++;
+			if (users != 1)
+				continue;
+			const Cartesian3 &p = positions[faces[3 * face]];
+			Cartesian3 faceNormal = (positions[faces[3 * face + 1]] - p).cross(positions[faces[3 * face + 2]] - p);
+			Cartesian3 side = (positions[to] - positions[from]).cross(faceNormal);
+			if (side.length() == 0.0)
+				continue;
+			side = side.unit();
+			double d = -side.dot(positions[from]);
+			quadrics[from].AddPlane(side.x, side.y, side.z, d, 1000.0);
+			quadrics[to].AddPlane(side.x, side.y, side.z, d, 1000.0);
+			} // per edge
+
+	// and every edge is a candidate, queued once from its lower vertex
+	for (long face = 0; face < faceCount; face++)
+		for (int corner = 0; corner < 3; corner++)
+			{ // per edge
+			int from = faces[3 * face + corner], to = faces[3 * face + (corner + 1) % 3];
+			if (from < to)
+				QueueEdge(from, to);
+			} // per edge
+	} // EdgeCollapser()
+
+// queue the collapse of an edge at its best position
+void EdgeCollapser::QueueEdge(int keep, int remove)
+	{ // QueueEdge()
+	Quadric sum = quadrics[keep];
+	sum.Add(quadrics[remove]);
+
+	// the minimum of the quadric if there is one, else the best of the ends and middle
+	EdgeCollapse collapse;
+	if (sum.Minimum(collapse.position))
+		collapse.cost = sum.Error(collapse.position);
+	else
+		{ // no minimum
+		Cartesian3 candidates[3] = { positions[keep], positions[remove], (positions[keep] + positions[remove]) * 0.5 };
+		collapse.cost = -1.0;
+		for (const Cartesian3 &candidate : candidates)
+			{ // per candidate
+			double cost = sum.Error(candidate);
+			if (collapse.cost < 0.0 || cost < collapse.cost)
+				{ collapse.cost = cost; collapse.position = candidate; }
+			} // per candidate
+		} // no minimum
+	collapse.cost = std::max(collapse.cost, 0.0);
+	collapse.keep = keep;
+	collapse.remove = remove;
+	collapse.keepVersion = versions[keep];
+	collapse.removeVersion = versions[remove];
+	queue.push(collapse);
+	} // QueueEdge()
+
+// the normal of a face with one vertex moved
+Cartesian3 EdgeCollapser::FaceNormal(int face, int moved, const Cartesian3 &position) const
+	{ // FaceNormal()
+	Cartesian3 corners[3];
+	for (int corner = 0; corner < 3; corner++)
+		corners[corner] = faces[3 * face + corner] == moved ? position : positions[faces[3 * face + corner]];
+	return (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+	} // FaceNormal()
+
+// true if a collapse would turn a face over
+bool EdgeCollapser::Folds(int keep, int remove, const Cartesian3 &position) const
+	{ // Folds()
+	int ends[2] = { keep, remove };
+	for (int end : ends)
+		for (int face : facesOfVertex[end])
+			{ // per face around
+			// the faces on the edge itself go
+			bool onEdge = false;
+			for (int corner = 0; corner < 3; corner++)
+				onEdge = onEdge || faces[3 * face + corner] == (end == keep ? remove : keep);
+			if (onEdge)
+				continue;
+			Cartesian3 before = FaceNormal(face, -1, position);
+			Cartesian3 after = FaceNormal(face, end, position);
+			if (after.length() == 0.0 || before.dot(after) < 0.2 * before.length() * after.length())
+				return true;
+			} // per face around
+	return false;
+	} // Folds()
+
+// merge one vertex into another
+void EdgeCollapser::Collapse(int keep, int remove, const Cartesian3 &position)
+	{ // Collapse()
+	positions[keep] = position;
+	quadrics[keep].Add(quadrics[remove]);
+	removedVertices[remove] = true;
+	versions[keep]++;
+	versions[remove]++;
+
+	// faces on the edge go, the others around remove move to keep
+	for (int face : facesOfVertex[remove])
+		{ // per face of remove
+		bool onEdge = faces[3 * face] == keep || faces[3 * face + 1] == keep || faces[3 * face + 2] == keep;
+		if (onEdge)
+			{ // degenerate
+			removedFaces[face] = true;
+			faceCount--;
+			for (int corner = 0; corner < 3; corner++)
+				{ // drop it from its other vertices
+				std::vector<int> &around = facesOfVertex[faces[3 * face + corner]];
+				if (faces[3 * face + corner] != remove)
+					around.erase(std::remove(around.begin(), around.end(), face), around.end());
+				} // drop it
+			} // degenerate
+		else
+			{ // moved
+			for (int corner = 0; corner < 3; corner++)
+				if (faces[3 * face + corner] == remove)
+					faces[3 * face + corner] = keep;
+			facesOfVertex[keep].push_back(face);
+			} // moved
+		} // per face of remove
+	facesOfVertex[remove].clear();
+
+	// the edges around keep now cost something else
+	std::vector<int> neighbours;
+	for (int face : facesOfVertex[keep])
+		for (int corner = 0; corner < 3; corner++)
+			if (faces[3 * face + corner] != keep)
+				neighbours.push_back(faces[3 * face + corner]);
+	std::sort(neighbours.begin(), neighbours.end());
+	neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+	for (int neighbour : neighbours)
+		QueueEdge(keep, neighbour);
+	} // Collapse()
+
+// collapse the cheapest edges until few enough faces are left
+void EdgeCollapser::CollapseTo(long targetFaces)
+	{ // CollapseTo()
+	while (faceCount > targetFaces && !queue.empty())
+		{ // per collapse
+		EdgeCollapse collapse = queue.top();
+		queue.pop();
+		if (removedVertices[collapse.keep] || removedVertices[collapse.remove]
+				|| collapse.keepVersion != versions[collapse.keep] || collapse.removeVersion != versions[collapse.remove])
+			continue;
+		if (Folds(collapse.keep, collapse.remove, collapse.position))
+			continue;
+		largestError = std::max(largestError, collapse.cost);
+		Collapse(collapse.keep, collapse.remove, collapse.position);
+		} // per collapse
+	} // CollapseTo()
+
+// the faces left, with their vertices renumbered
+void EdgeCollapser::Extract(IndexedFaceSurface &result) const
+	{ // Extract()
+	std::vector<int> newIndex(positions.size(), -1);
+	result.vertices.clear();
+	result.faceVertices.clear();
+	for (long face = 0; face < (long) removedFaces.size(); face++)
+		{ // per face
+		if (removedFaces[face])
+			continue;
+		for (int corner = 0; corner < 3; corner++)
+			{ // per corner
+			int vertex = faces[3 * face + corner];
+			if (newIndex[vertex] < 0)
+				{ // first use
+				newIndex[vertex] = (int) result.vertices.size();
+				result.vertices.push_back(positions[vertex]);
+				} // first use
+			result.faceVertices.push_back(newIndex[vertex]);
+			} // per corner
+		} // per face
+	result.ComputeUnitNormalVectors();
+	} // Extract()
+
+// constructor
+MeshLODChain::MeshLODChain()
+	:
+	radius(0.0),
+	maxScreenError(1.0),
+	triangleBudget(0)
+	{ // constructor
+	} // constructor
+
+// simplify a mesh to at most targetFaces faces
+float MeshLODChain::Simplify(const IndexedFaceSurface &mesh, long targetFaces, IndexedFaceSurface &result)
+	{ // Simplify()
+	EdgeCollapser collapser(mesh);
+	collapser.CollapseTo(targetFaces);
+	collapser.Extract(result);
+
+	// the planes are unit, so the cost is a sum of squared distances
+	return (float) sqrt(collapser.largestError);
+	} // Simplify()
+
+// build the chain from a mesh
+void MeshLODChain::Build(const IndexedFaceSurface &mesh, int maxLevels, long minFaces)
+	{ // Build()
+	levels.assign(1, mesh);
+	errors.assign(1, 0.0);
+	radius = 0.0;
+	for (const Cartesian3 &vertex : mesh.vertices)
+		radius = std::max(radius, vertex.length());
+
+	// each level from the one before, so its error adds to that one's
+	while ((int) levels.size() < maxLevels && FaceCount((int) levels.size() - 1) / 2 >= minFaces)
+		{ // per level
+		IndexedFaceSurface coarser;
+		long previousFaces = FaceCount((int) levels.size() - 1);
+		float error = Simplify(levels.back(), previousFaces / 2, coarser);
+
+		// stop if the collapses couldn't get much further
+		if ((long) coarser.normals.size() > previousFaces * 3 / 4)
+			break;
+		levels.push_back(coarser);
+		errors.push_back(errors.back() + error);
+		} // per level
+	} // Build()
+
+// the coarsest level good enough at a distance
+int MeshLODChain::Level(float distance, float pixelScale, float errorScale) const
+	{ // Level()
+	int level = (int) levels.size() - 1;
+	while (level > 0 && errors[level] * pixelScale > maxScreenError * errorScale * distance)
+		level--;
+	return level;
+	} // Level()
+
+// choose the levels for many copies
+void MeshLODChain::SelectLevels(const Cartesian3 &eye, float pixelScale, const Cartesian3 *centres, int count, std::vector<int> &chosen) const
+	{ // SelectLevels()
+	chosen.assign(count, 0);
+	if (levels.empty())
+		return;
+
+	// the distance to the nearest point of each copy's bounding sphere
+	std::vector<float> distances(count);
+	for (int copy = 0; copy < count; copy++)
+		distances[copy] = std::max((centres[copy] - eye).length() - radius, 1.0e-3f);
+
+	// loosen the error until the triangles fit, or every copy is at the coarsest level
+	for (float errorScale = 1.0; ; errorScale *= 2.0)
+		{ // per error scale
+		long triangles = 0;
+		bool allCoarsest = true;
+		for (int copy = 0; copy < count; copy++)
+			{ // per copy
+			chosen[copy] = Level(distances[copy], pixelScale, errorScale);
+			triangles += FaceCount(chosen[copy]);
+			allCoarsest = allCoarsest && chosen[copy] == (int) levels.size() - 1;
+			} // per copy
+		if (triangleBudget <= 0 || triangles <= triangleBudget || allCoarsest)
+			break;
+		} // per error scale
+	} // SelectLevels()
+
+// read the eye and the pixel scale from the current GL matrices
+void MeshLODChain::ViewFromGL(Cartesian3 &eye, float &pixelScale)
+	{ // ViewFromGL()
+#ifndef PHYSICS_HEADLESS
+	GLfloat modelView[16], projection[16];
+	GLint viewport[4];
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// the eye is minus the translation, rotated back (the matrices are column-major)
+	for (int axis = 0; axis < 3; axis++)
+		eye[axis] = -(modelView[4 * axis] * modelView[12] + modelView[4 * axis + 1] * modelView[13] + modelView[4 * axis + 2] * modelView[14]);
+
+	// a unit at unit distance covers half the viewport height times the focal scale
+	pixelScale = 0.5 * viewport[3] * projection[5];
+#else
+	eye = Cartesian3(0.0, 0.0, 0.0);
+	pixelScale = 1.0;
+#endif
+	} // ViewFromGL()
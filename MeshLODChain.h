@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MeshLODChain.h
+//	------------------------
+//
+//	Levels of detail for a mesh, simplified by
+//	quadric-error edge collapse, and the choice of
+//	level for each copy drawn from its size on screen
+//
+///////////////////////////////////////////////////
+
+#ifndef _MESH_LOD_CHAIN_H
+#define _MESH_LOD_CHAIN_H
+
+#include <vector>
+
+#include "IndexedFaceSurface.h"
+
+class MeshLODChain
+	{ // class MeshLODChain
+	public:
+	// the levels, from the mesh itself at 0 to the coarsest
+	std::vector<IndexedFaceSurface> levels;
+
+	// how far each level may lie from the original surface, in mesh units
+	std::vector<float> errors;
+
+	// the distance from the mesh's origin to its furthest vertex
+	float radius;
+
+	// the largest error allowed on screen, in pixels
+	float maxScreenError;
+
+	// the most triangles to draw for all the copies together (0 for no limit):
+	// past it, every copy's allowed error is doubled until they fit
+	long triangleBudget;
+
+	// constructor
+	MeshLODChain();
+
+	// build the chain from a mesh, halving the faces at each level until there
+	// are maxLevels levels, or a level would have fewer than minFaces faces
+	void Build(const IndexedFaceSurface &mesh, int maxLevels = 6, long minFaces = 32);
+
+	// simplify a mesh by collapsing its cheapest edges until it has at most
+	// targetFaces faces, returning the largest distance any collapse moved the
+	// surface from the planes of the original faces around it
+	static float Simplify(const IndexedFaceSurface &mesh, long targetFaces, IndexedFaceSurface &result);
+
+	// the coarsest level good enough for a copy at distance, where pixelScale
+	// is the size in pixels of a unit at unit distance, with its allowed error
+	// multiplied by errorScale
+	int Level(float distance, float pixelScale, float errorScale = 1.0) const;
+
+	// choose the levels for count copies centred at centres, seen from eye,
+	// keeping within the triangle budget
+	void SelectLevels(const Cartesian3 &eye, float pixelScale, const Cartesian3 *centres, int count, std::vector<int> &chosen) const;
+
+	// the faces in a level
+	long FaceCount(int level) const { return (long) levels[level].normals.size(); }
+
+	// draw a level
+	void Render(int level) { levels[level].Render(); }
+
+	// read the eye and the pixel scale from the current GL matrices
+	static void ViewFromGL(Cartesian3 &eye, float &pixelScale);
+	}; // class MeshLODChain
+
+#endif
@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MeshOptimizer.cpp
+//	------------------------
+//
+//	Reordering of the triangles and vertices of an
+//	indexed mesh for the GPU's post-transform vertex
+//	cache and its vertex fetches
+//
+///////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+// reorder the triangles for the vertex cache
+void MeshOptimizer::ReorderTriangles(std::vector<unsigned int> &indices, long vertexCount, int cacheSize)
+	{ // ReorderTriangles()
+	long nTriangles = (long) indices.size() / 3;
+	if (nTriangles == 0)
+		return;
+
+	// the triangles around each vertex, as offsets into one array
+	std::vector<long> firstTriangle(vertexCount + 1, 0);
+	for (unsigned int vertex : indices)
+		firstTriangle[vertex + 1]++;
+	for (long vertex = 0; vertex < vertexCount; vertex++)
+		firstTriangle[vertex + 1] += firstTriangle[vertex];
+	std::vector<long> trianglesAround(indices.size());
+	std::vector<long> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (long triangle = 0; triangle < nTriangles; triangle++)
+		for (int corner = 0; corner < 3; corner++)
+			trianglesAround[filled[indices[3 * triangle + corner]]++] = triangle;
+
+	// the triangles each vertex has yet to be drawn in, and when it last entered the cache
+	std::vector<long> live(vertexCount);
+	for (long vertex = 0; vertex < vertexCount; vertex++)
+		live[vertex] = firstTriangle[vertex + 1] - firstTriangle[vertex];
+	std::vector<long> cacheTime(vertexCount, 0);
+	long time = cacheSize + 1;
+
+	std::vector<bool> emitted(nTriangles, false);
+	std::vector<unsigned int> reordered;
+	reordered.reserve(indices.size());
+
+	// vertices of recent triangles, to go back to when a fan leads nowhere, and
+	// the next vertex to try in order once those are used up
+	std::vector<long> deadEnds;
+	long cursor = 1;
+
+	std::vector<long> candidates;
+	long fan = 0;
+	while (fan >= 0)
+		{ // per fan
+		// draw every triangle left around the fanning vertex
+		candidates.clear();
+		for (long entry = firstTriangle[fan]; entry < firstTriangle[fan + 1]; entry++)
+			{ // per triangle around
+			long triangle = trianglesAround[entry];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = true;
+			for (int corner = 0; corner < 3; corner++)
+				{ // per corner
+				unsigned int vertex = indices[3 * triangle + corner];
+				reordered.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+				// a FIFO cache only takes in a vertex on a miss
+				if (time - cacheTime[vertex] > cacheSize)
+					cacheTime[vertex] = time++;
+				} // per corner
+			} // per triangle around
+
+		// fan next around the candidate furthest into the cache that will still be
+		// in it after its remaining triangles are drawn; one that won't be is left
+		// for the dead ends below
+		fan = -1;
+		long bestPriority = 0;
+		for (long vertex : candidates)
+			{ // per candidate
+			if (live[vertex] <= 0)
+				continue;
+			long priority = 0;
+			if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize)
+				priority = time - cacheTime[vertex];
+			if (priority > bestPriority)
+				{ bestPriority = priority; fan = vertex; }
+			} // per candidate
+
+		// otherwise go back to a recent vertex with triangles left, or the next in order
+		while (fan < 0 && !deadEnds.empty())
+			{ // per dead end
+			long vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[vertex] > 0)
+				fan = vertex;
+			} // per dead end
+		for (; fan < 0 && cursor < vertexCount; cursor++)
+			if (live[cursor] > 0)
+				fan = cursor;
+		} // per fan
+
+	indices.swap(reordered);
+	} // ReorderTriangles()
+
+// renumber the vertices in order of first use
+void MeshOptimizer::ReorderVertices(std::vector<unsigned int> &indices, long vertexCount, std::vector<unsigned int> &oldIndices)
+	{ // ReorderVertices()
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> newIndices(vertexCount, unused);
+	oldIndices.clear();
+	for (unsigned int &index : indices)
+		{ // per index
+		if (newIndices[index] == unused)
+			{ // first use
+			newIndices[index] = (unsigned int) oldIndices.size();
+			oldIndices.push_back(index);
+			} // first use
+		index = newIndices[index];
+		} // per index
+	for (long vertex = 0; vertex < vertexCount; vertex++)
+		if (newIndices[vertex] == unused)
+			oldIndices.push_back((unsigned int) vertex);
+	} // ReorderVertices()
+
+// the average cache miss ratio
+float MeshOptimizer::ACMR(const std::vector<unsigned int> &indices, long vertexCount, int cacheSize)
+	{ // ACMR()
+	if (indices.empty())
+		return 0.0;
+	std::vector<long> cacheTime(vertexCount, 0);
+	long time = cacheSize + 1;
+	long misses = 0;
+	for (unsigned int vertex : indices)
+		if (time - cacheTime[vertex] > cacheSize)
+			{ // miss
+			cacheTime[vertex] = time++;
+			misses++;
+			} // miss
+	return (float) misses / (float) (indices.size() / 3);
+	} // ACMR()
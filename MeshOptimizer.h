@@ -0,0 +1,39 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MeshOptimizer.h
+//	------------------------
+//
+//	Reordering of the triangles and vertices of an
+//	indexed mesh for the GPU's post-transform vertex
+//	cache and its vertex fetches
+//
+///////////////////////////////////////////////////
+
+#ifndef _MESH_OPTIMIZER_H
+#define _MESH_OPTIMIZER_H
+
+#include <vector>
+
+class MeshOptimizer
+	{ // class MeshOptimizer
+	public:
+	// the cache size assumed: small enough for any GPU's post-transform cache
+	static const int cacheSize = 16;
+
+	// reorder the triangles (three indices each, winding kept) so that those
+	// sharing vertices are drawn close together, by Tipsify: fan around the
+	// vertex most likely still in a FIFO cache of cacheSize, in linear time
+	static void ReorderTriangles(std::vector<unsigned int> &indices, long vertexCount, int cacheSize = MeshOptimizer::cacheSize);
+
+	// renumber the vertices in the order the triangles first use them, so that
+	// they are fetched from memory in sequence; oldIndices[new] is the old
+	// number of each, and vertices no triangle uses come last
+	static void ReorderVertices(std::vector<unsigned int> &indices, long vertexCount, std::vector<unsigned int> &oldIndices);
+
+	// the average cache miss ratio: vertices transformed per triangle with a
+	// FIFO cache of cacheSize, from 3 (no reuse) down towards 0.5
+	static float ACMR(const std::vector<unsigned int> &indices, long vertexCount, int cacheSize = MeshOptimizer::cacheSize);
+	}; // class MeshOptimizer
+
+#endif
@@ -0,0 +1,561 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PagedTerrain.cpp
+//	------------------------
+//
+//	A terrain too big to hold in memory: the heights
+//	stay in a .bdem file and are read in square pages
+//	as they are needed, keeping a bounded number in
+//	a least-recently-used cache, with threads that
+//	fetch ahead of the bodies and the viewer
+//
+///////////////////////////////////////////////////
+
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+
+#include "PagedTerrain.h"
+
+// PHYSICS_HEADLESS builds have no GL, and Render() does nothing
+#ifndef PHYSICS_HEADLESS
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+#endif
+
+// constructor
+PagedTerrain::PagedTerrain()
+	:
+	Terrain(),
+	nRows(0),
+	nColumns(0),
+	pageSize(64),
+	pageRows(0),
+	pageColumns(0),
+	maxResidentPages(0),
+	streamEpoch(0),
+	stopping(false),
+	useClock(0)
+	{ // constructor
+	stats.residentPages = 0;
+	stats.demandLoads = stats.prefetchLoads = stats.evictions = 0;
+	} // constructor
+
+// destructor stops the prefetch threads
+PagedTerrain::~PagedTerrain()
+	{ // destructor
+	Close();
+	} // destructor
+
+// open a .bdem file for paging
+bool PagedTerrain::Open(const char *FileName, long PageSize, long MaxResidentPages, int nPrefetchThreads)
+	{ // Open()
+	Close();
+	if (PageSize < 1 || MaxResidentPages < 1)
+		return false;
+
+	demandFile.open(FileName, std::ios::binary);
+	if (!demandFile.good())
+		return false;
+
+	// check the header before trusting any of it
+	demandFile.seekg(0, std::ios::end);
+	uint64_t fileSize = (uint64_t) demandFile.tellg();
+	demandFile.seekg(0, std::ios::beg);
+	if (!demandFile.read(reinterpret_cast<char *>(&header), sizeof(header))
+		|| !CheckBinaryTerrainHeader(header, fileSize)
+		|| (header.layout != HeightGrid::RowMajor && header.layout != HeightGrid::Tiled))
+		{ // bad file
+		// a Morton file scatters each page over the whole file, so it has to be converted
+		demandFile.close();
+		return false;
+		} // bad file
+
+	fileName = FileName;
+	nRows = header.nRows;
+	nColumns = header.nColumns;
+	xyScale = header.xyScale;
+	minHeight = header.minHeight;
+	maxHeight = header.maxHeight;
+	pageSize = PageSize;
+	maxResidentPages = MaxResidentPages;
+
+	// the pages tile the squares, of which there is one less row and column than samples
+	pageRows = (nRows - 2) / pageSize + 1;
+	pageColumns = (nColumns - 2) / pageSize + 1;
+	long nPages = pageRows * pageColumns;
+	directory.reset(new std::atomic<Page *>[nPages]);
+	for (long page = 0; page < nPages; page++)
+		directory[page].store(NULL);
+	pageStates.assign(nPages, Absent);
+	pageEpochs.assign(nPages, 0);
+
+	// none of the heights are held by the base class
+	heights = HeightGrid();
+	faceNormals = NULL;
+	vertices.clear();
+	faceVertices.clear();
+	normals.clear();
+	if (!ReadBounds())
+		{ // no bounds
+		Close();
+		return false;
+		} // no bounds
+
+	for (int thread = 0; thread < nPrefetchThreads; thread++)
+		prefetchThreads.push_back(std::thread(&PagedTerrain::PrefetchLoop, this));
+	return true;
+	} // Open()
+
+// stop the threads and drop every page
+void PagedTerrain::Close()
+	{ // Close()
+		{ // stop the threads
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		stopping = true;
+		} // stop the threads
+	prefetchWanted.notify_all();
+	for (std::thread &thread : prefetchThreads)
+		thread.join();
+	prefetchThreads.clear();
+	stopping = false;
+
+	residentPages.clear();
+	evictedPages.clear();
+	prefetchQueue.clear();
+	pageStates.clear();
+	pageEpochs.clear();
+	directory.reset();
+	demandFile.close();
+	nRows = nColumns = pageRows = pageColumns = 0;
+	pyramid = HeightPyramid();
+	stats.residentPages = 0;
+	stats.demandLoads = stats.prefetchLoads = stats.evictions = 0;
+	} // Close()
+
+// the page holding a square, loading it if need be
+const PagedTerrain::Page *PagedTerrain::FindPage(long row, long column)
+	{ // FindPage()
+	long id = (row / pageSize) * pageColumns + column / pageSize;
+	Page *page = directory[id].load(std::memory_order_acquire);
+	if (page == NULL)
+		page = DemandPage(id);
+
+	// only write the stamp when it changes, so that threads reading the same
+	// page don't keep stealing its cache line from each other
+	unsigned long now = useClock.load(std::memory_order_relaxed);
+	if (page->lastUse.load(std::memory_order_relaxed) != now)
+		page->lastUse.store(now, std::memory_order_relaxed);
+	return page;
+	} // FindPage()
+
+// load a missing page, or wait for a thread that is already loading it
+PagedTerrain::Page *PagedTerrain::DemandPage(long id)
+	{ // DemandPage()
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	while (pageStates[id] == Loading)
+		pageLoaded.wait(lock);
+	if (pageStates[id] == Resident)
+		return directory[id].load(std::memory_order_acquire);
+
+	// absent, or queued but not started: read it here, and the prefetch
+	// threads will skip it when they reach it
+	pageStates[id] = Loading;
+	lock.unlock();
+
+	std::unique_ptr<Page> page(new Page);
+		{ // read
+		std::lock_guard<std::mutex> fileLock(demandFileMutex);
+		ReadPage(demandFile, id, *page);
+		} // read
+	page->lastUse.store(++useClock);
+
+	lock.lock();
+	stats.demandLoads++;
+	return InsertPage(std::move(page));
+	} // DemandPage()
+
+// read a page from a stream
+void PagedTerrain::ReadPage(std::ifstream &stream, long id, Page &page)
+	{ // ReadPage()
+	page.id = id;
+	page.firstRow = (id / pageColumns) * pageSize;
+	page.firstColumn = (id % pageColumns) * pageSize;
+	page.nRows = std::min(pageSize, nRows - 1 - page.firstRow);
+	page.nColumns = std::min(pageSize, nColumns - 1 - page.firstColumn);
+	page.lastUse.store(useClock.load());
+
+	long stride = page.nColumns + 1;
+	page.samples.resize((page.nRows + 1) * stride);
+	page.normals.resize(2 * page.nRows * page.nColumns);
+
+	bool good = true;
+	if (header.layout == HeightGrid::RowMajor)
+		{ // row-major
+		// one read per row
+		for (long row = 0; row <= page.nRows; row++)
+			{ // per row
+			uint64_t sample = (uint64_t) (page.firstRow + row) * nColumns + page.firstColumn;
+			stream.seekg(header.samplesOffset + sample * sizeof(float));
+			good = good && stream.read(reinterpret_cast<char *>(&page.samples[row * stride]), stride * sizeof(float));
+			} // per row
+		} // row-major
+	else
+		{ // tiled
+		// each band of tile rows is contiguous across the columns, so one read per band
+		const long tileSize = HeightGrid::tileSize, tileArea = tileSize * tileSize;
+		uint64_t tilesPerRow = (nColumns + tileSize) / tileSize;
+		long firstTile = page.firstColumn / tileSize, lastTile = (page.firstColumn + page.nColumns) / tileSize;
+		std::vector<float> band((lastTile - firstTile + 1) * tileArea);
+		for (long tileRow = page.firstRow / tileSize; tileRow <= (page.firstRow + page.nRows) / tileSize; tileRow++)
+			{ // per band
+			uint64_t sample = (tileRow * tilesPerRow + firstTile) * tileArea;
+			stream.seekg(header.samplesOffset + sample * sizeof(float));
+			good = good && stream.read(reinterpret_cast<char *>(band.data()), band.size() * sizeof(float));
+
+			long bandFirst = std::max(page.firstRow, tileRow * tileSize);
+			long bandLast = std::min(page.firstRow + page.nRows, tileRow * tileSize + tileSize - 1);
+			for (long row = bandFirst; row <= bandLast; row++)
+				for (long column = page.firstColumn; column <= page.firstColumn + page.nColumns; column++)
+					page.samples[(row - page.firstRow) * stride + column - page.firstColumn] =
+						band[(column / tileSize - firstTile) * tileArea + (row % tileSize) * tileSize + column % tileSize];
+			} // per band
+		} // tiled
+
+	if (header.hasNormals)
+		{ // stored normals
+		// one read per row of squares
+		for (long row = 0; row < page.nRows; row++)
+			{ // per row
+			uint64_t face = 2 * ((uint64_t) (page.firstRow + row) * (nColumns - 1) + page.firstColumn);
+			stream.seekg(header.normalsOffset + face * sizeof(Cartesian3));
+			good = good && stream.read(reinterpret_cast<char *>(&page.normals[2 * row * page.nColumns]), 2 * page.nColumns * sizeof(Cartesian3));
+			} // per row
+		} // stored normals
+	else
+		{ // computed normals
+		// the same vertices and triangles as Terrain::BuildMesh(), so the same normals
+		Cartesian3 midPoint(xyScale * (nColumns / 2), xyScale * (nRows / 2), 0.0);
+		long face = 0;
+		for (long row = page.firstRow; row < page.firstRow + page.nRows; row++)
+			for (long column = page.firstColumn; column < page.firstColumn + page.nColumns; column++)
+				{ // per square
+				const float *corner = &page.samples[(row - page.firstRow) * stride + column - page.firstColumn];
+				Cartesian3 upperLeft((xyScale * column) - midPoint.x, (midPoint.y - (xyScale * row)), corner[0]);
+				Cartesian3 upperRight((xyScale * (column + 1)) - midPoint.x, (midPoint.y - (xyScale * row)), corner[1]);
+				Cartesian3 lowerLeft((xyScale * column) - midPoint.x, (midPoint.y - (xyScale * (row + 1))), corner[stride]);
+				Cartesian3 lowerRight((xyScale * (column + 1)) - midPoint.x, (midPoint.y - (xyScale * (row + 1))), corner[stride + 1]);
+				// first (UR) triangle, then second (LL)
+				page.normals[face++] = (lowerRight - upperLeft).cross(upperRight - upperLeft).unit();
+				page.normals[face++] = (lowerLeft - upperLeft).cross(lowerRight - upperLeft).unit();
+				} // per square
+		} // computed normals
+
+	if (!good)
+		{ // read failed
+		std::cerr << "Unable to read page " << id << " of " << fileName << std::endl;
+		stream.clear();
+		} // read failed
+	} // ReadPage()
+
+// build the height pyramid from the file's table of block bounds
+bool PagedTerrain::ReadBounds()
+	{ // ReadBounds()
+	// two floats per block, so a small read however large the file
+	std::vector<float> low(header.boundsCount), high(header.boundsCount);
+	demandFile.seekg(header.boundsOffset);
+	if (!demandFile.read(reinterpret_cast<char *>(low.data()), low.size() * sizeof(float))
+		|| !demandFile.read(reinterpret_cast<char *>(high.data()), high.size() * sizeof(float)))
+		return false;
+	pyramid.Build(nRows - 1, nColumns - 1, header.boundsCellSize, low, high);
+	return true;
+	} // ReadBounds()
+
+// evict the least recently used pages until at most limit remain
+void PagedTerrain::EvictDownTo(long limit, unsigned long keepEpoch)
+	{ // EvictDownTo()
+	while ((long) residentPages.size() > limit)
+		{ // evict
+		// the oldest page that wasn't asked for in keepEpoch; if every page is
+		// wanted, the cache runs over its limit rather than thrashing
+		long victim = -1;
+		for (long resident = 0; resident < (long) residentPages.size(); resident++)
+			if (pageEpochs[residentPages[resident]->id] != keepEpoch
+				&& (victim < 0 || residentPages[resident]->lastUse.load(std::memory_order_relaxed)
+					< residentPages[victim]->lastUse.load(std::memory_order_relaxed)))
+				victim = resident;
+		if (victim < 0)
+			break;
+
+		// a query may still be reading it, so it is only freed by BeginStreaming()
+		long victimID = residentPages[victim]->id;
+		directory[victimID].store(NULL, std::memory_order_release);
+		pageStates[victimID] = Absent;
+		evictedPages.push_back(std::move(residentPages[victim]));
+		residentPages[victim] = std::move(residentPages.back());
+		residentPages.pop_back();
+		stats.evictions++;
+		} // evict
+	} // EvictDownTo()
+
+// make a loaded page resident, evicting the least recently used to make room
+PagedTerrain::Page *PagedTerrain::InsertPage(std::unique_ptr<Page> page)
+	{ // InsertPage()
+	EvictDownTo(maxResidentPages - 1, streamEpoch);
+
+	Page *inserted = page.get();
+	directory[inserted->id].store(inserted, std::memory_order_release);
+	pageStates[inserted->id] = Resident;
+	residentPages.push_back(std::move(page));
+	pageLoaded.notify_all();
+	return inserted;
+	} // InsertPage()
+
+// body of each prefetch thread
+void PagedTerrain::PrefetchLoop()
+	{ // PrefetchLoop()
+	// each thread has its own stream, so that reads don't wait on each other
+	std::ifstream stream(fileName.c_str(), std::ios::binary);
+
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	while (true)
+		{ // per request
+		while (!stopping && prefetchQueue.empty())
+			prefetchWanted.wait(lock);
+		if (stopping)
+			return;
+
+		long id = prefetchQueue.front();
+		prefetchQueue.pop_front();
+		if (pageStates[id] != Queued)
+			continue;
+		pageStates[id] = Loading;
+		lock.unlock();
+
+		std::unique_ptr<Page> page(new Page);
+		ReadPage(stream, id, *page);
+
+		lock.lock();
+		stats.prefetchLoads++;
+		InsertPage(std::move(page));
+		} // per request
+	} // PrefetchLoop()
+
+// start a round of requests
+void PagedTerrain::BeginStreaming()
+	{ // BeginStreaming()
+	if (nRows == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	// if the last round wanted more pages than the limit, drop the rest of
+	// them now that they aren't held
+	EvictDownTo(maxResidentPages, streamEpoch);
+
+	// no query is running, so nothing can still be reading an evicted page
+	evictedPages.clear();
+
+	streamEpoch++;
+	useClock++;
+
+	// anything asked for before and not yet started is stale
+	for (long id : prefetchQueue)
+		if (pageStates[id] == Queued)
+			pageStates[id] = Absent;
+	prefetchQueue.clear();
+	} // BeginStreaming()
+
+// keep the pages within radius of each point, and queue the missing ones
+void PagedTerrain::StreamAround(const float *x, const float *y, int count, float radius)
+	{ // StreamAround()
+	if (nRows == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	unsigned long epoch = streamEpoch;
+	unsigned long now = useClock.load();
+	bool queued = false;
+
+	// grid coordinates as in getHeight(), with rows running down the map
+	float originX = (nColumns / 2) * xyScale;
+	float originY = (nRows / 2) * xyScale;
+	float totalHeight = GridFlip(nRows);
+	for (int point = 0; point < count; point++)
+		{ // per point
+		float lowColumn = (x[point] - radius + originX) / xyScale;
+		float highColumn = (x[point] + radius + originX) / xyScale;
+		float lowRow = (totalHeight - (y[point] + radius + originY)) / xyScale;
+		float highRow = (totalHeight - (y[point] - radius + originY)) / xyScale;
+		if (highColumn < 0.0 || highRow < 0.0 || lowColumn >= nColumns - 1 || lowRow >= nRows - 1)
+			continue;
+
+		long firstPageColumn = std::max(0L, (long) lowColumn) / pageSize;
+		long lastPageColumn = std::min(nColumns - 2, (long) highColumn) / pageSize;
+		long firstPageRow = std::max(0L, (long) lowRow) / pageSize;
+		long lastPageRow = std::min(nRows - 2, (long) highRow) / pageSize;
+		for (long pageRow = firstPageRow; pageRow <= lastPageRow; pageRow++)
+			for (long pageColumn = firstPageColumn; pageColumn <= lastPageColumn; pageColumn++)
+				{ // per page
+				long id = pageRow * pageColumns + pageColumn;
+				if (pageEpochs[id] == epoch)
+					continue;
+				pageEpochs[id] = epoch;
+				if (pageStates[id] == Resident)
+					directory[id].load(std::memory_order_relaxed)->lastUse.store(now, std::memory_order_relaxed);
+				else if (pageStates[id] == Absent)
+					{ // queue it
+					pageStates[id] = Queued;
+					prefetchQueue.push_back(id);
+					queued = true;
+					} // queue it
+				} // per page
+		} // per point
+
+	if (queued)
+		prefetchWanted.notify_all();
+	} // StreamAround()
+
+// find the height at (x,y), reading the page it lies in
+float PagedTerrain::getHeight(float x, float y)
+	{ // getHeight()
+	if (nRows == 0)
+		return 0.0;
+
+	long row, column;
+	float xRemainder, yRemainder;
+	ClampedSquare(x, y, row, column, xRemainder, yRemainder);
+
+	// the page holds the far corners of its last squares as well
+	const Page *page = FindPage(row, column);
+	long stride = page->nColumns + 1;
+	const float *corner = &page->samples[(row - page->firstRow) * stride + column - page->firstColumn];
+	return InterpolateSquare(corner[0], corner[1], corner[stride], corner[stride + 1], xRemainder, yRemainder);
+	} // getHeight()
+
+// find the normal at (x,y), reading the page it lies in
+Cartesian3 PagedTerrain::getNormal(float x, float y)
+	{ // getNormal()
+	if (nRows == 0)
+		return Cartesian3(0.0, 0.0, 1.0);
+
+	long row, column;
+	float xRemainder, yRemainder;
+	ClampedSquare(x, y, row, column, xRemainder, yRemainder);
+
+	// the LL triangle is the second in its square
+	const Page *page = FindPage(row, column);
+	long square = (row - page->firstRow) * page->nColumns + column - page->firstColumn;
+	return page->normals[2 * square + (xRemainder < yRemainder ? 1 : 0)];
+	} // getNormal()
+
+// the bilinear height at (x,y), reading the page it lies in
+float PagedTerrain::getHeightBilinear(float x, float y)
+	{ // getHeightBilinear()
+	if (nRows == 0)
+		return 0.0;
+
+	long row, column;
+	float xRemainder, yRemainder, upperLeft, upperRight, lowerLeft, lowerRight;
+	ClampedSquare(x, y, row, column, xRemainder, yRemainder);
+	SquareCorners(row, column, upperLeft, upperRight, lowerLeft, lowerRight);
+	float upper = upperLeft + (upperRight - upperLeft) * xRemainder;
+	float lower = lowerLeft + (lowerRight - lowerLeft) * xRemainder;
+	return upper + (lower - upper) * yRemainder;
+	} // getHeightBilinear()
+
+// the normal of the bilinear patch at (x,y)
+Cartesian3 PagedTerrain::getNormalBilinear(float x, float y)
+	{ // getNormalBilinear()
+	if (nRows == 0)
+		return Cartesian3(0.0, 0.0, 1.0);
+
+	long row, column;
+	float xRemainder, yRemainder, upperLeft, upperRight, lowerLeft, lowerRight;
+	ClampedSquare(x, y, row, column, xRemainder, yRemainder);
+	SquareCorners(row, column, upperLeft, upperRight, lowerLeft, lowerRight);
+
+	// the slopes along the columns and down the rows, and rows run towards -y
+	float acrossSlope = (upperRight - upperLeft) * (1.0 - yRemainder) + (lowerRight - lowerLeft) * yRemainder;
+	float downSlope = (lowerLeft - upperLeft) * (1.0 - xRemainder) + (lowerRight - upperRight) * xRemainder;
+	return Cartesian3(-acrossSlope / xyScale, downSlope / xyScale, 1.0).unit();
+	} // getNormalBilinear()
+
+// the heights at the corners of a square, from its page
+void PagedTerrain::SquareCorners(long row, long column, float &upperLeft, float &upperRight, float &lowerLeft, float &lowerRight)
+	{ // SquareCorners()
+	const Page *page = FindPage(row, column);
+	long stride = page->nColumns + 1;
+	const float *corner = &page->samples[(row - page->firstRow) * stride + column - page->firstColumn];
+	upperLeft = corner[0];
+	upperRight = corner[1];
+	lowerLeft = corner[stride];
+	lowerRight = corner[stride + 1];
+	} // SquareCorners()
+
+// batch version of getHeight()
+void PagedTerrain::getHeights(const float *x, const float *y, float *height, int count)
+	{ // getHeights()
+	for (int point = 0; point < count; point++)
+		height[point] = PagedTerrain::getHeight(x[point], y[point]);
+	} // getHeights()
+
+// batch version of getNormal()
+void PagedTerrain::getNormals(const float *x, const float *y, float *normalX, float *normalY, float *normalZ, int count)
+	{ // getNormals()
+	for (int point = 0; point < count; point++)
+		{ // per point
+		Cartesian3 normal = PagedTerrain::getNormal(x[point], y[point]);
+		normalX[point] = normal.x;
+		normalY[point] = normal.y;
+		normalZ[point] = normal.z;
+		} // per point
+	} // getNormals()
+
+// draw the pages that are in memory
+void PagedTerrain::Render()
+	{ // Render()
+#ifndef PHYSICS_HEADLESS
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	float midX = xyScale * (nColumns / 2), midY = xyScale * (nRows / 2);
+
+	glBegin(GL_TRIANGLES);
+	for (const std::unique_ptr<Page> &page : residentPages)
+		{ // per page
+		long stride = page->nColumns + 1;
+		long face = 0;
+		for (long row = page->firstRow; row < page->firstRow + page->nRows; row++)
+			for (long column = page->firstColumn; column < page->firstColumn + page->nColumns; column++)
+				{ // per square
+				const float *corner = &page->samples[(row - page->firstRow) * stride + column - page->firstColumn];
+				float left = (xyScale * column) - midX, right = (xyScale * (column + 1)) - midX;
+				float top = midY - (xyScale * row), bottom = midY - (xyScale * (row + 1));
+				// first (UR) triangle
+				glNormal3fv(&page->normals[face++].x);
+				glVertex3f(left, top, corner[0]);
+				glVertex3f(right, bottom, corner[stride + 1]);
+				glVertex3f(right, top, corner[1]);
+				// second (LL) triangle
+				glNormal3fv(&page->normals[face++].x);
+				glVertex3f(left, top, corner[0]);
+				glVertex3f(left, bottom, corner[stride]);
+				glVertex3f(right, bottom, corner[stride + 1]);
+				} // per square
+		} // per page
+	glEnd();
+#endif
+	} // Render()
+
+// what the cache has done
+PagedTerrain::PageStats PagedTerrain::Stats()
+	{ // Stats()
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	stats.residentPages = (long) residentPages.size();
+	return stats;
+	} // Stats()
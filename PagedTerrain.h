@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PagedTerrain.h
+//	------------------------
+//
+//	A terrain too big to hold in memory: the heights
+//	stay in a .bdem file and are read in square pages
+//	as they are needed, keeping a bounded number in
+//	a least-recently-used cache, with threads that
+//	fetch ahead of the bodies and the viewer
+//
+///////////////////////////////////////////////////
+
+#ifndef _PAGED_TERRAIN_H
+#define _PAGED_TERRAIN_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "Terrain.h"
+
+class PagedTerrain : public Terrain
+	{ // class PagedTerrain
+	public:
+	// counts of what the cache has done since the file was opened
+	struct PageStats
+		{ // struct PageStats
+		// pages now in memory
+		long residentPages;
+		// pages read by a query that found them missing, and so had to wait
+		unsigned long long demandLoads;
+		// pages read ahead by the prefetch threads
+		unsigned long long prefetchLoads;
+		// pages dropped to make room
+		unsigned long long evictions;
+		}; // struct PageStats
+
+	// constructor
+	PagedTerrain();
+
+	// destructor stops the prefetch threads
+	~PagedTerrain();
+
+	// open a .bdem file (in row-major or tiled layout) for paging; nothing is read
+	// but the header and the table of block bounds, from which the pyramid is
+	// built.  A page covers pageSize x pageSize squares, at most maxResidentPages
+	// are kept, and nPrefetchThreads read ahead (0 for none)
+	bool Open(const char *fileName, long pageSize = 64, long maxResidentPages = 256, int nPrefetchThreads = 2);
+
+	// stop the threads and drop every page
+	void Close();
+
+	// the size of the whole grid, of which only some is in memory
+	virtual long GridRows() const { return nRows; }
+	virtual long GridColumns() const { return nColumns; }
+
+	// the same queries as Terrain, which read the pages they fall in, loading
+	// them on the spot if they are missing.  They may be called from several
+	// threads at once
+	virtual float getHeight(float x, float y);
+	virtual Cartesian3 getNormal(float x, float y);
+	virtual void getHeights(const float *x, const float *y, float *height, int count);
+	virtual void getNormals(const float *x, const float *y, float *normalX, float *normalY, float *normalZ, int count);
+
+	// the pages keep no derivative field, so the smooth normal is that of the
+	// bilinear patch, and bicubic sampling falls back to bilinear
+	virtual float getHeightBilinear(float x, float y);
+	virtual Cartesian3 getNormalBilinear(float x, float y);
+	virtual float getHeightBicubic(float x, float y) { return getHeightBilinear(x, y); }
+	virtual Cartesian3 getNormalBicubic(float x, float y) { return getNormalBilinear(x, y); }
+
+	// start a round of requests: those from the last round that haven't been
+	// started are dropped, and the pages it kept may be evicted again.  Pages
+	// evicted since the last round are only freed here, when no query can still
+	// be using them, so this must be called between rounds of queries
+	virtual void BeginStreaming();
+
+	// keep the pages within radius of each point for this round, and queue the
+	// missing ones for the prefetch threads in the order the points come
+	virtual void StreamAround(const float *x, const float *y, int count, float radius);
+
+	// draw the pages that are in memory
+	virtual void Render();
+
+	// what the cache has done
+	PageStats Stats();
+
+	protected:
+	// the heights at the corners of a square, from its page
+	virtual void SquareCorners(long row, long column, float &upperLeft, float &upperRight, float &lowerLeft, float &lowerRight);
+
+	private:
+	// one square block of the grid
+	struct Page
+		{ // struct Page
+		// which page this is
+		long id;
+		// the first square, and the number of squares down and across
+		long firstRow, firstColumn;
+		long nRows, nColumns;
+		// (nRows + 1) x (nColumns + 1) samples, row-major, sharing the
+		// last row and column with the next page
+		std::vector<float> samples;
+		// two per square, UR then LL, as in Terrain
+		std::vector<Cartesian3> normals;
+		// the use clock when last read, for choosing what to evict
+		std::atomic<unsigned long> lastUse;
+		}; // struct Page
+
+	// where a page is
+	enum PageState { Absent, Queued, Loading, Resident };
+
+	// the file and its layout
+	std::string fileName;
+	BinaryTerrainHeader header;
+	long nRows, nColumns;
+	long pageSize;
+	long pageRows, pageColumns;
+	long maxResidentPages;
+
+	// the stream used by demand loads, one at a time
+	std::ifstream demandFile;
+	std::mutex demandFileMutex;
+
+	// per page, the page if it is resident (read without a lock)
+	std::unique_ptr<std::atomic<Page *>[]> directory;
+
+	// everything below is guarded by cacheMutex
+	std::mutex cacheMutex;
+	std::vector<unsigned char> pageStates;
+	// the round in which StreamAround() last asked for each page;
+	// a page wanted in the current round is never evicted
+	std::vector<unsigned long> pageEpochs;
+	std::vector<std::unique_ptr<Page> > residentPages;
+	std::vector<std::unique_ptr<Page> > evictedPages;
+	std::deque<long> prefetchQueue;
+	unsigned long streamEpoch;
+	bool stopping;
+	std::condition_variable pageLoaded, prefetchWanted;
+	PageStats stats;
+
+	// advanced on every BeginStreaming() and every demand load
+	std::atomic<unsigned long> useClock;
+
+	std::vector<std::thread> prefetchThreads;
+
+	// the page holding a square, loading it if need be
+	const Page *FindPage(long row, long column);
+
+	// load a missing page, or wait for a thread that is already loading it
+	Page *DemandPage(long id);
+
+	// read a page from a stream
+	void ReadPage(std::ifstream &stream, long id, Page &page);
+
+	// build the height pyramid from the file's table of block bounds, with a
+	// level 0 cell per block; false if it can't be read
+	bool ReadBounds();
+
+	// evict the least recently used pages not wanted in keepEpoch until at most
+	// limit remain, or none are left that can go; cacheMutex must be held
+	void EvictDownTo(long limit, unsigned long keepEpoch);
+
+	// make a loaded page resident, evicting to make room; cacheMutex must be held
+	Page *InsertPage(std::unique_ptr<Page> page);
+
+	// body of each prefetch thread
+	void PrefetchLoop();
+
+	// a paged terrain can't be copied
+	PagedTerrain(const PagedTerrain &);
+	PagedTerrain &operator =(const PagedTerrain &);
+	}; // class PagedTerrain
+
+#endif
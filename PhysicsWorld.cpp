@@ -0,0 +1,847 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PhysicsWorld.cpp
+//	------------------------
+//
+//	The ball simulation, stepped at a fixed timestep
+//	independently of rendering
+//
+///////////////////////////////////////////////////
+
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+
+#include "PhysicsWorld.h"
+#include "Quaternion.h"
+#include "Replay.h"
+
+const float elasticityCoeff = 0.6;
+const float minVelocity = 0.01;
+const float minAngularVelocity = 0.001;
+
+// for hull contact, an approach faster than this bounces, and slower ones stop dead
+const float bounceSpeed = 1.0;
+
+// a sleeping ball overlapped by an awake one by less than this is left alone:
+// two balls resting that close can't be parted within a float's precision, and
+// would otherwise wake each other in turn for ever
+const float wakeOverlap = 1.0e-3;
+
+// the relaxation passes over the points of a manifold
+const int contactIterations = 8;
+
+// the terrain triangles under a hull are tested this many at a time
+const int maxContactTriangles = 64;
+
+// the rotation rule below was tuned at 24 fps, so it is rescaled to the step
+const float nominalFrameTime = 1.0 / 24.0;
+
+// constructor
+PhysicsWorld::PhysicsWorld()
+	:
+	terrain(NULL),
+	bodyModel(NULL),
+	gravity(0.0, 0.0, -9.8),
+	gravityScale(3.0),
+	ballRadius(1.0),
+	fixedTimeStep(1.0 / 120.0),
+	accumulator(0.0),
+	maxStepsPerAdvance(8),
+	stepNumber(0),
+	jobSystem(NULL),
+	bodiesPerJob(256),
+	collideBodies(true),
+	bodyContactCount(0),
+	terrainContactCount(0),
+	continuousCollision(true),
+	terrainSampling(FaceSampling),
+	bodyContact(SphereContact),
+	bodyInertia(0.4),
+	friction(0.5),
+	contactMargin(0.02),
+	contactSlop(0.005),
+	craterSpeed(0.0),
+	craterRadius(4.0),
+	craterDepth(0.02),
+	streamRadius(16.0),
+	viewRadius(128.0),
+	awakeCount(0),
+	sleepSpeed(0.05),
+	sleepTime(0.5),
+	lostDepth(16.0)
+	{ // constructor
+	SetCapacity(1024);
+	} // constructor
+
+// remove all the balls
+void PhysicsWorld::Clear()
+	{ // Clear()
+	bodies.Clear();
+	awakeCount = 0;
+	accumulator = 0.0;
+	RebuildSleepers();
+	} // Clear()
+
+// set the most balls the world will hold; space is allocated up front
+void PhysicsWorld::SetCapacity(int capacity)
+	{ // SetCapacity()
+	bodies.SetCapacity(capacity);
+	RebuildSleepers();
+	wakeList.reserve(capacity);
+	impactSpeeds.assign(capacity, 0.0);
+	candidatePairs.reserve(capacity);
+	} // SetCapacity()
+
+// add a ball at rest at the given position
+BodyHandle PhysicsWorld::AddBody(int creationFrame, const Cartesian3 &position, const Cartesian3 &angularVelocity)
+	{ // AddBody()
+	BodyHandle handle = bodies.Add(creationFrame, position, Cartesian3(0.0, 0.0, 0.0), angularVelocity);
+	if (!handle.IsValid())
+		return handle;
+
+	// new bodies start awake, so move it to the end of the awake range
+	bodies.Swap(bodies.Size() - 1, awakeCount);
+	awakeCount++;
+	return handle;
+	} // AddBody()
+
+// remove a ball, waking anything that was resting on it
+bool PhysicsWorld::RemoveBody(const BodyHandle &handle)
+	{ // RemoveBody()
+	int body = bodies.IndexOf(handle);
+	if (body < 0)
+		return false;
+
+	Cartesian3 position = bodies.Position(body);
+
+	// move an awake body to the end of the awake range first, so that
+	// filling its place from the end of the arrays keeps the partition
+	if (body < awakeCount)
+		{ // awake
+		awakeCount--;
+		bodies.Swap(body, awakeCount);
+		body = awakeCount;
+		} // awake
+	else
+		sleepers.Remove(bodies.indexToSlot[body]);
+	bodies.RemoveAt(body);
+
+	WakeBodiesInRegion(position.x - 2.0 * ballRadius, position.y - 2.0 * ballRadius, position.x + 2.0 * ballRadius, position.y + 2.0 * ballRadius);
+	return true;
+	} // RemoveBody()
+
+// change the ball mesh, rebuilding its hull
+void PhysicsWorld::SetBodyModel(IndexedFaceSurface *newBodyModel)
+	{ // SetBodyModel()
+	bodyModel = newBodyModel;
+	bodyHull.Build(bodyModel->vertices);
+	bodyInertia = bodyHull.MomentOfInertia();
+
+	// the old hints index the old hull
+	for (int body = 0; body < bodies.Size(); body++)
+		bodies.supportHint[body] = 0;
+	} // SetBodyModel()
+
+// change terrain, waking every body
+void PhysicsWorld::SetTerrain(Terrain *newTerrain)
+	{ // SetTerrain()
+	terrain = newTerrain;
+	WakeAll();
+	} // SetTerrain()
+
+// wake every body
+void PhysicsWorld::WakeAll()
+	{ // WakeAll()
+	for (int body = 0; body < bodies.Size(); body++)
+		bodies.sleepTimer[body] = 0.0;
+	awakeCount = bodies.Size();
+	RebuildSleepers();
+	} // WakeAll()
+
+// wake every body whose footprint overlaps a region of the terrain
+void PhysicsWorld::WakeBodiesInRegion(float minX, float minY, float maxX, float maxY)
+	{ // WakeBodiesInRegion()
+	// partition the sleeping range, moving the woken bodies to the front
+	for (int body = awakeCount; body < bodies.Size(); body++)
+		{ // per sleeping body
+		if (bodies.positionX[body] + ballRadius < minX || bodies.positionX[body] - ballRadius > maxX)
+			continue;
+		if (bodies.positionY[body] + ballRadius < minY || bodies.positionY[body] - ballRadius > maxY)
+			continue;
+		WakeBody(body);
+		} // per sleeping body
+	} // WakeBodiesInRegion()
+
+// move a sleeping body into the awake range, out of the sleepers' hash
+void PhysicsWorld::WakeBody(int body)
+	{ // WakeBody()
+	sleepers.Remove(bodies.indexToSlot[body]);
+	bodies.sleepTimer[body] = 0.0;
+	bodies.Swap(body, awakeCount);
+	awakeCount++;
+	} // WakeBody()
+
+// hash every sleeping body afresh
+void PhysicsWorld::RebuildSleepers()
+	{ // RebuildSleepers()
+	sleepers.Reset((int) bodies.slotToIndex.size(), 2.0 * ballRadius);
+	for (int body = awakeCount; body < bodies.Size(); body++)
+		sleepers.Insert(bodies.indexToSlot[body], bodies.positionX[body], bodies.positionY[body], bodies.positionZ[body]);
+	} // RebuildSleepers()
+
+// advance the simulation by exactly nSteps fixed steps
+void PhysicsWorld::Step(int nSteps)
+	{ // Step()
+	// every body is independent of the others, but the integration is vectorized
+	// with a scalar tail, so the serial loop takes the same chunks of
+	// bodiesPerJob as the threads do, and the result never depends on their number
+	std::atomic<int> terrainContacts(0);
+	JobSystem::RangeFunction stepRange = [this, &terrainContacts](int begin, int end)
+		{ terrainContacts += StepRange(begin, end, fixedTimeStep); };
+
+	for (int step = 0; step < nSteps; step++)
+		{ // per step
+		terrainContacts = 0;
+		WakeOnEdits();
+		StreamTerrain();
+		// only the awake bodies are integrated
+		if (jobSystem != NULL)
+			jobSystem->ParallelFor(awakeCount, bodiesPerJob, stepRange);
+		else
+			for (int begin = 0; begin < awakeCount; begin += std::max(bodiesPerJob, 1))
+				stepRange(begin, std::min(awakeCount, begin + std::max(bodiesPerJob, 1)));
+		if (collideBodies)
+			CollideBodies();
+		if (craterSpeed > 0.0)
+			DigCraters();
+		terrainContactCount = terrainContacts;
+		UpdateSleep(fixedTimeStep);
+		stepNumber++;
+		} // per step
+	} // Step()
+
+// wake the bodies on terrain edited since the last step
+void PhysicsWorld::WakeOnEdits()
+	{ // WakeOnEdits()
+	// a body asleep on ground that was raised or dug away would otherwise float or stay buried
+	if (terrain == NULL)
+		return;
+	for (const TerrainRect &rect : terrain->editedRects)
+		{ // per edit
+		float minX, minY, maxX, maxY;
+		terrain->RectBounds(rect, minX, minY, maxX, maxY);
+		WakeBodiesInRegion(minX, minY, maxX, maxY);
+		} // per edit
+	terrain->editedRects.clear();
+	} // WakeOnEdits()
+
+// dig the craters of the balls that struck the terrain hard this step
+void PhysicsWorld::DigCraters()
+	{ // DigCraters()
+	// the terrain can't change while the bodies are stepped across threads, so
+	// each records its impact, and the craters are dug here in body order
+	for (int body = 0; body < awakeCount; body++)
+		{ // per awake body
+		float speed = impactSpeeds[body];
+		impactSpeeds[body] = 0.0;
+		if (speed > craterSpeed)
+			terrain->Crater(bodies.positionX[body], bodies.positionY[body], craterRadius, craterDepth * (speed - craterSpeed));
+		} // per awake body
+	} // DigCraters()
+
+// tell the terrain where the next step will look
+void PhysicsWorld::StreamTerrain()
+	{ // StreamTerrain()
+	if (terrain == NULL)
+		return;
+	// the awake bodies are at the front of the store, so their positions can be passed as they lie
+	terrain->BeginStreaming();
+	terrain->StreamAround(bodies.positionX.data(), bodies.positionY.data(), awakeCount, streamRadius);
+	for (const Cartesian3 &point : viewPoints)
+		terrain->StreamAround(&point.x, &point.y, 1, viewRadius);
+	} // StreamTerrain()
+
+// integrate and resolve the bodies in [begin, end) by one step
+int PhysicsWorld::StepRange(int begin, int end, float dt)
+	{ // StepRange()
+	int count = end - begin;
+
+	// keep the start of step positions for render interpolation
+	std::copy(bodies.positionX.begin() + begin, bodies.positionX.begin() + end, bodies.previousX.begin() + begin);
+	std::copy(bodies.positionY.begin() + begin, bodies.positionY.begin() + end, bodies.previousY.begin() + begin);
+	std::copy(bodies.positionZ.begin() + begin, bodies.positionZ.begin() + end, bodies.previousZ.begin() + begin);
+
+	// calculate velocity of the balls
+	// v = u + at
+	// gravity is scaled up for better effect
+	IntegrateConstantAcceleration(bodies.velocityX.data() + begin, count, gravity.x * gravityScale, dt);
+	IntegrateConstantAcceleration(bodies.velocityY.data() + begin, count, gravity.y * gravityScale, dt);
+	IntegrateConstantAcceleration(bodies.velocityZ.data() + begin, count, gravity.z * gravityScale, dt);
+
+	// calculate position of the balls
+	// x = x + vt
+	IntegrateVelocity(bodies.positionX.data() + begin, bodies.velocityX.data() + begin, count, dt);
+	IntegrateVelocity(bodies.positionY.data() + begin, bodies.velocityY.data() + begin, count, dt);
+	IntegrateVelocity(bodies.positionZ.data() + begin, bodies.velocityZ.data() + begin, count, dt);
+
+	// then the per-ball terrain contact and rotation
+	int terrainContacts = 0;
+	for (int body = begin; body < end; body++)
+		if (ResolveBody(body, dt))
+			terrainContacts++;
+	return terrainContacts;
+	} // StepRange()
+
+// add elapsed wall-clock time and run as many fixed steps as it covers
+int PhysicsWorld::Advance(float elapsedSeconds)
+	{ // Advance()
+	accumulator += elapsedSeconds;
+
+	int nSteps = (int) (accumulator / fixedTimeStep);
+	if (nSteps > maxStepsPerAdvance)
+		{ // fell too far behind
+		// drop the backlog rather than trying to catch up with it
+		nSteps = maxStepsPerAdvance;
+		accumulator = nSteps * fixedTimeStep;
+		} // fell too far behind
+
+	Step(nSteps);
+	accumulator -= nSteps * fixedTimeStep;
+	return nSteps;
+	} // Advance()
+
+// fraction of a step left in the accumulator, for render interpolation
+float PhysicsWorld::InterpolationAlpha() const
+	{ // InterpolationAlpha()
+	return accumulator / fixedTimeStep;
+	} // InterpolationAlpha()
+
+// position of a ball interpolated between the last two steps
+Cartesian3 PhysicsWorld::InterpolatedPosition(int body, float alpha) const
+	{ // InterpolatedPosition()
+	Cartesian3 previous = bodies.PreviousPosition(body);
+	return previous + (bodies.Position(body) - previous) * alpha;
+	} // InterpolatedPosition()
+
+// count the balls overlapping a vertical cylinder standing at (x, y)
+int PhysicsWorld::CountCylinderOverlaps(float x, float y, float bottom, float top, float radius) const
+	{ // CountCylinderOverlaps()
+	int overlaps = 0;
+	for (int body = 0; body < bodies.Size(); body++)
+		{ // per ball
+		// horizontal collision
+		float dx = bodies.positionX[body] - x;
+		float dy = bodies.positionY[body] - y;
+		float distance = sqrt(dx * dx + dy * dy);
+		bool horizontalOverlap = distance <= ballRadius + radius;
+
+		// vertical collision
+		float z = bodies.positionZ[body];
+		bool verticalOverlap = z + ballRadius >= bottom && z - ballRadius <= top;
+
+		if (horizontalOverlap && verticalOverlap)
+			overlaps++;
+		} // per ball
+	return overlaps;
+	} // CountCylinderOverlaps()
+
+// find and resolve collisions between balls
+void PhysicsWorld::CollideBodies()
+	{ // CollideBodies()
+	// broadphase: cells one ball across, so touching balls are in neighbouring cells
+	// the awake bodies are hashed afresh and paired with each other, then with the
+	// sleepers near them, whose hash only changes as bodies fall asleep or wake
+	float cellSize = 2.0 * ballRadius;
+	broadphase.Build(bodies.positionX.data(), bodies.positionY.data(), bodies.positionZ.data(), awakeCount, cellSize);
+	broadphase.FindPairs(candidatePairs, jobSystem);
+	if (sleepers.cellSize != cellSize)
+		RebuildSleepers();
+	sleepers.AppendPairs(bodies.positionX.data(), bodies.positionY.data(), bodies.positionZ.data(), awakeCount,
+		bodies.slotToIndex.data(), candidatePairs, jobSystem);
+	wakeList.clear();
+
+	// narrowphase: resolve the touching pairs serially, in pair order, so the
+	// result does not depend on the thread count
+	bodyContactCount = 0;
+	float minDistance = 2.0 * ballRadius;
+	for (const auto& pair : candidatePairs)
+		{ // per pair
+		int a = pair.first, b = pair.second;
+		float dx = bodies.positionX[b] - bodies.positionX[a];
+		float dy = bodies.positionY[b] - bodies.positionY[a];
+		float dz = bodies.positionZ[b] - bodies.positionZ[a];
+		float distanceSquared = dx * dx + dy * dy + dz * dz;
+		if (distanceSquared >= minDistance * minDistance || distanceSquared == 0.0)
+			continue;
+		bodyContactCount++;
+
+		// touching an awake body wakes a sleeping one
+		float distance = sqrt(distanceSquared);
+		if (b >= awakeCount)
+			{ // asleep
+			if (minDistance - distance <= wakeOverlap)
+				continue;
+			wakeList.push_back(b);
+			} // asleep
+
+		// separate the balls equally along the line of centres
+		Cartesian3 normal(dx / distance, dy / distance, dz / distance);
+		Cartesian3 correction = normal * (0.5 * (minDistance - distance));
+		bodies.SetPosition(a, bodies.Position(a) - correction);
+		bodies.SetPosition(b, bodies.Position(b) + correction);
+
+		// then exchange momentum if they are approaching, equal masses assumed
+		Cartesian3 velocityA = bodies.LinearVelocity(a);
+		Cartesian3 velocityB = bodies.LinearVelocity(b);
+		float approachSpeed = (velocityB - velocityA).dot(normal);
+		if (approachSpeed >= 0.0)
+			continue;
+		Cartesian3 J = normal * (-(1 + elasticityCoeff) * approachSpeed * 0.5);
+		bodies.SetLinearVelocity(a, velocityA - J);
+		bodies.SetLinearVelocity(b, velocityB + J);
+		} // per pair
+	} // CollideBodies()
+
+// put resting and lost bodies to sleep and wake the flagged ones
+void PhysicsWorld::UpdateSleep(float dt)
+	{ // UpdateSleep()
+	// the speed is measured from the distance actually moved in the step:
+	// a resting ball keeps a small bounce velocity that the terrain contact
+	// cancels every step, and the rotation rule keeps the angular velocity at
+	// unit length, so neither velocity says whether the ball is at rest
+	float distanceLimit = sleepSpeed * dt;
+	distanceLimit *= distanceLimit;
+
+	// nothing below the terrain can land on it again
+	float lostHeight = terrain != NULL ? terrain->minHeight - lostDepth : -HUGE_VALF;
+
+	// walk the awake range backwards, swapping sleepers to its end
+	for (int body = awakeCount - 1; body >= 0; body--)
+		{ // per awake body
+		// a lost body sleeps at once, and any other once it has rested for sleepTime
+		if (bodies.positionZ[body] >= lostHeight)
+			{ // not lost
+			float dx = bodies.positionX[body] - bodies.previousX[body];
+			float dy = bodies.positionY[body] - bodies.previousY[body];
+			float dz = bodies.positionZ[body] - bodies.previousZ[body];
+			if (dx * dx + dy * dy + dz * dz > distanceLimit)
+				{ // still moving
+				bodies.sleepTimer[body] = 0.0;
+				continue;
+				} // still moving
+
+			bodies.sleepTimer[body] += dt;
+			if (bodies.sleepTimer[body] < sleepTime)
+				continue;
+			} // not lost
+
+		// asleep: stop it dead, with nothing left to interpolate
+		bodies.SetLinearVelocity(body, Cartesian3(0.0, 0.0, 0.0));
+		bodies.SetAngularVelocity(body, Cartesian3(0.0, 0.0, 0.0));
+		bodies.previousX[body] = bodies.positionX[body];
+		bodies.previousY[body] = bodies.positionY[body];
+		bodies.previousZ[body] = bodies.positionZ[body];
+		sleepers.Insert(bodies.indexToSlot[body], bodies.positionX[body], bodies.positionY[body], bodies.positionZ[body]);
+		awakeCount--;
+		bodies.Swap(body, awakeCount);
+		} // per awake body
+
+	// then wake the touched sleepers, which the loop above didn't move, in
+	// index order so that the order of the bodies doesn't depend on the pairs'
+	std::sort(wakeList.begin(), wakeList.end());
+	wakeList.erase(std::unique(wakeList.begin(), wakeList.end()), wakeList.end());
+	for (int body : wakeList)
+		WakeBody(body);
+	wakeList.clear();
+	} // UpdateSleep()
+
+// resolve terrain contact and rotation for a single ball after integration
+bool PhysicsWorld::ResolveBody(int body, float dt)
+	{ // ResolveBody()
+	if (bodyContact == HullContact)
+		return ResolveHull(body, dt);
+
+	Cartesian3 position = bodies.Position(body);
+	Cartesian3 linearVelocity = bodies.LinearVelocity(body);
+	Cartesian3 angularVelocity = bodies.AngularVelocity(body);
+	Cartesian3 previousPosition = bodies.PreviousPosition(body);
+
+	// a ball whose whole motion this step stays above the ground beneath it
+	// skips both contact tests, which the terrain's height pyramid settles cheaply;
+	// a bicubic surface can rise above the samples, so it is always tested
+	Cartesian3 lower(std::min(previousPosition.x, position.x), std::min(previousPosition.y, position.y), std::min(previousPosition.z, position.z) - ballRadius);
+	Cartesian3 upper(std::max(previousPosition.x, position.x), std::max(previousPosition.y, position.y), std::max(previousPosition.z, position.z) + ballRadius);
+	bool clear = terrainSampling != BicubicSampling && terrain->BoxClear(lower, upper);
+
+	// sweep the motion of the step, so that a fast ball stops at the first
+	// surface it touches instead of passing through a thin ridge
+	// a ball already touching at the start is left to the discrete test below,
+	// so that it can still slide along the ground
+	float timeOfImpact = 0.0;
+	Cartesian3 sweptNormal;
+	bool swept = !clear && continuousCollision
+		&& terrain->SweepSphere(previousPosition, position, ballRadius, timeOfImpact, sweptNormal)
+		&& timeOfImpact > 0.0;
+	if (swept)
+		{ // stop at first touch
+		position = previousPosition + (position - previousPosition) * timeOfImpact;
+		bodies.SetPosition(body, position);
+		} // stop at first touch
+
+	// balls pushed off the edge of the map have nothing to land on
+	bool overTerrain = !clear && terrain->Contains(position.x, position.y);
+
+	float planeHeight = 0.0;
+	if (overTerrain)
+		switch (terrainSampling)
+			{ // sampling
+			case BilinearSampling: planeHeight = terrain->getHeightBilinear(position.x, position.y); break;
+			case BicubicSampling: planeHeight = terrain->getHeightBicubic(position.x, position.y); break;
+			default: planeHeight = terrain->getHeight(position.x, position.y); break;
+			} // sampling
+
+	// collision detection with the terrain
+	bool touching = overTerrain && (swept || position.z <= planeHeight + ballRadius);
+	if (touching && fabs(linearVelocity.z) > minVelocity)
+		{ // terrain collision
+		position.z = planeHeight + ballRadius;
+		bodies.SetPosition(body, position);
+
+		// calculate the normal of the terrain; the sweep's is that of a face, so
+		// the smooth samplers replace it with their own at the point of contact
+		Cartesian3 normal;
+		switch (terrainSampling)
+			{ // sampling
+			case BilinearSampling: normal = terrain->getNormalBilinear(position.x, position.y); break;
+			case BicubicSampling: normal = terrain->getNormalBicubic(position.x, position.y); break;
+			default: normal = swept ? sweptNormal : terrain->getNormal(position.x, position.y); break;
+			} // sampling
+		normal = normal.unit();
+
+		float VdotN = linearVelocity.dot(normal);
+		if (craterSpeed > 0.0)
+			impactSpeeds[body] = -VdotN;
+		auto impulse = -(1 + elasticityCoeff) * VdotN;
+		auto J = impulse * normal * 1.15;
+
+		auto collisionVertex = findCollisionVertex(body);
+		auto r = collisionVertex - position;
+		auto torque = r.cross(J);
+
+		linearVelocity = linearVelocity + J; // mass is assumed to be 1
+		angularVelocity = angularVelocity + torque*dt; // mass is assumed to be 1
+
+		// special case if the ball is stuck in the terrain
+		if (position.z + linearVelocity.z <= planeHeight + ballRadius)
+			{ // stuck
+			linearVelocity = Cartesian3(0, 0, 0);
+			angularVelocity = Cartesian3(0, 0, 0);
+			} // stuck
+		bodies.SetLinearVelocity(body, linearVelocity);
+		} // terrain collision
+
+	// calculate orientation/rotation of the ball from angular velocity
+	if (angularVelocity.length() > minAngularVelocity)
+		{ // rotating
+		auto halfTheta = angularVelocity.length() / 2;
+		if (halfTheta > 0.2)
+			halfTheta = 0.2;
+		halfTheta *= dt / nominalFrameTime;
+
+		angularVelocity = angularVelocity.unit();
+		auto w = cos(halfTheta);
+		auto x = angularVelocity.x * sin(halfTheta);
+		auto y = angularVelocity.y * sin(halfTheta);
+		auto z = angularVelocity.z * sin(halfTheta);
+
+		// compose on the left, as the rotation matrix used to be
+		Quaternion orientation = Quaternion(x, y, z, w) * bodies.Orientation(body);
+		float length = sqrt(orientation.Norm());
+		bodies.SetOrientation(body, orientation / length);
+		} // rotating
+	bodies.SetAngularVelocity(body, angularVelocity);
+	return touching;
+	} // ResolveBody()
+
+// resolve terrain contact and rotation for a single body as its hull
+bool PhysicsWorld::ResolveHull(int body, float dt)
+	{ // ResolveHull()
+	Cartesian3 position = bodies.Position(body);
+	Cartesian3 linearVelocity = bodies.LinearVelocity(body);
+	Cartesian3 angularVelocity = bodies.AngularVelocity(body);
+	Cartesian3 previousPosition = bodies.PreviousPosition(body);
+
+	// the hull lies within ballRadius of the centre, so the sphere's tests are
+	// conservative for it: a body whose motion stays above the ground is clear, and
+	// one swept into it stops where its bounding sphere first touches
+	float reach = ballRadius + contactMargin;
+	Cartesian3 lower(std::min(previousPosition.x, position.x), std::min(previousPosition.y, position.y), std::min(previousPosition.z, position.z) - reach);
+	Cartesian3 upper(std::max(previousPosition.x, position.x), std::max(previousPosition.y, position.y), std::max(previousPosition.z, position.z) + reach);
+	bool clear = terrain->BoxClear(lower, upper);
+	float timeOfImpact = 0.0;
+	Cartesian3 sweptNormal;
+	if (!clear && continuousCollision
+		&& terrain->SweepSphere(previousPosition, position, ballRadius, timeOfImpact, sweptNormal) && timeOfImpact > 0.0)
+		{ // stop at first touch
+		position = previousPosition + (position - previousPosition) * timeOfImpact;
+		} // stop at first touch
+
+	ContactManifold manifold;
+	if (!clear)
+		FindHullContacts(body, position, manifold);
+
+	Cartesian3 pushVelocity(0.0, 0.0, 0.0), pushSpin(0.0, 0.0, 0.0);
+	if (manifold.count > 0)
+		{ // terrain contact
+		if (craterSpeed > 0.0)
+			impactSpeeds[body] = -linearVelocity.dot(manifold.points[manifold.Deepest()].normal);
+		SolveContacts(manifold, position, dt, linearVelocity, angularVelocity, pushVelocity, pushSpin);
+
+		// the push moves the body out of the ground over the step, but is not kept
+		position = position + pushVelocity * dt;
+		} // terrain contact
+	bodies.SetPosition(body, position);
+	bodies.SetLinearVelocity(body, linearVelocity);
+	bodies.SetAngularVelocity(body, angularVelocity);
+
+	// turn by the angular velocity and the push over the step, composing on the left in world space
+	Cartesian3 turn = angularVelocity + pushSpin;
+	float speed = turn.length();
+	if (speed > minAngularVelocity)
+		{ // rotating
+		Quaternion orientation = Quaternion(turn / speed, 0.5 * speed * dt) * bodies.Orientation(body);
+		float length = sqrt(orientation.Norm());
+		bodies.SetOrientation(body, orientation / length);
+		} // rotating
+
+	// a body within the margin is held by the ground but doesn't count as touching it
+	for (int point = 0; point < manifold.count; point++)
+		if (manifold.points[point].depth >= 0.0)
+			return true;
+	return false;
+	} // ResolveHull()
+
+// find the points where a body's hull meets the terrain
+void PhysicsWorld::FindHullContacts(int body, const Cartesian3 &position, ContactManifold &manifold)
+	{ // FindHullContacts()
+	// balls pushed off the edge of the map have nothing to land on
+	if (!terrain->Contains(position.x, position.y))
+		return;
+
+	PlacedHull hull;
+	hull.hull = &bodyHull;
+	hull.position = position;
+	Matrix4 orientation = bodies.OrientationMatrix(body);
+	for (int row = 0; row < 3; row++)
+		for (int column = 0; column < 3; column++)
+			hull.rotation[row][column] = orientation.coordinates[row][column];
+
+	// the triangles under the bounding sphere, taken a buffer at a time so that
+	// a body spanning many squares still meets every one of them
+	float reach = ballRadius + contactMargin;
+	Cartesian3 triangles[3 * maxContactTriangles];
+	int hint = bodies.supportHint[body];
+	int nTriangles = 0;
+	for (int firstTriangle = 0; firstTriangle == 0 || firstTriangle < nTriangles; firstTriangle += maxContactTriangles)
+		{ // per chunk
+		nTriangles = terrain->TrianglesUnder(position.x - reach, position.y - reach, position.x + reach, position.y + reach,
+			triangles, maxContactTriangles, firstTriangle);
+		int nChunk = std::min(maxContactTriangles, nTriangles - firstTriangle);
+		for (int triangle = 0; triangle < nChunk; triangle++)
+			{ // per triangle
+			const Cartesian3 *corners = triangles + 3 * triangle;
+			if (ConvexCollision::DistanceSquared(corners, position) > reach * reach)
+				continue;
+			bool clear;
+			if (ConvexCollision::AddFaceContacts(hull, corners, contactMargin, contactSlop, hint, clear, manifold) || clear)
+				continue;
+
+			// the hull meets an edge or corner: its searches start from the lowest
+			// vertex, but wander, so they keep their own hint
+			int edgeHint = hint;
+			Cartesian3 normal, hullPoint, trianglePoint;
+			float separation;
+			if (!ConvexCollision::TriangleContact(hull, corners, contactMargin, edgeHint, normal, separation, hullPoint, trianglePoint))
+				continue;
+			Cartesian3 faceNormal = (corners[1] - corners[0]).cross(corners[2] - corners[0]).unit();
+			if (!RidgeNormal(faceNormal, trianglePoint, normal))
+				{ // along the face
+				// a vertex on the edge of a valley is over neither face, so it is held
+				// by this one, at its depth below the plane
+				normal = faceNormal;
+				separation = (hullPoint - corners[0]).dot(faceNormal);
+				if (separation > contactMargin)
+					continue;
+				} // along the face
+			ContactPoint point = { (hullPoint + trianglePoint) * 0.5, normal, -separation };
+			manifold.Add(point);
+			} // per triangle
+		} // per chunk
+	bodies.supportHint[body] = hint;
+	} // FindHullContacts()
+
+// the normal of a contact at an edge or corner of a terrain triangle
+bool PhysicsWorld::RidgeNormal(const Cartesian3 &faceNormal, const Cartesian3 &point, Cartesian3 &normal)
+	{ // RidgeNormal()
+	// a normal from above needs no correction
+	Cartesian3 across(normal.x, normal.y, 0.0);
+	float length = across.length();
+	if (length < 1.0e-4)
+		return true;
+	across = across / length;
+
+	// the face beyond the edge, the way the normal leans
+	Cartesian3 beyondPoint = point + across * (0.01 * terrain->xyScale);
+	if (!terrain->Contains(beyondPoint.x, beyondPoint.y))
+		return true;
+	Cartesian3 beyond = terrain->getNormal(beyondPoint.x, beyondPoint.y).unit();
+
+	// flat ground and valleys: the faces either side hold the body up
+	float nearLean = faceNormal.dot(across), farLean = beyond.dot(across);
+	if (farLean <= nearLean + 1.0e-3)
+		return false;
+
+	// over a ridge, lean no further than the faces do
+	float lean = normal.dot(across);
+	if (lean > farLean)
+		normal = beyond;
+	else if (lean < nearLean)
+		normal = faceNormal;
+	return true;
+	} // RidgeNormal()
+
+// the impulses at the points of a manifold
+void PhysicsWorld::SolveContacts(const ContactManifold &manifold, const Cartesian3 &position, float dt,
+	Cartesian3 &linearVelocity, Cartesian3 &angularVelocity, Cartesian3 &pushVelocity, Cartesian3 &pushSpin)
+	{ // SolveContacts()
+	// mass is 1, and the inertia is the same about every axis, so the inverse
+	// inertia tensor is a scalar in any frame
+	float inverseInertia = 1.0 / bodyInertia;
+
+	// per point: the arm from the centre, the tangents, the effective masses, the
+	// speed it should leave at, the speed it should be pushed out of the ground
+	// at, and the impulses accumulated so far
+	struct PointState
+		{ // struct PointState
+		Cartesian3 arm, tangents[2];
+		float normalMass, tangentMass[2];
+		float targetSpeed, pushSpeed;
+		float normalImpulse, tangentImpulse[2], pushImpulse;
+		};
+	PointState states[ContactManifold::maxPoints];
+	for (int point = 0; point < manifold.count; point++)
+		{ // per point
+		const ContactPoint &contact = manifold.points[point];
+		PointState &state = states[point];
+		state.arm = contact.position - position;
+		Cartesian3 armCross = state.arm.cross(contact.normal);
+		state.normalMass = 1.0 / (1.0 + inverseInertia * armCross.dot(armCross));
+
+		Cartesian3 reference = fabs(contact.normal.x) < 0.57 ? Cartesian3(1.0, 0.0, 0.0) : Cartesian3(0.0, 1.0, 0.0);
+		state.tangents[0] = contact.normal.cross(reference).unit();
+		state.tangents[1] = contact.normal.cross(state.tangents[0]);
+		for (int tangent = 0; tangent < 2; tangent++)
+			{ // per tangent
+			armCross = state.arm.cross(state.tangents[tangent]);
+			state.tangentMass[tangent] = 1.0 / (1.0 + inverseInertia * armCross.dot(armCross));
+			state.tangentImpulse[tangent] = 0.0;
+			} // per tangent
+
+		// a point short of the ground may close the gap this step but no more; one
+		// struck hard bounces back, and otherwise it comes to rest
+		float approach = (linearVelocity + angularVelocity.cross(state.arm)).dot(contact.normal);
+		if (contact.depth < 0.0)
+			state.targetSpeed = contact.depth / dt;
+		else
+			state.targetSpeed = approach < -bounceSpeed ? -elasticityCoeff * approach : 0.0;
+		state.normalImpulse = 0.0;
+
+		// a point deeper than the slop is pushed out of the ground over the step
+		state.pushSpeed = std::max(contact.depth - contactSlop, 0.0f) / dt;
+		state.pushImpulse = 0.0;
+		} // per point
+
+	// relax the points in turn, clamping the accumulated impulses: the ground only
+	// pushes, and friction holds no more than friction times that push
+	for (int iteration = 0; iteration < contactIterations; iteration++)
+		for (int point = 0; point < manifold.count; point++)
+			{ // per point
+			const ContactPoint &contact = manifold.points[point];
+			PointState &state = states[point];
+
+			float speed = (linearVelocity + angularVelocity.cross(state.arm)).dot(contact.normal);
+			float impulse = std::max(state.normalImpulse + (state.targetSpeed - speed) * state.normalMass, 0.0f);
+			Cartesian3 change = contact.normal * (impulse - state.normalImpulse);
+			state.normalImpulse = impulse;
+			linearVelocity = linearVelocity + change;
+			angularVelocity = angularVelocity + state.arm.cross(change) * inverseInertia;
+
+			float limit = friction * state.normalImpulse;
+			for (int tangent = 0; tangent < 2; tangent++)
+				{ // per tangent
+				speed = (linearVelocity + angularVelocity.cross(state.arm)).dot(state.tangents[tangent]);
+				impulse = state.tangentImpulse[tangent] - speed * state.tangentMass[tangent];
+				impulse = std::max(-limit, std::min(limit, impulse));
+				change = state.tangents[tangent] * (impulse - state.tangentImpulse[tangent]);
+				state.tangentImpulse[tangent] = impulse;
+				linearVelocity = linearVelocity + change;
+				angularVelocity = angularVelocity + state.arm.cross(change) * inverseInertia;
+				} // per tangent
+			} // per point
+
+	// then the push, relaxed in the same way but on velocities of its own, which
+	// move the body for this step only, so that it adds no energy
+	pushVelocity = Cartesian3(0.0, 0.0, 0.0);
+	pushSpin = Cartesian3(0.0, 0.0, 0.0);
+	for (int iteration = 0; iteration < contactIterations; iteration++)
+		for (int point = 0; point < manifold.count; point++)
+			{ // per point
+			const ContactPoint &contact = manifold.points[point];
+			PointState &state = states[point];
+
+			float speed = (pushVelocity + pushSpin.cross(state.arm)).dot(contact.normal);
+			float impulse = std::max(state.pushImpulse + (state.pushSpeed - speed) * state.normalMass, 0.0f);
+			Cartesian3 change = contact.normal * (impulse - state.pushImpulse);
+			state.pushImpulse = impulse;
+			pushVelocity = pushVelocity + change;
+			pushSpin = pushSpin + state.arm.cross(change) * inverseInertia;
+			} // per point
+	} // SolveContacts()
+
+// hash of the simulation state, for checking that a replay matches
+unsigned long long PhysicsWorld::StateHash() const
+	{ // StateHash()
+	unsigned long long hash = HashBytes(FNVOffsetBasis, &stepNumber, sizeof(stepNumber));
+	int nBodies = bodies.Size();
+	hash = HashBytes(hash, &nBodies, sizeof(nBodies));
+	const FloatArray *fields[] =
+		{
+		&bodies.positionX, &bodies.positionY, &bodies.positionZ,
+		&bodies.velocityX, &bodies.velocityY, &bodies.velocityZ,
+		&bodies.angularX, &bodies.angularY, &bodies.angularZ,
+		&bodies.orientationX, &bodies.orientationY, &bodies.orientationZ, &bodies.orientationW
+		};
+	for (const FloatArray *field : fields)
+		hash = HashBytes(hash, field->data(), nBodies * sizeof(float));
+	return hash;
+	} // StateHash()
+
+// find the lowest vertex of a ball in world coordinates
+Cartesian3 PhysicsWorld::findCollisionVertex(int body)
+	{ // findCollisionVertex()
+	Cartesian3 position = bodies.Position(body);
+	Matrix4 orientationR = bodies.OrientationMatrix(body);
+
+	// the lowest vertex is the support point in the world -z direction,
+	// which in body coordinates is minus the third row of the rotation
+	Cartesian3 down(-orientationR.coordinates[2][0], -orientationR.coordinates[2][1], -orientationR.coordinates[2][2]);
+
+	// start from last step's answer, which is usually it or a neighbour
+	int vertex = bodyHull.Support(down, bodies.supportHint[body]);
+	bodies.supportHint[body] = vertex;
+
+	// convert the vertex position to world coordinates
+	return orientationR * bodyHull.vertices[vertex] + position;
+	} // findCollisionVertex()
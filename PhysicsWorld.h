@@ -0,0 +1,245 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PhysicsWorld.h
+//	------------------------
+//
+//	The ball simulation, stepped at a fixed timestep
+//	independently of rendering
+//
+///////////////////////////////////////////////////
+
+#ifndef _PHYSICS_WORLD_H
+#define _PHYSICS_WORLD_H
+
+#include <vector>
+
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "IndexedFaceSurface.h"
+#include "Terrain.h"
+#include "BodyStore.h"
+#include "JobSystem.h"
+#include "SpatialHash.h"
+#include "ConvexHull.h"
+#include "ConvexCollision.h"
+
+class PhysicsWorld
+	{ // class PhysicsWorld
+	public:
+	// the terrain the balls collide with
+	Terrain *terrain;
+
+	// the mesh used for every ball, and its convex hull for finding the contact vertex
+	IndexedFaceSurface *bodyModel;
+	ConvexHull bodyHull;
+
+	// the balls themselves, stored as structure-of-arrays
+	BodyStore bodies;
+
+	// gravity, and the scale factor applied to it for better effect
+	Cartesian3 gravity;
+	float gravityScale;
+
+	// radius of the bounding sphere of a ball
+	float ballRadius;
+
+	// the fixed timestep in seconds
+	float fixedTimeStep;
+
+	// unsimulated time carried over between calls to Advance()
+	float accumulator;
+
+	// upper bound on catch-up steps, so a long stall doesn't spiral
+	int maxStepsPerAdvance;
+
+	// total number of steps taken
+	unsigned long stepNumber;
+
+	// thread pool for stepping bodies in parallel (NULL steps serially)
+	JobSystem *jobSystem;
+
+	// number of bodies handed to each job; a serial step takes the same
+	// chunks, so that the result is the same on any number of threads
+	int bodiesPerJob;
+
+	// whether balls collide with each other as well as the terrain
+	bool collideBodies;
+
+	// broadphase for ball-ball collisions, rebuilt each step over the awake
+	// bodies, and the candidate pairs it found
+	SpatialHash broadphase;
+	std::vector<BodyPair> candidatePairs;
+
+	// the sleeping bodies, by slot, hashed as they fall asleep and removed as
+	// they wake, so that a step costs nothing per sleeper
+	StaticSpatialHash sleepers;
+
+	// number of touching ball pairs found in the last step
+	int bodyContactCount;
+
+	// number of balls touching the terrain in the last step
+	int terrainContactCount;
+
+	// sweep each step's motion against the terrain rather than only testing
+	// where the ball ends up, so large timesteps and fast balls don't tunnel
+	bool continuousCollision;
+
+	// how the ground under a ball is sampled: the flat faces of the mesh (the
+	// default, which replays match), or the smooth bilinear or bicubic surface
+	// through the samples, whose normals don't jump at the triangle edges
+	enum TerrainSampling { FaceSampling, BilinearSampling, BicubicSampling };
+	TerrainSampling terrainSampling;
+
+	// how a body meets the terrain: as a ball of ballRadius on the ground under
+	// its centre, turned by the impulse at its lowest vertex (the default, which
+	// replays match), or as the convex hull of the body model against the terrain
+	// triangles beneath it, by GJK and EPA, with the contact manifold resolved by
+	// impulses with friction on a rigid body.  Hull contact ignores terrainSampling,
+	// since the triangles are the faces of the mesh
+	enum BodyContact { SphereContact, HullContact };
+	BodyContact bodyContact;
+
+	// for hull contact: the moment of inertia of the body model per unit mass
+	// (set from its hull), the coefficient of friction, the gap within which
+	// contacts are kept so that a body resting on the ground stays in touch, and
+	// the depth left unresolved so that it doesn't jitter
+	float bodyInertia;
+	float friction;
+	float contactMargin;
+	float contactSlop;
+
+	// a ball striking the terrain faster than craterSpeed digs a crater of
+	// craterRadius under it, craterDepth deep for each unit of speed beyond
+	// that (zero, the default, leaves the ground alone, which replays match)
+	float craterSpeed;
+	float craterRadius;
+	float craterDepth;
+
+	// the speed each awake body struck the terrain at in the current step
+	std::vector<float> impactSpeeds;
+
+	// for a terrain that streams its heights in, how far around each awake body
+	// to keep them, and other points (such as the viewer) to keep them around
+	float streamRadius;
+	std::vector<Cartesian3> viewPoints;
+	float viewRadius;
+
+	// bodies [0, awakeCount) are awake, the rest are asleep and not integrated
+	int awakeCount;
+
+	// a body falls asleep once it moves slower than sleepSpeed for sleepTime seconds
+	float sleepSpeed;
+	float sleepTime;
+
+	// a body that falls off the edge of the map is put to sleep where it is once
+	// it is lostDepth below the lowest point of the terrain, rather than falling forever
+	float lostDepth;
+
+	// sleeping bodies touched in the current step, to wake at its end
+	std::vector<int> wakeList;
+
+	// constructor
+	PhysicsWorld();
+
+	// remove all the balls
+	void Clear();
+
+	// set the most balls the world will hold; space is allocated up front
+	void SetCapacity(int capacity);
+
+	// add a ball at rest at the given position
+	// returns an invalid handle if the world is full
+	BodyHandle AddBody(int creationFrame, const Cartesian3 &position, const Cartesian3 &angularVelocity);
+
+	// remove a ball, waking anything that was resting on it
+	// returns false if the handle was stale
+	bool RemoveBody(const BodyHandle &handle);
+
+	// change the ball mesh, rebuilding its hull
+	void SetBodyModel(IndexedFaceSurface *newBodyModel);
+
+	// change terrain, waking every body
+	void SetTerrain(Terrain *newTerrain);
+
+	// wake every body, or every body whose footprint overlaps a region of the terrain
+	void WakeAll();
+	void WakeBodiesInRegion(float minX, float minY, float maxX, float maxY);
+
+	// advance the simulation by exactly nSteps fixed steps
+	void Step(int nSteps = 1);
+
+	// add elapsed wall-clock time and run as many fixed steps as it covers
+	// returns the number of steps taken
+	int Advance(float elapsedSeconds);
+
+	// fraction of a step left in the accumulator, for render interpolation
+	float InterpolationAlpha() const;
+
+	// position of a ball interpolated between the last two steps
+	Cartesian3 InterpolatedPosition(int body, float alpha) const;
+
+	// count the balls overlapping a vertical cylinder standing at (x, y)
+	int CountCylinderOverlaps(float x, float y, float bottom, float top, float radius) const;
+
+	// hash of the simulation state (step count and every body's position,
+	// velocity and orientation, bit for bit), for checking that a replay
+	// reproduces a recorded run exactly
+	unsigned long long StateHash() const;
+
+	// find the lowest vertex of a ball in world coordinates
+	// this updates the body's support hint, so only the thread stepping
+	// the body may call it
+	Cartesian3 findCollisionVertex(int body);
+
+	private:
+	// integrate and resolve the bodies in [begin, end) by one step
+	// returns how many of them touched the terrain
+	int StepRange(int begin, int end, float dt);
+
+	// find and resolve collisions between balls
+	void CollideBodies();
+
+	// wake the bodies on terrain edited since the last step
+	void WakeOnEdits();
+
+	// tell the terrain where the next step will look
+	void StreamTerrain();
+
+	// dig the craters of the balls that struck the terrain hard this step
+	void DigCraters();
+
+	// put resting and lost bodies to sleep and wake the touched ones
+	void UpdateSleep(float dt);
+
+	// move a sleeping body into the awake range, out of the sleepers' hash
+	void WakeBody(int body);
+
+	// hash every sleeping body afresh, for a new capacity or ball size
+	void RebuildSleepers();
+
+	// resolve terrain contact and rotation for a single ball after integration
+	// returns true if it touched the terrain
+	bool ResolveBody(int body, float dt);
+
+	// the same for hull contact
+	bool ResolveHull(int body, float dt);
+
+	// find the points where a body's hull meets the terrain triangles under it
+	void FindHullContacts(int body, const Cartesian3 &position, ContactManifold &manifold);
+
+	// the normal of a contact at an edge or corner of a terrain triangle, kept
+	// between the normals of the faces that meet there; false if the faces
+	// either side are level or form a valley, when the edge would only push the
+	// body sideways and the contact is taken along the face's own normal instead
+	bool RidgeNormal(const Cartesian3 &faceNormal, const Cartesian3 &point, Cartesian3 &normal);
+
+	// the impulses at the points of a manifold that stop the body moving into
+	// the terrain, bounce it if it struck hard, and resist its sliding, and the
+	// velocities, for this step only, that push the points deeper than the slop
+	// back out of it
+	void SolveContacts(const ContactManifold &manifold, const Cartesian3 &position, float dt,
+		Cartesian3 &linearVelocity, Cartesian3 &angularVelocity, Cartesian3 &pushVelocity, Cartesian3 &pushSpin);
+	}; // class PhysicsWorld
+
+#endif
@@ -0,0 +1,141 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Replay.cpp
+//	------------------------
+//
+//	A recorded run: the random seed, the timestep,
+//	the keypresses with the frame they landed on,
+//	and a hash of the state after every frame
+//
+///////////////////////////////////////////////////
+
+#include <fstream>
+#include <cstring>
+
+#include "Replay.h"
+
+// the first four bytes of every replay file
+static const char replayMagic[4] = { 'R', 'P', 'L', 'Y' };
+// the version is bumped whenever the file or the simulation changes, since
+// a run recorded by another version won't reproduce its hashes
+static const unsigned int replayVersion = 4;
+
+// write an unsigned value as nBytes little-endian bytes
+static void WriteUnsigned(std::ofstream &outFile, unsigned long long value, int nBytes)
+	{ // WriteUnsigned()
+	for (int byte = 0; byte < nBytes; byte++)
+		outFile.put((char) ((value >> (8 * byte)) & 0xFF));
+	} // WriteUnsigned()
+
+// and read one back
+static unsigned long long ReadUnsigned(std::ifstream &inFile, int nBytes)
+	{ // ReadUnsigned()
+	unsigned long long value = 0;
+	for (int byte = 0; byte < nBytes; byte++)
+		value |= (unsigned long long) (unsigned char) inFile.get() << (8 * byte);
+	return value;
+	} // ReadUnsigned()
+
+// floats travel as their bit pattern
+static unsigned int FloatBits(float value)
+	{ // FloatBits()
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+	} // FloatBits()
+
+static float BitsFloat(unsigned int bits)
+	{ // BitsFloat()
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+	} // BitsFloat()
+
+// constructor
+ReplayLog::ReplayLog()
+	:
+	seed(0),
+	fixedTimeStep(1.0 / 120.0),
+	stepsPerFrame(5),
+	craterSpeed(0.0),
+	craterRadius(0.0),
+	craterDepth(0.0)
+	{ // constructor
+	} // constructor
+
+// forget the events and hashes, keeping the settings
+void ReplayLog::Clear()
+	{ // Clear()
+	events.clear();
+	frameHashes.clear();
+	} // Clear()
+
+// write to a binary replay file
+bool ReplayLog::WriteFile(const char *fileName) const
+	{ // WriteFile()
+	std::ofstream outFile(fileName, std::ios::binary);
+	if (!outFile.good())
+		return false;
+
+	outFile.write(replayMagic, 4);
+	WriteUnsigned(outFile, replayVersion, 4);
+	WriteUnsigned(outFile, seed, 4);
+	WriteUnsigned(outFile, FloatBits(fixedTimeStep), 4);
+	WriteUnsigned(outFile, stepsPerFrame, 4);
+	WriteUnsigned(outFile, FloatBits(craterSpeed), 4);
+	WriteUnsigned(outFile, FloatBits(craterRadius), 4);
+	WriteUnsigned(outFile, FloatBits(craterDepth), 4);
+
+	WriteUnsigned(outFile, events.size(), 4);
+	for (const ReplayEvent &event : events)
+		{ // per event
+		WriteUnsigned(outFile, event.frame, 4);
+		outFile.put(event.key);
+		} // per event
+
+	WriteUnsigned(outFile, frameHashes.size(), 4);
+	for (unsigned long long hash : frameHashes)
+		WriteUnsigned(outFile, hash, 8);
+
+	return outFile.good();
+	} // WriteFile()
+
+// read from a binary replay file
+bool ReplayLog::ReadFile(const char *fileName)
+	{ // ReadFile()
+	std::ifstream inFile(fileName, std::ios::binary);
+	if (!inFile.good())
+		return false;
+
+	char magic[4];
+	inFile.read(magic, 4);
+	if (!inFile.good() || memcmp(magic, replayMagic, 4) != 0)
+		return false;
+	if (ReadUnsigned(inFile, 4) != replayVersion)
+		return false;
+
+	seed = (unsigned int) ReadUnsigned(inFile, 4);
+	fixedTimeStep = BitsFloat((unsigned int) ReadUnsigned(inFile, 4));
+	stepsPerFrame = (unsigned int) ReadUnsigned(inFile, 4);
+	craterSpeed = BitsFloat((unsigned int) ReadUnsigned(inFile, 4));
+	craterRadius = BitsFloat((unsigned int) ReadUnsigned(inFile, 4));
+	craterDepth = BitsFloat((unsigned int) ReadUnsigned(inFile, 4));
+
+	Clear();
+	unsigned int nEvents = (unsigned int) ReadUnsigned(inFile, 4);
+	for (unsigned int eventNumber = 0; eventNumber < nEvents && inFile.good(); eventNumber++)
+		{ // per event
+		ReplayEvent event;
+		event.frame = (unsigned int) ReadUnsigned(inFile, 4);
+		event.key = (char) inFile.get();
+		events.push_back(event);
+		} // per event
+
+	unsigned int nFrames = (unsigned int) ReadUnsigned(inFile, 4);
+	for (unsigned int frame = 0; frame < nFrames && inFile.good(); frame++)
+		frameHashes.push_back(ReadUnsigned(inFile, 8));
+
+	// a truncated file is no use for checking
+	return inFile.good();
+	} // ReadFile()
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Replay.h
+//	------------------------
+//
+//	A recorded run: the random seed, the timestep,
+//	the keypresses with the frame they landed on,
+//	and a hash of the state after every frame
+//
+///////////////////////////////////////////////////
+
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <vector>
+#include <cstddef>
+
+// 64-bit FNV-1a, used to hash simulation state
+const unsigned long long FNVOffsetBasis = 14695981039346656037ULL;
+const unsigned long long FNVPrime = 1099511628211ULL;
+
+// fold a block of bytes into a running FNV-1a hash
+inline unsigned long long HashBytes(unsigned long long hash, const void *data, std::size_t nBytes)
+	{ // HashBytes()
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	for (std::size_t byte = 0; byte < nBytes; byte++)
+		{ // per byte
+		hash ^= bytes[byte];
+		hash *= FNVPrime;
+		} // per byte
+	return hash;
+	} // HashBytes()
+
+// a keypress, applied just before the given frame is updated
+struct ReplayEvent
+	{ // struct ReplayEvent
+	unsigned int frame;
+	char key;
+	}; // struct ReplayEvent
+
+class ReplayLog
+	{ // class ReplayLog
+	public:
+	// seed for the scene's random number generator
+	unsigned int seed;
+
+	// physics timestep, and the number of steps per rendered frame
+	float fixedTimeStep;
+	unsigned int stepsPerFrame;
+
+	// the speed above which balls dig craters, and their size (see PhysicsWorld)
+	float craterSpeed, craterRadius, craterDepth;
+
+	// keypresses in the order they happened
+	std::vector<ReplayEvent> events;
+
+	// hash of the scene after each frame
+	std::vector<unsigned long long> frameHashes;
+
+	// constructor
+	ReplayLog();
+
+	// forget the events and hashes, keeping the settings
+	void Clear();
+
+	// write to or read from a binary replay file, returning false on failure
+	// the file is little-endian: "RPLY", version, seed, timestep, steps per frame,
+	// the crater speed, radius and depth, then the event count and (frame, key)
+	// pairs, then the frame count and hashes.  Files of other versions are refused
+	bool WriteFile(const char *fileName) const;
+	bool ReadFile(const char *fileName);
+	}; // class ReplayLog
+
+#endif
@@ -22,8 +22,14 @@
 const char* flatLandModelName		= "./models/flatland.dem";
 const char* stripeLandModelName	= "./models/stripeland.dem";
 const char* rollingLandModelName	= "./models/rollingland.dem";
+// binary versions made by dem_convert, used instead when present
+const char* flatLandBinaryName		= "./models/flatland.bdem";
+const char* stripeLandBinaryName	= "./models/stripeland.bdem";
+const char* rollingLandBinaryName	= "./models/rollingland.bdem";
 const char* sphereModelName		= "./models/spheroid.face";
 const char* dodecahedronModelName	= "./models/dodecahedron.face";
+const char* sphereBinaryName		= "./models/spheroid.bface";
+const char* dodecahedronBinaryName	= "./models/dodecahedron.bface";
 
 // four type of character's animation
 const char* motionBvhStand		= "./models/stand.bvh";
@@ -45,30 +51,46 @@ const GLfloat sunAmbient[4] = {0.1, 0.1, 0.1, 1.0 };
 const GLfloat sunDiffuse[4] = {0.7, 0.7, 0.7, 1.0 };
 const GLfloat blackColour[4] = {0.0, 0.0, 0.0, 1.0};
 
-const float elasticityCoeff = 0.6;
 int collisionCount = 0;
 float momentofInertia = (39.0 * ((1.0 + sqrt(5.0)) / 2) + 28) / 150;
 const float frictionCoeff = 0.1;
-const float minVelocity = 0.01;
-const float minAngularVelocity = 0.001;
-
-auto previoustime = std::chrono::system_clock::now();
 
+// load a terrain from its binary file if there is one, or else from the text file
+static void LoadTerrain(Terrain &terrain, const char *binaryName, const char *textName, JobSystem *jobSystem)
+	{ // LoadTerrain()
+	// the mesh is built across the pool, now or when first drawn
+	terrain.jobSystem = jobSystem;
+	if (!terrain.ReadFileBinaryTerrain(binaryName))
+		terrain.ReadFileTerrainData(textName, 3);
+	} // LoadTerrain()
+
+// load a mesh from its binary file if there is one, or else from the text file
+static void LoadMesh(IndexedFaceSurface &mesh, const char *binaryName, const char *textName)
+	{ // LoadMesh()
+	if (!mesh.ReadFileBinaryMesh(binaryName))
+		mesh.ReadFileIndexedFace(textName);
+	} // LoadMesh()
 
 // constructor
 SceneModel::SceneModel()
     { // constructor
 
     // load landscape models from files
-    flatLandModel.ReadFileTerrainData(flatLandModelName, 3);
-    stripeLandModel.ReadFileTerrainData(stripeLandModelName, 3);
-    rollingLandModel.ReadFileTerrainData(rollingLandModelName, 3);
+    LoadTerrain(flatLandModel, flatLandBinaryName, flatLandModelName, &jobSystem);
+    LoadTerrain(stripeLandModel, stripeLandBinaryName, stripeLandModelName, &jobSystem);
+    LoadTerrain(rollingLandModel, rollingLandBinaryName, rollingLandModelName, &jobSystem);
 
 	standSkeletonModel.ReadFileBVH(motionBvhStand);
 	runSkeletonModel.ReadFileBVH(motionBvhRun);
 
-	sphereModel.ReadFileIndexedFace(sphereModelName);
-	dodecahedronModel.ReadFileIndexedFace(dodecahedronModelName);
+	LoadMesh(sphereModel, sphereBinaryName, sphereModelName);
+	LoadMesh(dodecahedronModel, dodecahedronBinaryName, dodecahedronModelName);
+
+	// coarser copies of the balls for drawing at a distance, kept under a
+	// budget of triangles for all the balls together
+	sphereLODs.Build(sphereModel);
+	dodecahedronLODs.Build(dodecahedronModel);
+	sphereLODs.triangleBudget = dodecahedronLODs.triangleBudget = 2000000;
 
 	// set the reference for the terrain model to use
     // this->activeLandModel = &flatLandModel;
@@ -76,6 +98,7 @@ SceneModel::SceneModel()
 	this->activeSkeletonModel = &standSkeletonModel;
 	this->activeModel = &dodecahedronModel;
 	// this->activeModel = &sphereModel;
+	this->activeLODs = &dodecahedronLODs;
 
 	characterOrientation = lookingAhead;
 	isRunning = false;
@@ -86,14 +109,19 @@ SceneModel::SceneModel()
 	interpFramePoint = 0;
 	isStopping = false;
 
-	// initiallising the models vector to store the ball information
-	Models model;
-		model.creationFrame = 0;
-		model.position = Cartesian3(10.0, 0.0, 10.0);
-		model.linearVelocity = Cartesian3(0.0, 0.0, 0.0);
-		model.angularVelocity = Cartesian3(0.5, 0.0, 0.0);
-		model.orientationR = Matrix4::Identity();
-	models.push_back(model);
+	// point the simulation at the active models
+	physicsWorld.terrain = activeLandModel;
+	physicsWorld.SetBodyModel(activeModel);
+	// the sphere rolls as a ball, the dodecahedron lands on its faces
+	physicsWorld.bodyContact = PhysicsWorld::HullContact;
+	physicsWorld.ballRadius = ballRadius;
+	physicsWorld.jobSystem = &jobSystem;
+	// balls dropped from the top of the range dent the ground where they land
+	physicsWorld.craterSpeed = 15.0;
+
+	// one more than the limit, as the oldest is retired after a new one spawns
+	maxBallCount = 4;
+	physicsWorld.SetCapacity(maxBallCount + 1);
 	
 	// set the initial view matrix
 	viewMatrix = Matrix4::Translate(Cartesian3(0.0, 15.0, -10.0));
@@ -102,7 +130,16 @@ SceneModel::SceneModel()
 	frameNumber = 0;
 
 	// set initial time
-	previoustime = std::chrono::system_clock::now();
+	previousTime = std::chrono::steady_clock::now();
+
+	// follow the wall clock until asked to record or replay
+	deterministic = false;
+	stepsPerFrame = (int) (frameTime / physicsWorld.fixedTimeStep + 0.5);
+	recording = false;
+	replaying = false;
+	replayFrame = 0;
+	nextReplayEvent = 0;
+	replayMismatches = 0;
 		
 	// call the reset routine to initialise the ball position
 	ResetPhysics();
@@ -111,11 +148,98 @@ SceneModel::SceneModel()
 // routine that updates the scene for the next frame
 void SceneModel::Update()
 	{ // Update()
+		// in a replay, apply the keypresses that landed before this frame
+		if (replaying)
+			while (nextReplayEvent < replayLog.events.size() && replayLog.events[nextReplayEvent].frame <= replayFrame)
+				ApplyKey(replayLog.events[nextReplayEvent++].key);
+
 		// increment the frame number
 		frameNumber++;
 		// if we are interpolating
 		interpFrameNumber++;
-	} // Update()`
+
+		// retire the oldest ball once there are too many
+		if ((int) liveBalls.size() > maxBallCount)
+		{
+			physicsWorld.RemoveBody(liveBalls.front());
+			liveBalls.pop_front();
+		}
+
+		// every second make a new ball
+		if (frameNumber % 24 == 0 && frameNumber > 0)
+		{
+			// random position in x -20 to 20 and z 10 to 20
+			// (taken straight from the generator, as the distributions differ between libraries)
+			float x = (float) (random() % 40) - 20;
+			float z = (float) (random() % 10) + 10;
+
+			BodyHandle ball = physicsWorld.AddBody(frameNumber, Cartesian3(x, 0.0, z), Cartesian3(0.1, 0.0, 0.0));
+			if (ball.IsValid())
+				liveBalls.push_back(ball);
+		}
+
+		// a streamed terrain keeps the area around the character in memory too
+		physicsWorld.viewPoints.assign(1, Cartesian3(characterXPosition, 0.0, 0.0));
+
+		if (deterministic)
+		{
+			// a fixed amount of simulated time per frame
+			physicsWorld.Step(stepsPerFrame);
+		}
+		else
+		{
+			// run as many fixed physics steps as the elapsed time covers
+			auto currentTime = std::chrono::steady_clock::now();
+			float elapsed = std::chrono::duration<float>(currentTime - previousTime).count();
+			previousTime = currentTime;
+			physicsWorld.Advance(elapsed);
+		}
+
+		UpdateCharacter();
+
+		// record or check the state at the end of the frame
+		if (recording)
+			replayLog.frameHashes.push_back(FrameHash());
+		else if (replaying && replayFrame < replayLog.frameHashes.size() && FrameHash() != replayLog.frameHashes[replayFrame])
+		{
+			if (replayMismatches == 0)
+				std::cout << "Replay diverged at frame " << replayFrame << std::endl;
+			replayMismatches++;
+		}
+		replayFrame++;
+	} // Update()
+
+// move the character for the frame
+void SceneModel::UpdateCharacter()
+{ // UpdateCharacter()
+	if (characterOrientation == lookingAhead && isRunning)
+	{
+		characterXPosition += characterSpeed;
+	}
+	else if (characterOrientation == lookingBehind && isRunning)
+	{
+		characterXPosition -= characterSpeed;
+	}
+
+	if (interpFrameNumber <= 5 && isRunning)
+	{
+		// speeding up while blending into the running pose, which starts at frame 0
+		characterSpeed += 0.02;
+		frameNumber = 0;
+	}
+	else if (interpFrameNumber <= 10 && isStopping)
+	{
+		// blending back to the standing pose
+	}
+	else if (isRunning)
+	{
+		// speed slowly increases to 0.4
+		if (characterSpeed < 0.4)
+			characterSpeed += 0.05;
+		else
+			characterSpeed = 0.4;
+	}
+} // UpdateCharacter()
 
 // routine to tell the scene to render itself
 void SceneModel::Render()
@@ -173,26 +297,16 @@ void SceneModel::Render()
 	glMaterialfv(GL_FRONT, GL_EMISSION, blackColour);
 
 
-	if (characterOrientation == lookingAhead && isRunning)
-	{
-		characterXPosition += characterSpeed;
-	}
-	else if (characterOrientation == lookingBehind && isRunning)
-	{
-		characterXPosition -= characterSpeed;
-	}
-
 	float characterZPosition = activeLandModel->getHeight(characterXPosition, 0.0);
 	glTranslatef(characterXPosition, 0.0, characterZPosition);
 	glRotatef(characterOrientation, 0.0, 0.0, 1.0);
 	glScalef(0.025f, 0.025f, 0.025f);
 
+	// the character was moved in Update(), so this only poses it
 	if (interpFrameNumber <= 5 && isRunning)
 	{
 		// interpolate to the characters running pose at frame = 0;
-		characterSpeed += 0.02;
 		activeSkeletonModel->InterpolateToRun(standSkeletonModel, runSkeletonModel, interpFrameNumber);
-		frameNumber = 0;
 	}
 	else if (interpFrameNumber <= 10 && isStopping )
 	{
@@ -200,14 +314,6 @@ void SceneModel::Render()
 	}
 	else
 	{
-		if (isRunning)
-		{
-			// speed slowly increases to 0.4
-			if (characterSpeed < 0.4)
-				characterSpeed += 0.05;
-			else
-				characterSpeed = 0.4;
-		}
 		// render the character
 		activeSkeletonModel->Render(frameNumber%16);
 	}
@@ -215,102 +321,21 @@ void SceneModel::Render()
 
 	glPopMatrix();
 
-	int maxBallCount = 4;
-	if (this->models.size() > maxBallCount)
-	{
-		// delete the first ball
-		this->models.erase(this->models.begin());
-	}
+	// draw the balls, interpolated between the last two physics steps
+	float alpha = physicsWorld.InterpolationAlpha();
+	ballCentres.resize(physicsWorld.bodies.Size());
+	for (int body = 0; body < physicsWorld.bodies.Size(); body++)
+		ballCentres[body] = physicsWorld.InterpolatedPosition(body, alpha);
 
+	// each at the coarsest level that looks the same from here
+	Cartesian3 eye;
+	float pixelScale;
+	MeshLODChain::ViewFromGL(eye, pixelScale);
+	activeLODs->SelectLevels(eye, pixelScale, ballCentres.data(), (int) ballCentres.size(), ballLevels);
 
-	// every 5 seconds make a new ball
-	if (frameNumber % 24 == 0 && frameNumber > 0)
+	for (int body = 0; body < physicsWorld.bodies.Size(); body++)
 	{
-		// random position in x -20 to 20 and z 10 to 20
-		float x = (rand() % 40) - 20;
-		float z = (rand() % 10) + 10;
-
-		Models model;
-		model.creationFrame = frameNumber;
-		model.position = Cartesian3(x, 0.0, z);
-		model.linearVelocity = Cartesian3(0.0, 0.0, 0.0);
-		model.angularVelocity = Cartesian3(0.1, 0.0, 0.0);
-		model.orientationR = Matrix4::Identity();
-		this->models.push_back(model);
-	}
-
-	// flag to check if there is a collision
-	// set before all the models
-	// as it should be flagged if ANY of the balls
-	// collide with the character
-	bool collision = false;
-
-	auto currentTime = std::chrono::system_clock::now();
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - previoustime);
-	auto delT = duration.count() / 1000.0;
-	previoustime = currentTime;
-
-	int gravity_scale_up = 3;
-
-	for (auto& model : this->models)
-	{
-		// calculate velocity of the ball
-		// v = u + at
-		// model.linearVelocity = model.linearVelocity + gravity * delT;
-		// gravity is scaled up for better effect
-		model.linearVelocity = model.linearVelocity + gravity * gravity_scale_up * delT;
-
-		// calculate position of the ball
-		// x = x + vt
-		model.position = model.position + model.linearVelocity * delT;
-
-		float planeHeight = activeLandModel->getHeight(model.position.x, model.position.y);
-
-		// collision detection with the terrain
-		if (model.position.z <= planeHeight + ballRadius && fabs(model.linearVelocity.z) > minVelocity)
-		{
-			model.position.z = planeHeight + ballRadius;
-
-			// calculate the normal of the terrain
-			Cartesian3 normal = activeLandModel->getNormal(model.position.x, model.position.y);
-			normal = normal.unit();
-
-			float VdotN = model.linearVelocity.dot(normal);
-			auto impulse = -(1 + elasticityCoeff) * VdotN;
-			auto J = impulse * normal * 1.15;
-
-			auto collisionVertex = findCollisionVertex(model);
-			auto r = collisionVertex - model.position;
-			auto torque = r.cross(J);
-
-			model.linearVelocity = model.linearVelocity + J; // mass is assumed to be 1
-			model.angularVelocity = model.angularVelocity + torque*delT; // mass is assumed to be 1
-
-			// special case if the ball is stuck in the terrain
-			if (model.position.z + model.linearVelocity.z <= planeHeight + ballRadius)
-			{
-				model.linearVelocity = Cartesian3(0, 0, 0);
-				model.angularVelocity = Cartesian3(0, 0, 0);
-			}
-		}
-
-		// calculate orientation/rotation of the ball from angular velocity
-		if (model.angularVelocity.length() > minAngularVelocity)
-		{
-			auto halfTheta = model.angularVelocity.length() / 2;
-			if (halfTheta > 0.2)
-				halfTheta = 0.2;
-
-			model.angularVelocity = model.angularVelocity.unit();
-			auto w = cos(halfTheta);
-			auto x = model.angularVelocity.x * sin(halfTheta);
-			auto y = model.angularVelocity.y * sin(halfTheta);
-			auto z = model.angularVelocity.z * sin(halfTheta);
-
-			Quaternion rotationQuaternion = Quaternion(x, y, z, w);
-			auto rotationMatrix = rotationQuaternion.Unit().GetMatrix();
-			model.orientationR = rotationMatrix * model.orientationR;
-		}
+		Cartesian3 position = ballCentres[body];
 
 		glPushMatrix();
 
@@ -318,63 +343,147 @@ void SceneModel::Render()
 		glMaterialfv(GL_FRONT, GL_SPECULAR, blackColour);
 		glMaterialfv(GL_FRONT, GL_EMISSION, blackColour);
 
-		glTranslatef(model.position.x, model.position.y, model.position.z);
-		glMultMatrixf(model.orientationR.columnMajor().coordinates);
+		glTranslatef(position.x, position.y, position.z);
+		glMultMatrixf(physicsWorld.bodies.OrientationMatrix(body).columnMajor().coordinates);
 
-		activeModel->Render();
+		activeLODs->Render(ballLevels[body]);
 
 		glPopMatrix();
+	}
 
-
-
-		// test collision between the ball and the character
-		// horizontal collision
-		float dx = model.position.x - characterXPosition;
-		float dy = model.position.y - 0.0; // the character is always at y = 0
-		float distance = sqrt(dx * dx + dy * dy);
-		bool horizontalOverlap = distance <= ballRadius + characterWidth + 0.4; // 0.4 to account for the movement of the character per frame
-
-		// vertical collision
-		float characterBottom = characterZPosition; // because the feet are placed at the terrainheight
-		float characterTop = characterZPosition + characterHeight;
-		bool verticalOverlap = model.position.z + ballRadius >= characterBottom && model.position.z - ballRadius <= characterTop;
-
-		if (horizontalOverlap && verticalOverlap)
-		{
-			collision = true;
-			collisionCount++;
-			std::cout << "Collision: " << collisionCount << std::endl;
-		}
+	// test collision between the balls and the character
+	// the character is always at y = 0, and its feet are placed at the terrain height
+	// 0.4 is added to the width to account for the movement of the character per frame
+	int overlaps = physicsWorld.CountCylinderOverlaps(characterXPosition, 0.0, characterZPosition, characterZPosition + characterHeight, characterWidth + 0.4);
+	for (int overlap = 0; overlap < overlaps; overlap++)
+	{
+		collisionCount++;
+		std::cout << "Collision: " << collisionCount << std::endl;
 	}
+	bool collision = overlaps > 0;
+
 	// collision with any ball recolors the character
 	activeCharacterColour = collision ? characterCollisionColour : characterColour;
 
 } // Render()
 
 
-Cartesian3 SceneModel::findCollisionVertex(Models model)
-{
-	Cartesian3 collisionVertex = Cartesian3(0.0, 0.0, 0.0);
-	float smallestDistance = 1000000.0;
-
-	for ( auto i = 0; i < activeModel->vertices.size(); ++i)
-    {
-		// convert the vertex position to world coordinates
-		auto vertex = model.orientationR * activeModel->vertices[i] + model.position;
-		float landHeight = activeLandModel->getHeight(model.position.x, model.position.y);
-		float distance = vertex.z - landHeight;
-
-		if (distance < smallestDistance)
-	    {
-	        smallestDistance = distance;
-	        collisionVertex = vertex;
-	    }
-    }
-	return collisionVertex;
-}
-
-
+// a key from the interface, recorded if a recording is running
+void SceneModel::KeyPressed(char key)
+{ // KeyPressed()
+	// a replay plays back its own keys
+	if (replaying)
+		return;
 
+	// the key takes effect before the next frame, so that is the frame it is stamped with
+	if (recording)
+	{
+		ReplayEvent event;
+		event.frame = replayFrame;
+		event.key = key;
+		replayLog.events.push_back(event);
+	}
+	ApplyKey(key);
+} // KeyPressed()
+
+// and the action it triggers
+void SceneModel::ApplyKey(char key)
+{ // ApplyKey()
+	switch (key)
+	{ // key switch
+	case 'W':
+		EventCharacterForward();
+		break;
+	case 'S':
+		EventCharacterBackward();
+		break;
+	case ' ':
+		ResetGame();
+		break;
+	case 'L':
+		SwitchLand();
+		break;
+	case 'M':
+		SwitchModel();
+		break;
+	default:
+		break;
+	} // key switch
+} // ApplyKey()
+
+// switch to deterministic mode and record the run
+void SceneModel::StartRecording(const std::string &fileName, unsigned int seed)
+{ // StartRecording()
+	replayLog.Clear();
+	replayLog.seed = seed;
+	replayLog.fixedTimeStep = physicsWorld.fixedTimeStep;
+	replayLog.stepsPerFrame = stepsPerFrame;
+	replayLog.craterSpeed = physicsWorld.craterSpeed;
+	replayLog.craterRadius = physicsWorld.craterRadius;
+	replayLog.craterDepth = physicsWorld.craterDepth;
+	replayFileName = fileName;
+
+	random.seed(seed);
+	deterministic = true;
+	recording = true;
+} // StartRecording()
+
+// write out the recording
+bool SceneModel::StopRecording()
+{ // StopRecording()
+	if (!recording)
+		return true;
+	recording = false;
+
+	if (!replayLog.WriteFile(replayFileName.c_str()))
+	{
+		std::cout << "Unable to write replay " << replayFileName << std::endl;
+		return false;
+	}
+	std::cout << "Recorded " << replayLog.frameHashes.size() << " frames and " << replayLog.events.size() << " keypresses to " << replayFileName << std::endl;
+	return true;
+} // StopRecording()
+
+// load a recording and play it back
+bool SceneModel::StartReplay(const std::string &fileName)
+{ // StartReplay()
+	if (!replayLog.ReadFile(fileName.c_str()))
+	{
+		std::cout << "Unable to read replay " << fileName << std::endl;
+		return false;
+	}
+	replayFileName = fileName;
+
+	random.seed(replayLog.seed);
+	physicsWorld.fixedTimeStep = replayLog.fixedTimeStep;
+	stepsPerFrame = replayLog.stepsPerFrame;
+	physicsWorld.craterSpeed = replayLog.craterSpeed;
+	physicsWorld.craterRadius = replayLog.craterRadius;
+	physicsWorld.craterDepth = replayLog.craterDepth;
+	deterministic = true;
+	replaying = true;
+	nextReplayEvent = 0;
+	replayMismatches = 0;
+	return true;
+} // StartReplay()
+
+// true once every recorded frame has been replayed
+bool SceneModel::ReplayFinished() const
+{ // ReplayFinished()
+	return replaying && replayFrame >= replayLog.frameHashes.size();
+} // ReplayFinished()
+
+// hash of the scene state after the last frame
+unsigned long long SceneModel::FrameHash() const
+{ // FrameHash()
+	unsigned long long hash = physicsWorld.StateHash();
+	hash = HashBytes(hash, &frameNumber, sizeof(frameNumber));
+	hash = HashBytes(hash, &interpFrameNumber, sizeof(interpFrameNumber));
+	hash = HashBytes(hash, &characterXPosition, sizeof(characterXPosition));
+	hash = HashBytes(hash, &characterSpeed, sizeof(characterSpeed));
+	hash = HashBytes(hash, &characterOrientation, sizeof(characterOrientation));
+	return hash;
+} // FrameHash()
 
 // character control events: W for forward
 void SceneModel::EventCharacterForward()
@@ -425,14 +534,9 @@ void SceneModel::ResetPhysics()
 	collisionCount = 0;
 	// reset the ball position
 
-	models.clear();
-	Models model;
-		model.creationFrame = frameNumber;
-		model.position = Cartesian3(10.0, 0.0, 10.0);
-		model.linearVelocity = Cartesian3(0.0, 0.0, 0.0);
-		model.angularVelocity = Cartesian3(0.0, 0.0, 0.0);
-		model.orientationR = Matrix4::Identity();
-	models.push_back(model);
+	physicsWorld.Clear();
+	liveBalls.clear();
+	liveBalls.push_back(physicsWorld.AddBody(frameNumber, Cartesian3(10.0, 0.0, 10.0), Cartesian3(0.0, 0.0, 0.0)));
 
 } // ResetPhysics()
 	
@@ -446,6 +550,7 @@ void SceneModel::SwitchLand()
 		activeLandModel = &rollingLandModel;
 	else if (activeLandModel == &rollingLandModel)
 		activeLandModel = &flatLandModel;
+	physicsWorld.SetTerrain(activeLandModel);
 
 	ResetPhysics();
 } // SwitchLand()
@@ -457,6 +562,9 @@ void SceneModel::SwitchModel()
 		activeModel = &dodecahedronModel;
 	else if (activeModel == &dodecahedronModel)
         activeModel = &sphereModel;
+	activeLODs = activeModel == &sphereModel ? &sphereLODs : &dodecahedronLODs;
+	physicsWorld.SetBodyModel(activeModel);
+	physicsWorld.bodyContact = activeModel == &sphereModel ? PhysicsWorld::SphereContact : PhysicsWorld::HullContact;
 
 	// and reset the physics
 	ResetPhysics();
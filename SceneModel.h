@@ -27,20 +27,18 @@
 #endif
 
 #include "IndexedFaceSurface.h"
+#include "MeshLODChain.h"
 #include "Terrain.h"
 #include "Matrix4.h"
 #include "Quaternion.h"
 #include "BVHData.h"
+#include "PhysicsWorld.h"
+#include "Replay.h"
 
-// struct to hold one model
-struct Models
-{
-	int creationFrame;
-	Cartesian3 position;
-	Cartesian3 linearVelocity;
-	Cartesian3 angularVelocity;
-	Matrix4 orientationR;
-};
+#include <chrono>
+#include <deque>
+#include <random>
+#include <string>
 
 class SceneModel										
 	{ // class SceneModel
@@ -81,10 +79,52 @@ class SceneModel
 
 	IndexedFaceSurface *activeModel;
 
-	Cartesian3 const gravity = Cartesian3(0.0, 0.0, -9.8);
+	// the levels of detail each ball is drawn at, by its distance
+	MeshLODChain sphereLODs;
+	MeshLODChain dodecahedronLODs;
+	MeshLODChain *activeLODs;
+
+	// scratch for the centres of the balls and their chosen levels
+	std::vector<Cartesian3> ballCentres;
+	std::vector<int> ballLevels;
+
 	const float ballRadius = 1.0;
 
-	std::vector<Models> models;
+	// thread pool shared by the simulation
+	JobSystem jobSystem;
+
+	// the ball simulation, stepped at a fixed timestep
+	PhysicsWorld physicsWorld;
+
+	// the most balls alive at once
+	int maxBallCount;
+
+	// the live balls, oldest first, so the oldest can be retired
+	std::deque<BodyHandle> liveBalls;
+
+	// wall-clock time of the last physics update
+	std::chrono::steady_clock::time_point previousTime;
+
+	// random numbers for spawning balls, seeded so that runs can be repeated
+	std::mt19937 random;
+
+	// in deterministic mode each frame runs a fixed number of physics steps
+	// instead of following the wall clock
+	bool deterministic;
+	int stepsPerFrame;
+
+	// the run being recorded or replayed
+	ReplayLog replayLog;
+	bool recording;
+	bool replaying;
+	std::string replayFileName;
+
+	// frames updated since the start of the run, which stamps the keypresses
+	unsigned int replayFrame;
+
+	// next keypress to apply during a replay, and frames whose hash didn't match
+	unsigned int nextReplayEvent;
+	unsigned int replayMismatches;
 
 	// the view matrix - updated by the interface code
 	Matrix4 viewMatrix;
@@ -101,6 +141,33 @@ class SceneModel
 	// routine to tell the scene to render itself
 	void Render();
 
+	// move the character for the frame
+	void UpdateCharacter();
+
+	// a key from the interface: W, S, space, L or M
+	// recorded if a recording is running, ignored during a replay
+	void KeyPressed(char key);
+
+	// and the action it triggers
+	void ApplyKey(char key);
+
+	// switch to deterministic mode and record the run, to be written out by
+	// StopRecording(); call before the first Update()
+	void StartRecording(const std::string &fileName, unsigned int seed);
+
+	// write out the recording, returning false if it couldn't be written
+	bool StopRecording();
+
+	// load a recording and play it back in deterministic mode, checking the
+	// state after every frame; call before the first Update()
+	bool StartReplay(const std::string &fileName);
+
+	// true once every recorded frame has been replayed
+	bool ReplayFinished() const;
+
+	// hash of the scene state after the last frame
+	unsigned long long FrameHash() const;
+
 	// character control events: WASD
 	void EventCharacterForward();
 	void EventCharacterBackward();
@@ -123,8 +190,6 @@ class SceneModel
 	// and to rotate to right
 	void RotateLaunchRight();
 
-	Cartesian3 findCollisionVertex(Models model);
-
 	}; // class SceneModel
 
 #endif
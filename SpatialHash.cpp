@@ -0,0 +1,264 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	SpatialHash.cpp
+//	------------------------
+//
+//	Uniform-grid spatial hashes used as the broadphase
+//	for ball-ball collisions
+//
+///////////////////////////////////////////////////
+
+#include <math.h>
+#include <cstdlib>
+#include <algorithm>
+
+#include "SpatialHash.h"
+
+// bodies handed to each pair-finding job
+const int bodiesPerPairJob = 1024;
+
+// constructor
+SpatialHash::SpatialHash()
+	:
+	cellSize(1.0),
+	tableSize(0)
+	{ // constructor
+	} // constructor
+
+// hash a cell to one of tableSize buckets
+static unsigned int HashCell(int x, int y, int z, int tableSize)
+	{ // HashCell()
+	// the usual large-prime spatial hash
+	unsigned int hash = ((unsigned int) x * 73856093u) ^ ((unsigned int) y * 19349663u) ^ ((unsigned int) z * 83492791u);
+	return hash & (unsigned int) (tableSize - 1);
+	} // HashCell()
+
+// hash a cell to a bucket
+unsigned int SpatialHash::Bucket(int x, int y, int z) const
+	{ // Bucket()
+	return HashCell(x, y, z, tableSize);
+	} // Bucket()
+
+// rebuild the hash from scratch for count bodies at (x, y, z)
+void SpatialHash::Build(const float *x, const float *y, const float *z, int count, float CellSize)
+	{ // Build()
+	cellSize = CellSize;
+
+	// about two buckets per body keeps the chains short
+	tableSize = 1;
+	while (tableSize < 2 * count)
+		tableSize *= 2;
+
+	cellX.resize(count);
+	cellY.resize(count);
+	cellZ.resize(count);
+	bodyBucket.resize(count);
+	sortedBodies.resize(count);
+	bucketStart.assign(tableSize + 1, 0);
+
+	// find the cell and bucket of each body, counting bodies per bucket
+	float inverseCellSize = 1.0 / cellSize;
+	for (int body = 0; body < count; body++)
+		{ // per body
+		cellX[body] = (int) floor(x[body] * inverseCellSize);
+		cellY[body] = (int) floor(y[body] * inverseCellSize);
+		cellZ[body] = (int) floor(z[body] * inverseCellSize);
+		bodyBucket[body] = Bucket(cellX[body], cellY[body], cellZ[body]);
+		bucketStart[bodyBucket[body] + 1]++;
+		} // per body
+
+	// prefix sum gives the start of each bucket
+	for (int bucket = 0; bucket < tableSize; bucket++)
+		bucketStart[bucket + 1] += bucketStart[bucket];
+
+	// and a counting sort places the bodies, keeping index order within a bucket
+	std::vector<int> fill(bucketStart.begin(), bucketStart.end() - 1);
+	for (int body = 0; body < count; body++)
+		sortedBodies[fill[bodyBucket[body]]++] = body;
+	} // Build()
+
+// emit every pair of bodies in the same or neighbouring cells
+void SpatialHash::FindPairs(std::vector<BodyPair> &pairs, JobSystem *jobSystem, int queryCount) const
+	{ // FindPairs()
+	pairs.clear();
+	int count = (int) cellX.size();
+	if (queryCount >= 0 && queryCount < count)
+		count = queryCount;
+
+	if (jobSystem == NULL || count <= bodiesPerPairJob)
+		{ // serial
+		FindPairsInRange(0, count, pairs);
+		return;
+		} // serial
+
+	// each chunk collects its own pairs, then they are joined in chunk order
+	int nChunks = (count + bodiesPerPairJob - 1) / bodiesPerPairJob;
+	std::vector<std::vector<BodyPair> > chunkPairs(nChunks);
+	jobSystem->ParallelFor(count, bodiesPerPairJob, [&](int begin, int end)
+		{ // per chunk
+		FindPairsInRange(begin, end, chunkPairs[begin / bodiesPerPairJob]);
+		}); // per chunk
+
+	for (auto& chunk : chunkPairs)
+		pairs.insert(pairs.end(), chunk.begin(), chunk.end());
+	} // FindPairs()
+
+// append the candidates for bodies [begin, end) to pairs
+void SpatialHash::FindPairsInRange(int begin, int end, std::vector<BodyPair> &pairs) const
+	{ // FindPairsInRange()
+	unsigned int buckets[27];
+
+	for (int body = begin; body < end; body++)
+		{ // per body
+		// collect the buckets of the 27 neighbouring cells
+		int nBuckets = 0;
+		for (int dz = -1; dz <= 1; dz++)
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dx = -1; dx <= 1; dx++)
+					buckets[nBuckets++] = Bucket(cellX[body] + dx, cellY[body] + dy, cellZ[body] + dz);
+
+		// neighbouring cells may share a bucket, so visit each bucket once
+		std::sort(buckets, buckets + nBuckets);
+		nBuckets = (int) (std::unique(buckets, buckets + nBuckets) - buckets);
+
+		for (int bucket = 0; bucket < nBuckets; bucket++)
+			for (int slot = bucketStart[buckets[bucket]]; slot < bucketStart[buckets[bucket] + 1]; slot++)
+				{ // per other body
+				int other = sortedBodies[slot];
+				// each pair once
+				if (other <= body)
+					continue;
+				// the bucket may also hold far away cells that hash the same
+				if (abs(cellX[other] - cellX[body]) > 1 || abs(cellY[other] - cellY[body]) > 1 || abs(cellZ[other] - cellZ[body]) > 1)
+					continue;
+
+				BodyPair pair;
+				pair.first = body;
+				pair.second = other;
+				pairs.push_back(pair);
+				} // per other body
+		} // per body
+	} // FindPairsInRange()
+
+// constructor
+StaticSpatialHash::StaticSpatialHash()
+	:
+	cellSize(1.0),
+	tableSize(0)
+	{ // constructor
+	} // constructor
+
+// empty the hash and size it for the ids [0, idCount)
+void StaticSpatialHash::Reset(int idCount, float CellSize)
+	{ // Reset()
+	cellSize = CellSize;
+
+	// about two buckets per id, as in SpatialHash
+	tableSize = 1;
+	while (tableSize < 2 * idCount)
+		tableSize *= 2;
+
+	cellX.assign(idCount, 0);
+	cellY.assign(idCount, 0);
+	cellZ.assign(idCount, 0);
+	entryBucket.assign(idCount, -1);
+	previousEntry.assign(idCount, -1);
+	nextEntry.assign(idCount, -1);
+	bucketHead.assign(tableSize, -1);
+	} // Reset()
+
+// add an entry
+void StaticSpatialHash::Insert(int id, float x, float y, float z)
+	{ // Insert()
+	if (Contains(id))
+		Remove(id);
+
+	float inverseCellSize = 1.0 / cellSize;
+	cellX[id] = (int) floor(x * inverseCellSize);
+	cellY[id] = (int) floor(y * inverseCellSize);
+	cellZ[id] = (int) floor(z * inverseCellSize);
+	int bucket = (int) HashCell(cellX[id], cellY[id], cellZ[id], tableSize);
+
+	// at the head of its bucket's chain
+	entryBucket[id] = bucket;
+	previousEntry[id] = -1;
+	nextEntry[id] = bucketHead[bucket];
+	if (bucketHead[bucket] >= 0)
+		previousEntry[bucketHead[bucket]] = id;
+	bucketHead[bucket] = id;
+	} // Insert()
+
+// remove an entry
+void StaticSpatialHash::Remove(int id)
+	{ // Remove()
+	if (!Contains(id))
+		return;
+
+	if (previousEntry[id] >= 0)
+		nextEntry[previousEntry[id]] = nextEntry[id];
+	else
+		bucketHead[entryBucket[id]] = nextEntry[id];
+	if (nextEntry[id] >= 0)
+		previousEntry[nextEntry[id]] = previousEntry[id];
+	entryBucket[id] = previousEntry[id] = nextEntry[id] = -1;
+	} // Remove()
+
+// append the pairs between count bodies and the entries near them
+void StaticSpatialHash::AppendPairs(const float *x, const float *y, const float *z, int count, const int *idToIndex,
+	std::vector<BodyPair> &pairs, JobSystem *jobSystem) const
+	{ // AppendPairs()
+	if (jobSystem == NULL || count <= bodiesPerPairJob)
+		{ // serial
+		AppendPairsInRange(x, y, z, 0, count, idToIndex, pairs);
+		return;
+		} // serial
+
+	// each chunk collects its own pairs, then they are joined in chunk order
+	int nChunks = (count + bodiesPerPairJob - 1) / bodiesPerPairJob;
+	std::vector<std::vector<BodyPair> > chunkPairs(nChunks);
+	jobSystem->ParallelFor(count, bodiesPerPairJob, [&](int begin, int end)
+		{ // per chunk
+		AppendPairsInRange(x, y, z, begin, end, idToIndex, chunkPairs[begin / bodiesPerPairJob]);
+		}); // per chunk
+
+	for (auto& chunk : chunkPairs)
+		pairs.insert(pairs.end(), chunk.begin(), chunk.end());
+	} // AppendPairs()
+
+// the same for bodies [begin, end)
+void StaticSpatialHash::AppendPairsInRange(const float *x, const float *y, const float *z, int begin, int end, const int *idToIndex,
+	std::vector<BodyPair> &pairs) const
+	{ // AppendPairsInRange()
+	unsigned int buckets[27];
+	float inverseCellSize = 1.0 / cellSize;
+
+	for (int body = begin; body < end; body++)
+		{ // per body
+		int bodyX = (int) floor(x[body] * inverseCellSize);
+		int bodyY = (int) floor(y[body] * inverseCellSize);
+		int bodyZ = (int) floor(z[body] * inverseCellSize);
+
+		// the buckets of the 27 neighbouring cells, each visited once
+		int nBuckets = 0;
+		for (int dz = -1; dz <= 1; dz++)
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dx = -1; dx <= 1; dx++)
+					buckets[nBuckets++] = HashCell(bodyX + dx, bodyY + dy, bodyZ + dz, tableSize);
+		std::sort(buckets, buckets + nBuckets);
+		nBuckets = (int) (std::unique(buckets, buckets + nBuckets) - buckets);
+
+		for (int bucket = 0; bucket < nBuckets; bucket++)
+			for (int id = bucketHead[buckets[bucket]]; id >= 0; id = nextEntry[id])
+				{ // per entry
+				// the bucket may also hold far away cells that hash the same
+				if (abs(cellX[id] - bodyX) > 1 || abs(cellY[id] - bodyY) > 1 || abs(cellZ[id] - bodyZ) > 1)
+					continue;
+
+				BodyPair pair;
+				pair.first = body;
+				pair.second = idToIndex[id];
+				pairs.push_back(pair);
+				} // per entry
+		} // per body
+	} // AppendPairsInRange()
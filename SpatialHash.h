@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	SpatialHash.h
+//	------------------------
+//
+//	Uniform-grid spatial hashes used as the broadphase
+//	for ball-ball collisions
+//
+///////////////////////////////////////////////////
+
+#ifndef _SPATIAL_HASH_H
+#define _SPATIAL_HASH_H
+
+#include <vector>
+
+#include "JobSystem.h"
+
+// a candidate pair of bodies, with first < second
+struct BodyPair
+	{ // struct BodyPair
+	int first, second;
+	}; // struct BodyPair
+
+class SpatialHash
+	{ // class SpatialHash
+	public:
+	// edge length of a grid cell: at least the diameter of the largest body
+	// so that any overlapping pair lies in the same or neighbouring cells
+	float cellSize;
+
+	// number of hash buckets (a power of two)
+	int tableSize;
+
+	// integer cell coordinates of each body from the last build
+	std::vector<int> cellX, cellY, cellZ;
+
+	// bucket of each body
+	std::vector<unsigned int> bodyBucket;
+
+	// bodies sorted by bucket, with bucketStart[b] .. bucketStart[b+1] the range for bucket b
+	std::vector<int> sortedBodies;
+	std::vector<int> bucketStart;
+
+	// constructor
+	SpatialHash();
+
+	// rebuild the hash from scratch for count bodies at (x, y, z)
+	void Build(const float *x, const float *y, const float *z, int count, float CellSize);
+
+	// emit every pair of bodies in the same or neighbouring cells whose first
+	// body is below queryCount, in a deterministic order regardless of how many
+	// threads the job system has; a negative queryCount queries every body
+	void FindPairs(std::vector<BodyPair> &pairs, JobSystem *jobSystem = NULL, int queryCount = -1) const;
+
+	private:
+	// hash a cell to a bucket
+	unsigned int Bucket(int x, int y, int z) const;
+
+	// append the candidates for bodies [begin, end) to pairs
+	void FindPairsInRange(int begin, int end, std::vector<BodyPair> &pairs) const;
+	}; // class SpatialHash
+
+// a spatial hash over bodies that rarely move, such as the sleeping ones, which
+// is changed a body at a time instead of being rebuilt.  Entries are keyed by an
+// id that doesn't change as bodies move around in the arrays (a body's slot)
+class StaticSpatialHash
+	{ // class StaticSpatialHash
+	public:
+	// edge length of a grid cell, as in SpatialHash
+	float cellSize;
+
+	// number of hash buckets (a power of two)
+	int tableSize;
+
+	// integer cell coordinates of each entry
+	std::vector<int> cellX, cellY, cellZ;
+
+	// bucket of each entry, or -1 if the id is not in the hash
+	std::vector<int> entryBucket;
+
+	// each bucket is a doubly linked chain of entries, -1 ending it
+	std::vector<int> bucketHead;
+	std::vector<int> previousEntry, nextEntry;
+
+	// constructor
+	StaticSpatialHash();
+
+	// empty the hash and size it for the ids [0, idCount)
+	void Reset(int idCount, float CellSize);
+
+	// add or remove an entry
+	void Insert(int id, float x, float y, float z);
+	void Remove(int id);
+
+	// true if an id is in the hash
+	bool Contains(int id) const { return entryBucket[id] >= 0; }
+
+	// for count bodies at (x, y, z), append to pairs every body paired with each
+	// entry in the same or a neighbouring cell, the entry given as idToIndex[id];
+	// the order is the same on any number of threads
+	void AppendPairs(const float *x, const float *y, const float *z, int count, const int *idToIndex,
+		std::vector<BodyPair> &pairs, JobSystem *jobSystem = NULL) const;
+
+	private:
+	// the same for bodies [begin, end)
+	void AppendPairsInRange(const float *x, const float *y, const float *z, int begin, int end, const int *idToIndex,
+		std::vector<BodyPair> &pairs) const;
+	}; // class StaticSpatialHash
+
+#endif
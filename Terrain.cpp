@@ -19,15 +19,27 @@
 #include <iostream>
 #include <fstream>
 #include <numeric>
+#include <algorithm>
 #include <math.h>
+#include <cstring>
+#include <stdint.h>
+#include <atomic>
 
 #include "Terrain.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 // constructor will initialise to safe values
 Terrain::Terrain()
 	:  
 	IndexedFaceSurface(),
-	xyScale(1)
+	xyScale(1),
+	minHeight(0.0),
+	maxHeight(0.0),
+	faceNormals(NULL),
+	jobSystem(NULL)
 	{ // constructor
 	// terrain vector will default to empty
 	// so no additional work required here
@@ -35,7 +47,7 @@ Terrain::Terrain()
 
 // read routine returns true on success, failure otherwise
 // xyScale gives the scale factor to use in the x-y directions
-bool Terrain::ReadFileTerrainData(const char *fileName, float XYScale)
+bool Terrain::ReadFileTerrainData(const char *fileName, float XYScale, HeightGrid::Layout layout)
 	{ // ReadFileTerrainData()
 	// open a file stream
 	std::ifstream inFile(fileName);
@@ -51,21 +63,185 @@ bool Terrain::ReadFileTerrainData(const char *fileName, float XYScale)
 	// and read those values in
 	inFile >> height >> width;
 
-	// now allocate the memory and read in the data values
-	heightValues.resize(height);
+	// now allocate the memory and read in the data values, row-major as in the file
+	std::vector<float> rowMajor(height * width);
 
 	// the read / compute loop	
 	for (int row = 0; row < height; row++)
 		{ // per row
-		// allocate the row
-		heightValues[row].resize(width);
-
 		// loop along the row
 		for (int col = 0; col < width; col++)
 			// read in a value
-			inFile >> heightValues[row][col];
+			inFile >> rowMajor[row * width + col];
 		} // per row
+
+	// and store them in the layout used for lookups
+	heights.Assign(height, width, rowMajor, layout);
 	
+	// the text file has no range, so find it
+	minHeight = maxHeight = rowMajor.empty() ? 0.0 : rowMajor[0];
+	for (float sample : rowMajor)
+		{ // per sample
+		minHeight = std::min(minHeight, sample);
+		maxHeight = std::max(maxHeight, sample);
+		} // per sample
+	pyramid.Build(heights);
+	UpdateDerivatives(0, 0, height - 1, width - 1);
+	dirtyRects.clear();
+	editedRects.clear();
+
+	// build the mesh, and with it the normals
+	mappedFile.Close();
+	BuildMesh();
+	faceNormals = normals.data();
+
+	// return success
+	return true;
+	} // ReadFileTerrainData()
+
+static const char binaryTerrainMagic[4] = { 'B', 'D', 'E', 'M' };
+static const uint32_t binaryTerrainByteOrder = 0x01020304;
+static const uint32_t binaryTerrainVersion = 2;
+
+// squares along the edge of a block of the bounds table, which is small
+// enough to read whole when a terrain is paged from the file
+static const uint32_t binaryTerrainBoundsCell = 64;
+
+// round a file offset up to a cache line
+static uint64_t AlignOffset(uint64_t offset)
+	{ // AlignOffset()
+	return (offset + 63) & ~(uint64_t) 63;
+	} // AlignOffset()
+
+// check that a header is one we can read and that its blocks fit in the file
+bool CheckBinaryTerrainHeader(const BinaryTerrainHeader &header, uint64_t fileSize)
+	{ // CheckBinaryTerrainHeader()
+	return memcmp(header.magic, binaryTerrainMagic, 4) == 0 && header.byteOrder == binaryTerrainByteOrder
+		&& header.version == binaryTerrainVersion && header.layout <= HeightGrid::Morton
+		&& header.nRows >= 2 && header.nColumns >= 2
+		&& header.samplesOffset % 64 == 0 && header.samplesOffset + header.sampleCount * sizeof(float) <= fileSize
+		&& (!header.hasNormals || (header.normalsOffset % 4 == 0 && header.normalsOffset + header.normalCount * sizeof(Cartesian3) <= fileSize
+			&& header.normalCount == 2 * (uint64_t) (header.nRows - 1) * (header.nColumns - 1)))
+		&& header.boundsCellSize >= 1 && header.boundsOffset % 4 == 0 && header.boundsOffset + 2 * header.boundsCount * sizeof(float) <= fileSize
+		&& header.boundsCount == (uint64_t) ((header.nRows - 2) / header.boundsCellSize + 1) * ((header.nColumns - 2) / header.boundsCellSize + 1);
+	} // CheckBinaryTerrainHeader()
+
+// read a binary terrain by mapping it into memory
+bool Terrain::ReadFileBinaryTerrain(const char *fileName)
+	{ // ReadFileBinaryTerrain()
+	if (!mappedFile.Open(fileName))
+		return false;
+
+	// check the header before trusting any of it
+	const unsigned char *base = mappedFile.Data();
+	std::size_t fileSize = mappedFile.Size();
+	BinaryTerrainHeader header;
+	if (fileSize < sizeof(header))
+		{ mappedFile.Close(); return false; }
+	memcpy(&header, base, sizeof(header));
+	if (!CheckBinaryTerrainHeader(header, fileSize))
+		{ mappedFile.Close(); return false; }
+
+	// point the grid straight at the mapped samples
+	if (!heights.View(header.nRows, header.nColumns, (HeightGrid::Layout) header.layout,
+			reinterpret_cast<const float *>(base + header.samplesOffset), (long) header.sampleCount))
+		{ mappedFile.Close(); return false; }
+	xyScale = header.xyScale;
+	minHeight = header.minHeight;
+	maxHeight = header.maxHeight;
+
+	// the stored bounds are too coarse for the queries on a whole terrain, so the
+	// pyramid is built, the one pass over the heights
+	pyramid.Build(heights);
+	UpdateDerivatives(0, 0, header.nRows - 1, header.nColumns - 1);
+	dirtyRects.clear();
+	editedRects.clear();
+
+	// throw away the old mesh: it is rebuilt when first drawn
+	vertices.clear();
+	faceVertices.clear();
+	normals.clear();
+	patches.Clear();
+
+	if (header.hasNormals)
+		faceNormals = reinterpret_cast<const Cartesian3 *>(base + header.normalsOffset);
+	else
+		{ // no normals
+		// the normals come from the mesh, so it has to be built now
+		BuildMesh();
+		faceNormals = normals.data();
+		} // no normals
+	return true;
+	} // ReadFileBinaryTerrain()
+
+// write the terrain as a binary file
+bool Terrain::WriteFileBinaryTerrain(const char *fileName, bool withNormals)
+	{ // WriteFileBinaryTerrain()
+	if (heights.Empty() || pyramid.Empty())
+		return false;
+	std::ofstream outFile(fileName, std::ios::binary);
+	if (!outFile.good())
+		return false;
+
+	BinaryTerrainHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, binaryTerrainMagic, 4);
+	header.byteOrder = binaryTerrainByteOrder;
+	header.version = binaryTerrainVersion;
+	header.nRows = (uint32_t) heights.Rows();
+	header.nColumns = (uint32_t) heights.Columns();
+	header.layout = (uint32_t) heights.layout;
+	header.xyScale = xyScale;
+	header.minHeight = minHeight;
+	header.maxHeight = maxHeight;
+	header.hasNormals = withNormals && faceNormals != NULL ? 1 : 0;
+	header.samplesOffset = AlignOffset(sizeof(header));
+	header.sampleCount = (uint64_t) heights.BufferSize();
+	if (header.hasNormals)
+		{ // normals
+		header.normalsOffset = AlignOffset(header.samplesOffset + header.sampleCount * sizeof(float));
+		header.normalCount = 2 * (uint64_t) (header.nRows - 1) * (header.nColumns - 1);
+		} // normals
+	uint64_t endOfHeights = header.hasNormals ? header.normalsOffset + header.normalCount * sizeof(Cartesian3)
+		: header.samplesOffset + header.sampleCount * sizeof(float);
+
+	// the bounds of each block of squares, from the pyramid
+	long blockRows = (heights.Rows() - 2) / binaryTerrainBoundsCell + 1;
+	long blockColumns = (heights.Columns() - 2) / binaryTerrainBoundsCell + 1;
+	std::vector<float> bounds(2 * blockRows * blockColumns);
+	for (long blockRow = 0; blockRow < blockRows; blockRow++)
+		for (long blockColumn = 0; blockColumn < blockColumns; blockColumn++)
+			{ // per block
+			long firstRow = blockRow * binaryTerrainBoundsCell, firstColumn = blockColumn * binaryTerrainBoundsCell;
+			long lastRow = std::min(firstRow + (long) binaryTerrainBoundsCell, heights.Rows() - 1) - 1;
+			long lastColumn = std::min(firstColumn + (long) binaryTerrainBoundsCell, heights.Columns() - 1) - 1;
+			long block = blockRow * blockColumns + blockColumn;
+			pyramid.Range(firstRow, firstColumn, lastRow, lastColumn, bounds[block], bounds[blockRows * blockColumns + block]);
+			} // per block
+	header.boundsCellSize = binaryTerrainBoundsCell;
+	header.boundsOffset = AlignOffset(endOfHeights);
+	header.boundsCount = (uint64_t) blockRows * blockColumns;
+
+	// each block starts on a cache line
+	static const char zeroes[64] = { 0 };
+	outFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	outFile.write(zeroes, header.samplesOffset - sizeof(header));
+	outFile.write(reinterpret_cast<const char *>(heights.Data()), header.sampleCount * sizeof(float));
+	if (header.hasNormals)
+		{ // normals
+		outFile.write(zeroes, header.normalsOffset - (header.samplesOffset + header.sampleCount * sizeof(float)));
+		outFile.write(reinterpret_cast<const char *>(faceNormals), header.normalCount * sizeof(Cartesian3));
+		} // normals
+	outFile.write(zeroes, header.boundsOffset - endOfHeights);
+	outFile.write(reinterpret_cast<const char *>(bounds.data()), bounds.size() * sizeof(float));
+	return outFile.good();
+	} // WriteFileBinaryTerrain()
+
+// build the vertices and triangles of the render mesh from the heights
+void Terrain::BuildMesh()
+	{ // BuildMesh()
+	long height = heights.Rows(), width = heights.Columns();
+
 	// now, we want the triangles to be centred on the origin, but with the zero elevation set
 	// at 0 z, so we have to juggle things somewhat
 	// compute a temporary midpoint for the data so that it will end up centred on the or
@@ -77,59 +253,386 @@ bool Terrain::ReadFileTerrainData(const char *fileName, float XYScale)
 	
 	// each square of data is two triangles, but the end values don't have squares,
 	// so we don't need quite as many vertices
-	int nValues = 		height 		* 	width;
-	int nTriangles = 	(height-1)	*	(width-1)	*	2;
+	long nValues = 		height 		* 	width;
+	long nTriangles = 	(height-1)	*	(width-1)	*	2;
 	vertices.resize(nValues);
 	faceVertices.resize(3 * nTriangles);
 
-	// add an extra loop counter for the vertex ID
-	int vertex = 0;
+	// each row's vertices and squares' indices are independent of the others,
+	// so bands of rows are built in parallel
+	auto buildRows = [&](int firstRow, int endRow)
+		{ // buildRows()
+		// now that we have read in all the data, create the vertices
+		for (long row = firstRow; row < endRow; row++)
+			{ // per row
+			Cartesian3 *vertex = &vertices[row * width];
+			for (long col = 0; col < width; col++)
+				vertex[col] = Cartesian3(	(xyScale * col) 		- midPoint.x , 		(midPoint.y - (xyScale * row		)), 	heights.At(row, col));
+			} // per row
 
-	// now that we have read in all the data, create the vertices
-	for (int row = 0; row < height; row++)
-		for (int col = 0; col < width; col++)
-			{ // loop through data points
-			vertices[vertex++] = Cartesian3(	(xyScale * col) 		- midPoint.x , 		(midPoint.y - (xyScale * row		)), 	heightValues[row]	[col]);
-			} // loop through data points
+		// now set up the faceVertices array, which is nicely predictable
+		for (long row = firstRow; row < std::min((long) endRow, height - 1); row++)
+			{ // per row of squares
+			int *faceVertex = &faceVertices[6 * row * (width - 1)];
+			for (long col = 0; col < width-1; col++)
+				{ // per square
+				// compute the index of the base vertex for the square
+				int baseIndex = row * width + col;
+				// now insert the corresponding faceVertex indices
+				// first (UR) triangle
+				*faceVertex++ = baseIndex;
+				*faceVertex++ = baseIndex + width + 1;
+				*faceVertex++ = baseIndex + 1;
 
-	// add a counter for the facevertex ID
-	int faceVertex = 0;
+				// second (LL) triangle
+				*faceVertex++ = baseIndex;
+				*faceVertex++ = baseIndex + width;
+				*faceVertex++ = baseIndex + width + 1;
+				} // per square
+			} // per row of squares
+		}; // buildRows()
 
-	// now set up the faceVertices array, which is nicely predictable
-	for (int row = 0; row < height-1; row++)
-		for (int col = 0; col < width-1; col++)
-			{ // per square
-			// compute the index of the base vertex for the square
-			int baseIndex = row * width + col;
-			// now insert the corresponding faceVertex indices
-			// first (UR) triangle
-			faceVertices[faceVertex++] = baseIndex;
-			faceVertices[faceVertex++] = baseIndex + width + 1;
-			faceVertices[faceVertex++] = baseIndex + 1;
-			
-			// second (LL) triangle
-			faceVertices[faceVertex++] = baseIndex;
-			faceVertices[faceVertex++] = baseIndex + width;
-			faceVertices[faceVertex++] = baseIndex + width + 1;
-			} // per square	
+	// about 64K vertices per job
+	int rowsPerJob = (int) std::max(1L, 65536 / std::max(width, 1L));
+	if (jobSystem != NULL && height > rowsPerJob)
+		jobSystem->ParallelFor((int) height, rowsPerJob, buildRows);
+	else
+		buildRows(0, (int) height);
 
 	// call the routine to compute normals
-	ComputeUnitNormalVectors();
-	
-	// return success
-	return true;
-	} // ReadFileTerrainData()
-	
-// and a function to find the height at a known (x,y) coordinate
-float Terrain::getHeight(float x, float y)
-	{ // getHeight()
-	float height = 0.0;
+	ComputeUnitNormalVectors(jobSystem);
+
+	// and the patches are cut from the new mesh when it is next drawn
+	patches.Clear();
+	} // BuildMesh()
 
+// render, building the mesh first if need be
+void Terrain::Render()
+	{ // Render()
+	UploadEdits();
+	if (vertices.empty() && !heights.Empty())
+		BuildMesh();
+	if (patches.Empty() && !vertices.empty())
+		patches.Build(heights.Rows(), heights.Columns(), vertices, normals.data());
+	patches.Render(vertices);
+	} // Render()
+
+// test whether an (x,y) coordinate lies over the terrain grid
+bool Terrain::Contains(float x, float y)
+	{ // Contains()
 	// retrieve the number of rows and columns of the data
-	long nRows = heightValues.size(), nColumns = heightValues[0].size();
-	
+	long nRows = GridRows(), nColumns = GridColumns();
+	if (nRows == 0 || nColumns == 0)
+		return false;
+
+	// convert to array coordinates the same way as getHeight()
+	x = x + (nColumns / 2) * xyScale;
+	y = GridFlip(nRows) - (y + (nRows / 2) * xyScale);
+
+	// the last row and column only bound squares, they don't start them
+	return x >= 0.0 && y >= 0.0 && x < (nColumns - 1) * xyScale && y < (nRows - 1) * xyScale;
+	} // Contains()
+
+// the squares under a rectangle, clamped to the grid
+bool Terrain::SquaresUnder(float minX, float minY, float maxX, float maxY, long &firstRow, long &firstColumn, long &lastRow, long &lastColumn)
+	{ // SquaresUnder()
+	long nRows = GridRows(), nColumns = GridColumns();
+	if (nRows < 2 || nColumns < 2)
+		return false;
+
+	// grid coordinates as in getHeight(), with rows running down the map, and
+	// a little slack so that rounding can't leave out the square a point is in
+	float originX = (nColumns / 2) * xyScale;
+	float originY = (nRows / 2) * xyScale;
+	float totalHeight = GridFlip(nRows);
+	float slack = 1.0e-3 * xyScale;
+	float lowColumn = (minX - slack + originX) / xyScale;
+	float highColumn = (maxX + slack + originX) / xyScale;
+	float lowRow = (totalHeight - (maxY + slack + originY)) / xyScale;
+	float highRow = (totalHeight - (minY - slack + originY)) / xyScale;
+	if (highColumn < 0.0 || highRow < 0.0 || lowColumn >= nColumns - 1 || lowRow >= nRows - 1)
+		return false;
+
+	firstColumn = std::max(0L, (long) floor(lowColumn));
+	lastColumn = std::min(nColumns - 2, (long) floor(highColumn));
+	firstRow = std::max(0L, (long) floor(lowRow));
+	lastRow = std::min(nRows - 2, (long) floor(highRow));
+	return true;
+	} // SquaresUnder()
+
+// the lowest and highest terrain under a rectangle
+bool Terrain::HeightRange(float minX, float minY, float maxX, float maxY, float &low, float &high)
+	{ // HeightRange()
+	long firstRow, firstColumn, lastRow, lastColumn;
+	if (pyramid.Empty() || !SquaresUnder(minX, minY, maxX, maxY, firstRow, firstColumn, lastRow, lastColumn))
+		return false;
+	pyramid.Range(firstRow, firstColumn, lastRow, lastColumn, low, high);
+	return true;
+	} // HeightRange()
+
+// true if a box is certainly clear of the terrain
+bool Terrain::BoxClear(const Cartesian3 &lower, const Cartesian3 &upper)
+	{ // BoxClear()
+	// above the highest point anywhere needs no search
+	if (lower.z > maxHeight)
+		return true;
+	long firstRow, firstColumn, lastRow, lastColumn;
+	if (!SquaresUnder(lower.x, lower.y, upper.x, upper.y, firstRow, firstColumn, lastRow, lastColumn))
+		return true;
+	return !pyramid.Empty() && pyramid.Below(firstRow, firstColumn, lastRow, lastColumn, lower.z);
+	} // BoxClear()
+
+// the triangles of the squares under a rectangle
+int Terrain::TrianglesUnder(float minX, float minY, float maxX, float maxY, Cartesian3 *corners, int maxTriangles, int firstTriangle)
+	{ // TrianglesUnder()
+	long firstRow, firstColumn, lastRow, lastColumn;
+	if (!SquaresUnder(minX, minY, maxX, maxY, firstRow, firstColumn, lastRow, lastColumn))
+		return 0;
+
+	// the world position of a sample is the inverse of LocateSquare()
+	long nRows = GridRows(), nColumns = GridColumns();
+	float originX = (nColumns / 2) * xyScale;
+	float top = GridFlip(nRows) - (nRows / 2) * xyScale;
+	int nTriangles = 0;
+	for (long row = firstRow; row <= lastRow; row++)
+		for (long column = firstColumn; column <= lastColumn; column++)
+			{ // per square
+			float upperLeft, upperRight, lowerLeft, lowerRight;
+			SquareCorners(row, column, upperLeft, upperRight, lowerLeft, lowerRight);
+			float left = column * xyScale - originX, right = left + xyScale;
+			float upper = top - row * xyScale, lower = upper - xyScale;
+			Cartesian3 squareCorners[2][3] =
+				{
+				{ Cartesian3(left, upper, upperLeft), Cartesian3(right, lower, lowerRight), Cartesian3(right, upper, upperRight) },
+				{ Cartesian3(left, upper, upperLeft), Cartesian3(left, lower, lowerLeft), Cartesian3(right, lower, lowerRight) }
+				};
+			for (int triangle = 0; triangle < 2; triangle++, nTriangles++)
+				if (nTriangles >= firstTriangle && nTriangles - firstTriangle < maxTriangles)
+					std::copy(squareCorners[triangle], squareCorners[triangle] + 3, corners + 3 * (nTriangles - firstTriangle));
+			} // per square
+	return nTriangles;
+	} // TrianglesUnder()
+
+// true if a ball is certainly clear of the terrain
+bool Terrain::SphereClear(const Cartesian3 &centre, float radius)
+	{ // SphereClear()
+	// the contact only looks at the height under the centre
+	return BoxClear(Cartesian3(centre.x, centre.y, centre.z - radius), Cartesian3(centre.x, centre.y, centre.z + radius));
+	} // SphereClear()
+
+// bring the pyramid up to date after samples have been changed
+void Terrain::UpdatePyramid(long firstRow, long firstColumn, long lastRow, long lastColumn)
+	{ // UpdatePyramid()
+	if (pyramid.Empty())
+		return;
+	// a sample is a corner of the squares above and to the left of it as well
+	pyramid.Update(heights, firstRow - 1, firstColumn - 1, lastRow, lastColumn);
+	minHeight = pyramid.levels.back().low[0];
+	maxHeight = pyramid.levels.back().high[0];
+	} // UpdatePyramid()
+
+// compute the derivatives of the samples in a block and their neighbours
+void Terrain::UpdateDerivatives(long firstRow, long firstColumn, long lastRow, long lastColumn)
+	{ // UpdateDerivatives()
+	long nRows = heights.Rows(), nColumns = heights.Columns();
+	if (nRows < 2 || nColumns < 2)
+		{ derivatives.clear(); return; }
+	if ((long) derivatives.size() != nRows * nColumns)
+		{ // new grid
+		derivatives.resize(nRows * nColumns);
+		firstRow = firstColumn = 0;
+		lastRow = nRows - 1;
+		lastColumn = nColumns - 1;
+		} // new grid
+
+	// a sample's differences reach one sample either side
+	firstRow = std::max(firstRow - 1, 0L);
+	firstColumn = std::max(firstColumn - 1, 0L);
+	lastRow = std::min(lastRow + 1, nRows - 1);
+	lastColumn = std::min(lastColumn + 1, nColumns - 1);
+
+	for (long row = firstRow; row <= lastRow; row++)
+		{ // per row
+		// central differences, or one-sided at the edges
+		long above = std::max(row - 1, 0L), below = std::min(row + 1, nRows - 1);
+		for (long column = firstColumn; column <= lastColumn; column++)
+			{ // per sample
+			long left = std::max(column - 1, 0L), right = std::min(column + 1, nColumns - 1);
+			float across = (heights.At(row, right) - heights.At(row, left)) / (right - left);
+			float down = (heights.At(below, column) - heights.At(above, column)) / (below - above);
+			float twist = (heights.At(below, right) - heights.At(below, left) - heights.At(above, right) + heights.At(above, left))
+				/ ((right - left) * (below - above));
+
+			// rows run towards -y, so the slope down them is the negative of dh/dy
+			HeightDerivatives &sample = derivatives[row * nColumns + column];
+			sample.gradientX = across / xyScale;
+			sample.gradientY = -down / xyScale;
+			sample.twist = -twist / (xyScale * xyScale);
+			sample.normal = Cartesian3(-sample.gradientX, -sample.gradientY, 1.0).unit();
+			} // per sample
+		} // per row
+	} // UpdateDerivatives()
+
+// copy a mapped terrain so that it can be edited
+bool Terrain::MakeEditable()
+	{ // MakeEditable()
+	if (heights.Empty())
+		return false;
+	if (heights.IsView())
+		heights.SetLayout(heights.layout);
+
+	// the edits keep the mesh and its normals up to date, so it has to exist,
+	// and the normals in the file no longer match once the heights change
+	if (vertices.empty())
+		BuildMesh();
+	faceNormals = normals.data();
+	mappedFile.Close();
+	return true;
+	} // MakeEditable()
+
+// change one sample
+bool Terrain::SetHeight(long row, long column, float height)
+	{ // SetHeight()
+	if (row < 0 || row >= heights.Rows() || column < 0 || column >= heights.Columns() || !MakeEditable())
+		return false;
+	heights.Set(row, column, height);
+	MarkDirty(row, column, row, column);
+	return true;
+	} // SetHeight()
+
+// the samples within radius of (x,y)
+bool Terrain::DiscSamples(float x, float y, float radius, long &firstRow, long &firstColumn, long &lastRow, long &lastColumn)
+	{ // DiscSamples()
+	// the same placement as getHeight(), with the rows running towards -y
+	long nRows = heights.Rows(), nColumns = heights.Columns();
+	float centreColumn = x / xyScale + nColumns / 2;
+	float centreRow = (GridFlip(nRows) - (y + (nRows / 2) * xyScale)) / xyScale;
+	float reach = radius / xyScale;
+	firstColumn = std::max((long) ceil(centreColumn - reach), 0L);
+	lastColumn = std::min((long) floor(centreColumn + reach), nColumns - 1);
+	firstRow = std::max((long) ceil(centreRow - reach), 0L);
+	lastRow = std::min((long) floor(centreRow + reach), nRows - 1);
+	return radius > 0.0 && firstRow <= lastRow && firstColumn <= lastColumn;
+	} // DiscSamples()
+
+// lower the ground into a bowl
+bool Terrain::Crater(float x, float y, float radius, float depth)
+	{ // Crater()
+	long firstRow, firstColumn, lastRow, lastColumn;
+	if (!DiscSamples(x, y, radius, firstRow, firstColumn, lastRow, lastColumn) || !MakeEditable())
+		return false;
+	long nRows = heights.Rows(), nColumns = heights.Columns();
+	for (long row = firstRow; row <= lastRow; row++)
+		for (long column = firstColumn; column <= lastColumn; column++)
+			{ // per sample
+			float dx = xyScale * (column - nColumns / 2) - x;
+			float dy = GridFlip(nRows) - xyScale * (nRows / 2 + row) - y;
+			float fraction = (dx * dx + dy * dy) / (radius * radius);
+			if (fraction < 1.0)
+				heights.Set(row, column, heights.At(row, column) - depth * (1.0 - fraction));
+			} // per sample
+	MarkDirty(firstRow, firstColumn, lastRow, lastColumn);
+	return true;
+	} // Crater()
+
+// raise the ground with a smooth brush
+bool Terrain::Stamp(float x, float y, float radius, float height)
+	{ // Stamp()
+	long firstRow, firstColumn, lastRow, lastColumn;
+	if (!DiscSamples(x, y, radius, firstRow, firstColumn, lastRow, lastColumn) || !MakeEditable())
+		return false;
+	long nRows = heights.Rows(), nColumns = heights.Columns();
+	for (long row = firstRow; row <= lastRow; row++)
+		for (long column = firstColumn; column <= lastColumn; column++)
+			{ // per sample
+			float dx = xyScale * (column - nColumns / 2) - x;
+			float dy = GridFlip(nRows) - xyScale * (nRows / 2 + row) - y;
+			float fraction = (dx * dx + dy * dy) / (radius * radius);
+			if (fraction < 1.0)
+				heights.Set(row, column, heights.At(row, column) + height * (1.0 - fraction) * (1.0 - fraction));
+			} // per sample
+	MarkDirty(firstRow, firstColumn, lastRow, lastColumn);
+	return true;
+	} // Stamp()
+
+// add samples to the dirty rectangles
+void Terrain::MarkDirty(long firstRow, long firstColumn, long lastRow, long lastColumn)
+	{ // MarkDirty()
+	TerrainRect rect = { std::max(firstRow, 0L), std::max(firstColumn, 0L),
+		std::min(lastRow, heights.Rows() - 1), std::min(lastColumn, heights.Columns() - 1) };
+	if (rect.firstRow > rect.lastRow || rect.firstColumn > rect.lastColumn)
+		return;
+
+	// the queries see the whole of the change at once
+	UpdateEdited(rect);
+	editedRects.push_back(rect);
+
+	// the updates reach a sample beyond each rectangle, so rectangles that
+	// overlap or touch are merged rather than updating the same samples twice
+	for (size_t other = 0; other < dirtyRects.size(); )
+		{ // per rectangle
+		const TerrainRect &old = dirtyRects[other];
+		if (old.firstRow > rect.lastRow + 1 || old.lastRow < rect.firstRow - 1
+				|| old.firstColumn > rect.lastColumn + 1 || old.lastColumn < rect.firstColumn - 1)
+			{ other++; continue; }
+
+		// the merged rectangle may now reach others, so start again
+		rect.firstRow = std::min(rect.firstRow, old.firstRow);
+		rect.firstColumn = std::min(rect.firstColumn, old.firstColumn);
+		rect.lastRow = std::max(rect.lastRow, old.lastRow);
+		rect.lastColumn = std::max(rect.lastColumn, old.lastColumn);
+		dirtyRects.erase(dirtyRects.begin() + other);
+		other = 0;
+		} // per rectangle
+	dirtyRects.push_back(rect);
+	} // MarkDirty()
+
+// bring the mesh, normals, pyramid and derivatives up to date over edited samples
+void Terrain::UpdateEdited(const TerrainRect &rect)
+	{ // UpdateEdited()
+	long nRows = heights.Rows(), nColumns = heights.Columns();
+
+	// the vertices of the mesh
+	for (long row = rect.firstRow; row <= rect.lastRow; row++)
+		for (long column = rect.firstColumn; column <= rect.lastColumn; column++)
+			vertices[row * nColumns + column].z = heights.At(row, column);
+
+	// the faces of the squares the samples are corners of, which are two per
+	// square, so each row of squares is one run of faces
+	long firstSquareColumn = std::max(rect.firstColumn - 1, 0L), lastSquareColumn = std::min(rect.lastColumn, nColumns - 2);
+	for (long row = std::max(rect.firstRow - 1, 0L); row <= std::min(rect.lastRow, nRows - 2); row++)
+		ComputeUnitNormalVectors(2 * (row * (nColumns - 1) + firstSquareColumn), 2 * (row * (nColumns - 1) + lastSquareColumn) + 1);
+
+	// and the pyramid, with the height range, and the derivatives
+	UpdatePyramid(rect.firstRow, rect.firstColumn, rect.lastRow, rect.lastColumn);
+	UpdateDerivatives(rect.firstRow, rect.firstColumn, rect.lastRow, rect.lastColumn);
+	} // UpdateEdited()
+
+// send the edits to the patches that draw them
+void Terrain::UploadEdits()
+	{ // UploadEdits()
+	long nRows = heights.Rows(), nColumns = heights.Columns();
+	for (const TerrainRect &rect : dirtyRects)
+		patches.Update(rect.firstRow, rect.firstColumn, rect.lastRow, rect.lastColumn, nRows, nColumns, vertices, faceNormals);
+	dirtyRects.clear();
+	} // UploadEdits()
+
+// the world rectangle over the squares that have a sample of rect as a corner
+void Terrain::RectBounds(const TerrainRect &rect, float &minX, float &minY, float &maxX, float &maxY)
+	{ // RectBounds()
+	// the same placement as getHeight(), with the rows running towards -y
+	long nRows = heights.Rows(), nColumns = heights.Columns();
+	minX = xyScale * (rect.firstColumn - 1 - nColumns / 2);
+	maxX = xyScale * (rect.lastColumn + 1 - nColumns / 2);
+	minY = GridFlip(nRows) - xyScale * (nRows / 2 + rect.lastRow + 1);
+	maxY = GridFlip(nRows) - xyScale * (nRows / 2 + rect.firstRow - 1);
+	} // RectBounds()
+
+// find the square of an nRows x nColumns grid that (x,y) lies in, and the fractional position within it
+void Terrain::LocateSquare(float x, float y, long nRows, long nColumns, long &row, long &column, float &xRemainder, float &yRemainder)
+	{ // LocateSquare()
 	// Use this to compute the logical size of the map
-	long totalHeight = (nRows - 1) * xyScale;
+	float totalHeight = GridFlip(nRows);
 
 	// this returns the height at a known point.
 	// we start by noting that (0,0) is in the dead centre, which is located at
@@ -150,44 +653,58 @@ float Terrain::getHeight(float x, float y)
 	long y_integer 	= 	y / xyScale;
 
 	// now work out the fractional parts
-	float x_remainder	=	(float)(x - (xyScale * x_integer))/xyScale;
-	float y_remainder	=	(float)(y - (xyScale * y_integer))/xyScale;
+	xRemainder	=	(float)(x - (xyScale * x_integer))/xyScale;
+	yRemainder	=	(float)(y - (xyScale * y_integer))/xyScale;
 
 	// now we can find the row and column easily
-	long row	=	y_integer;
-	long column	=	x_integer; 
+	row		=	y_integer;
+	column	=	x_integer; 
+	} // LocateSquare()
 
+// interpolate the height in a square from its corners
+float Terrain::InterpolateSquare(float upperLeft, float upperRight, float lowerLeft, float lowerRight, float xRemainder, float yRemainder)
+	{ // InterpolateSquare()
 	// OK. There are two possibilities - above or below the TL-BR diagonal
 	// Since this is the line x = y, it's easy to check
-	if (x_remainder < y_remainder)
+	if (xRemainder < yRemainder)
 		{ // LL triangle
 		// in theory, we want barycentric interpolation, but fortunately, it collapses for us because we have 
 		// right triangles.  
 		// y_remainder is alpha, the barycentric coordinate for the UL corner
 		// (1.0 - y_remainder) * x_remainder is beta, the barycentric coordinate for the LR corner
 		// (1.0 - y_remainder) * (1.0 - x_remainder) is gamma, the barycentric coordinate for the LL corner
-		float alpha = y_remainder;
-		float beta = (1.0 - y_remainder) * x_remainder;
+		float alpha = yRemainder;
+		float beta = (1.0 - yRemainder) * xRemainder;
 		float gamma = 1.0 - alpha - beta;
 		
 		// compute and return
-		height = alpha * heightValues[row][column] + beta * heightValues[row+1][column+1] + gamma * heightValues[row+1][column];
+		return alpha * upperLeft + beta * lowerRight + gamma * lowerLeft;
 		} // LL triangle
 	else
 		{ // UR triangle
 		// (1.0 - x_remainder) is alpha, the barycentric coordinate for the UL corner
 		// x_remainder * y_remainder is beta, the barycentric coordinate for the LR corner
 		// x_remainder * (1.0 - y_remainder) is gamma, the barycentric coordinate for the UR corner
-		float alpha = 1.0 - y_remainder;
-		float beta = x_remainder * y_remainder;
+		float alpha = 1.0 - yRemainder;
+		float beta = xRemainder * yRemainder;
 		float gamma = 1.0 - alpha - beta;
 		
 		// compute and return
-		height = alpha * heightValues[row][column] + beta * heightValues[row+1][column+1] + gamma * heightValues[row][column+1];
+		return alpha * upperLeft + beta * lowerRight + gamma * upperRight;
 		} // UR triangle
+	} // InterpolateSquare()
 
-	// return the height
-	return height;
+// and a function to find the height at a known (x,y) coordinate
+float Terrain::getHeight(float x, float y)
+	{ // getHeight()
+	// find the square and the position in it
+	long row, column;
+	float x_remainder, y_remainder;
+	LocateSquare(x, y, heights.Rows(), heights.Columns(), row, column, x_remainder, y_remainder);
+
+	// and interpolate between its corners
+	return InterpolateSquare(heights.At(row, column), heights.At(row, column + 1),
+		heights.At(row + 1, column), heights.At(row + 1, column + 1), x_remainder, y_remainder);
 	} // getHeight()
 
 
@@ -195,40 +712,13 @@ float Terrain::getHeight(float x, float y)
 // A related function to find the normal vector at a given (x,y) coordinate
 Cartesian3 Terrain::getNormal(float x, float y)
 	{ // getNormal()
-	// retrieve the number of rows and columns of the data
-	long nRows = heightValues.size(), nColumns = heightValues[0].size();
-	
-	// Use this to compute the logical size of the map
-	long totalHeight = (nRows - 1) * xyScale;
-
-	// this returns the height at a known point.
-	// we start by noting that (0,0) is in the dead centre, which is located at
-	// x = nRows / 2 (integer), y = nRows / 2 (integer)
-	// BUT that's only because of how I wrote the code to generate the data
-	long arrayOrigin_i = nRows / 2;
-	long arrayOrigin_j = nColumns / 2;
-
-	// now correct x and y for this offset (note rows are y, columns are x)
-	x = x + arrayOrigin_j * xyScale;
-	y = y + arrayOrigin_i * xyScale;
-
-	// we need to flip coordinates vertically because the rows start at the top
-	y = totalHeight - y;
-
-	// now divide by the x-y scale to get the index 
-	long x_integer	=	x / xyScale;
-	long y_integer 	= 	y / xyScale;
-
-	// now work out the fractional parts
-	float x_remainder	=	(float)(x - (xyScale * x_integer))/xyScale;
-	float y_remainder	=	(float)(y - (xyScale * y_integer))/xyScale;
-
-	// now we can find the row and column easily
-	long row	=	y_integer;
-	long column	=	x_integer; 
+	// find the square and the position in it, as for the height
+	long row, column;
+	float x_remainder, y_remainder;
+	LocateSquare(x, y, heights.Rows(), heights.Columns(), row, column, x_remainder, y_remainder);
 	
 	// once we have that, we can work out the ID of the square the point is in
-	long squareID = row * (nColumns-1) + column;
+	long squareID = row * (heights.Columns()-1) + column;
 	
 	// OK. There are two possibilities - above or below the TL-BR diagonal
 	// Since this is the line x = y, it's easy to check
@@ -238,7 +728,7 @@ Cartesian3 Terrain::getNormal(float x, float y)
 		long faceID = 2 * squareID + 1;
 		
 		// return its normal
-		return normals[faceID];
+		return faceNormals[faceID];
 		} // LL triangle
 	else
 		{ // UR triangle
@@ -246,8 +736,686 @@ Cartesian3 Terrain::getNormal(float x, float y)
 		long faceID = 2 * squareID;
 		
 		// return its normal
-		return normals[faceID];
+		return faceNormals[faceID];
 		} // UR triangle
 
 	} // getNormal()	
 
+// which square of the grid (x, y) lies in, kept on the grid
+void Terrain::ClampedSquare(float x, float y, long &row, long &column, float &xRemainder, float &yRemainder)
+	{ // ClampedSquare()
+	long nRows = GridRows(), nColumns = GridColumns();
+	LocateSquare(x, y, nRows, nColumns, row, column, xRemainder, yRemainder);
+
+	// off the grid, use the nearest point on its edge, as the batch queries do
+	if (column < 0 || (column == 0 && xRemainder < 0.0))
+		{ column = 0; xRemainder = 0.0; }
+	else if (column > nColumns - 2)
+		{ column = nColumns - 2; xRemainder = 1.0; }
+	if (row < 0 || (row == 0 && yRemainder < 0.0))
+		{ row = 0; yRemainder = 0.0; }
+	else if (row > nRows - 2)
+		{ row = nRows - 2; yRemainder = 1.0; }
+	} // ClampedSquare()
+
+// the height blended bilinearly from the corners of the square, with no
+// crease along the diagonal
+float Terrain::getHeightBilinear(float x, float y)
+	{ // getHeightBilinear()
+	long row, column;
+	float xRemainder, yRemainder;
+	ClampedSquare(x, y, row, column, xRemainder, yRemainder);
+
+	float upper = heights.At(row, column) + (heights.At(row, column + 1) - heights.At(row, column)) * xRemainder;
+	float lower = heights.At(row + 1, column) + (heights.At(row + 1, column + 1) - heights.At(row + 1, column)) * xRemainder;
+	return upper + (lower - upper) * yRemainder;
+	} // getHeightBilinear()
+
+// the normals of the corners blended bilinearly
+Cartesian3 Terrain::getNormalBilinear(float x, float y)
+	{ // getNormalBilinear()
+	long row, column;
+	float xRemainder, yRemainder;
+	ClampedSquare(x, y, row, column, xRemainder, yRemainder);
+
+	long nColumns = heights.Columns();
+	const HeightDerivatives *upperLeft = &derivatives[row * nColumns + column];
+	const HeightDerivatives *lowerLeft = upperLeft + nColumns;
+	Cartesian3 upper = upperLeft[0].normal * (1.0 - xRemainder) + upperLeft[1].normal * xRemainder;
+	Cartesian3 lower = lowerLeft[0].normal * (1.0 - xRemainder) + lowerLeft[1].normal * xRemainder;
+	return (upper * (1.0 - yRemainder) + lower * yRemainder).unit();
+	} // getNormalBilinear()
+
+// the Hermite patch over a square, from the heights and derivatives at its corners
+void Terrain::HermitePatch(const float *cornerHeights, const HeightDerivatives *const *cornerDerivatives,
+	float xRemainder, float yRemainder, float &height, float &gradientX, float &gradientY)
+	{ // HermitePatch()
+	// the cubic Hermite basis and its derivatives, across (u) and down (v)
+	float u = xRemainder, v = yRemainder;
+	float basisU[4] = { (2 * u - 3) * u * u + 1, ((u - 2) * u + 1) * u, (3 - 2 * u) * u * u, (u - 1) * u * u };
+	float slopeU[4] = { (6 * u - 6) * u, (3 * u - 4) * u + 1, (6 - 6 * u) * u, (3 * u - 2) * u };
+	float basisV[4] = { (2 * v - 3) * v * v + 1, ((v - 2) * v + 1) * v, (3 - 2 * v) * v * v, (v - 1) * v * v };
+	float slopeV[4] = { (6 * v - 6) * v, (3 * v - 4) * v + 1, (6 - 6 * v) * v, (3 * v - 2) * v };
+
+	// the corners' derivatives in squares: a square spans xyScale, and v runs towards -y
+	height = gradientX = gradientY = 0.0;
+	for (int corner = 0; corner < 4; corner++)
+		{ // per corner
+		int across = 2 * (corner & 1), down = 2 * (corner >> 1);
+		const HeightDerivatives &sample = *cornerDerivatives[corner];
+		float value = cornerHeights[corner];
+		float dU = sample.gradientX * xyScale;
+		float dV = -sample.gradientY * xyScale;
+		float dUV = -sample.twist * xyScale * xyScale;
+
+		height += basisU[across] * basisV[down] * value + basisU[across + 1] * basisV[down] * dU
+			+ basisU[across] * basisV[down + 1] * dV + basisU[across + 1] * basisV[down + 1] * dUV;
+		gradientX += slopeU[across] * basisV[down] * value + slopeU[across + 1] * basisV[down] * dU
+			+ slopeU[across] * basisV[down + 1] * dV + slopeU[across + 1] * basisV[down + 1] * dUV;
+		gradientY += basisU[across] * slopeV[down] * value + basisU[across + 1] * slopeV[down] * dU
+			+ basisU[across] * slopeV[down + 1] * dV + basisU[across + 1] * slopeV[down + 1] * dUV;
+		} // per corner
+
+	// and back to world units
+	gradientX /= xyScale;
+	gradientY /= -xyScale;
+	} // HermitePatch()
+
+// the height on the bicubic patch through the corners of the square
+float Terrain::getHeightBicubic(float x, float y)
+	{ // getHeightBicubic()
+	long row, column;
+	float xRemainder, yRemainder;
+	ClampedSquare(x, y, row, column, xRemainder, yRemainder);
+
+	long nColumns = heights.Columns();
+	const HeightDerivatives *upperLeft = &derivatives[row * nColumns + column];
+	float cornerHeights[4] = { heights.At(row, column), heights.At(row, column + 1), heights.At(row + 1, column), heights.At(row + 1, column + 1) };
+	const HeightDerivatives *cornerDerivatives[4] = { upperLeft, upperLeft + 1, upperLeft + nColumns, upperLeft + nColumns + 1 };
+	float height, gradientX, gradientY;
+	HermitePatch(cornerHeights, cornerDerivatives, xRemainder, yRemainder, height, gradientX, gradientY);
+	return height;
+	} // getHeightBicubic()
+
+// the normal of the bicubic patch
+Cartesian3 Terrain::getNormalBicubic(float x, float y)
+	{ // getNormalBicubic()
+	long row, column;
+	float xRemainder, yRemainder;
+	ClampedSquare(x, y, row, column, xRemainder, yRemainder);
+
+	long nColumns = heights.Columns();
+	const HeightDerivatives *upperLeft = &derivatives[row * nColumns + column];
+	float cornerHeights[4] = { heights.At(row, column), heights.At(row, column + 1), heights.At(row + 1, column), heights.At(row + 1, column + 1) };
+	const HeightDerivatives *cornerDerivatives[4] = { upperLeft, upperLeft + 1, upperLeft + nColumns, upperLeft + nColumns + 1 };
+	float height, gradientX, gradientY;
+	HermitePatch(cornerHeights, cornerDerivatives, xRemainder, yRemainder, height, gradientX, gradientY);
+	return Cartesian3(-gradientX, -gradientY, 1.0).unit();
+	} // getNormalBicubic()
+
+// the batch queries gather normals straight out of the array of Cartesian3
+static_assert(sizeof(Cartesian3) == 3 * sizeof(float), "Cartesian3 must be three packed floats");
+
+// the constants the batch queries need to put points on the grid, which
+// getHeight() works out afresh for every point
+struct GridFrame
+	{ // struct GridFrame
+	// grid coordinates are ((x + originX) / scale, (flip - (y + originY)) / scale)
+	float originX, originY, flip, scale;
+	// and are clamped to [0, maxX] x [0, maxY] in world units, with the square
+	// indices clamped to [0, maxColumn] x [0, maxRow]
+	float maxX, maxY;
+	int maxColumn, maxRow;
+	// the number of squares in a row, for face IDs
+	int squaresPerRow;
+	}; // struct GridFrame
+
+// set up the frame for a grid of the given size
+static GridFrame MakeGridFrame(long nRows, long nColumns, float xyScale)
+	{ // MakeGridFrame()
+	GridFrame frame;
+	frame.originX = (nColumns / 2) * xyScale;
+	frame.originY = (nRows / 2) * xyScale;
+	// getHeight() truncates this to an integer, so do the same
+	frame.flip = (float) (long) ((nRows - 1) * xyScale);
+	frame.scale = xyScale;
+	frame.maxX = (nColumns - 1) * xyScale;
+	frame.maxY = (nRows - 1) * xyScale;
+	frame.maxColumn = (int) nColumns - 2;
+	frame.maxRow = (int) nRows - 2;
+	frame.squaresPerRow = (int) nColumns - 1;
+	return frame;
+	} // MakeGridFrame()
+
+// a coordinate in world units to a square index and a remainder in [0, 1]
+static inline void LocateOnGrid(float value, float scale, float maxValue, int maxIndex, int &index, float &remainder)
+	{ // LocateOnGrid()
+	value = std::min(std::max(value, 0.0f), maxValue);
+	index = std::min((int) (value / scale), maxIndex);
+	remainder = (value - scale * index) / scale;
+	} // LocateOnGrid()
+
+#if defined(__AVX2__)
+// and eight at a time
+static inline void LocateOnGrid8(__m256 value, __m256 scale, __m256 maxValue, __m256i maxIndex, __m256i &index, __m256 &remainder)
+	{ // LocateOnGrid8()
+	value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), maxValue);
+	index = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_div_ps(value, scale)), maxIndex);
+	remainder = _mm256_div_ps(_mm256_sub_ps(value, _mm256_mul_ps(scale, _mm256_cvtepi32_ps(index))), scale);
+	} // LocateOnGrid8()
+#endif
+
+// batch version of getHeight()
+void Terrain::getHeights(const float *x, const float *y, float *height, int count)
+	{ // getHeights()
+	if (heights.Empty())
+		{ // no data
+		std::fill(height, height + count, 0.0f);
+		return;
+		} // no data
+
+	GridFrame frame = MakeGridFrame(heights.Rows(), heights.Columns(), xyScale);
+	const int *rowOffset = heights.RowOffsets();
+	const int *columnOffset = heights.ColumnOffsets();
+	const float *samples = heights.Data();
+
+	int point = 0;
+#if defined(__AVX2__)
+	__m256 originX = _mm256_set1_ps(frame.originX), originY = _mm256_set1_ps(frame.originY);
+	__m256 flip = _mm256_set1_ps(frame.flip), scale = _mm256_set1_ps(frame.scale);
+	__m256 maxX = _mm256_set1_ps(frame.maxX), maxY = _mm256_set1_ps(frame.maxY);
+	__m256i maxColumn = _mm256_set1_epi32(frame.maxColumn), maxRow = _mm256_set1_epi32(frame.maxRow);
+	__m256i one = _mm256_set1_epi32(1);
+	__m256 unit = _mm256_set1_ps(1.0f);
+	for (; point + 8 <= count; point += 8)
+		{ // eight at a time
+		__m256i column, row;
+		__m256 xRemainder, yRemainder;
+		LocateOnGrid8(_mm256_add_ps(_mm256_loadu_ps(x + point), originX), scale, maxX, maxColumn, column, xRemainder);
+		LocateOnGrid8(_mm256_sub_ps(flip, _mm256_add_ps(_mm256_loadu_ps(y + point), originY)), scale, maxY, maxRow, row, yRemainder);
+
+		// the parts of the corner indices
+		__m256i top = _mm256_i32gather_epi32(rowOffset, row, 4);
+		__m256i bottom = _mm256_i32gather_epi32(rowOffset, _mm256_add_epi32(row, one), 4);
+		__m256i left = _mm256_i32gather_epi32(columnOffset, column, 4);
+		__m256i right = _mm256_i32gather_epi32(columnOffset, _mm256_add_epi32(column, one), 4);
+
+		// the LL triangle uses the lower left corner, the UR the upper right
+		__m256 lower = _mm256_cmp_ps(xRemainder, yRemainder, _CMP_LT_OQ);
+		__m256i third = _mm256_castps_si256(_mm256_blendv_ps(
+			_mm256_castsi256_ps(_mm256_add_epi32(top, right)), _mm256_castsi256_ps(_mm256_add_epi32(bottom, left)), lower));
+
+		__m256 upperLeft = _mm256_i32gather_ps(samples, _mm256_add_epi32(top, left), 4);
+		__m256 lowerRight = _mm256_i32gather_ps(samples, _mm256_add_epi32(bottom, right), 4);
+		__m256 thirdHeight = _mm256_i32gather_ps(samples, third, 4);
+
+		// the same weights as getHeight(), selected rather than branched on
+		__m256 yComplement = _mm256_sub_ps(unit, yRemainder);
+		__m256 alpha = _mm256_blendv_ps(yComplement, yRemainder, lower);
+		__m256 beta = _mm256_mul_ps(xRemainder, _mm256_blendv_ps(yRemainder, yComplement, lower));
+		__m256 gamma = _mm256_sub_ps(_mm256_sub_ps(unit, alpha), beta);
+
+		__m256 result = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(alpha, upperLeft), _mm256_mul_ps(beta, lowerRight)), _mm256_mul_ps(gamma, thirdHeight));
+		_mm256_storeu_ps(height + point, result);
+		} // eight at a time
+#endif
+	// scalar tail
+	for (; point < count; point++)
+		{ // per point
+		int column, row;
+		float xRemainder, yRemainder;
+		LocateOnGrid(x[point] + frame.originX, frame.scale, frame.maxX, frame.maxColumn, column, xRemainder);
+		LocateOnGrid(frame.flip - (y[point] + frame.originY), frame.scale, frame.maxY, frame.maxRow, row, yRemainder);
+
+		bool lower = xRemainder < yRemainder;
+		float upperLeft = samples[rowOffset[row] + columnOffset[column]];
+		float lowerRight = samples[rowOffset[row + 1] + columnOffset[column + 1]];
+		float thirdHeight = lower ? samples[rowOffset[row + 1] + columnOffset[column]] : samples[rowOffset[row] + columnOffset[column + 1]];
+
+		float yComplement = 1.0f - yRemainder;
+		float alpha = lower ? yRemainder : yComplement;
+		float beta = xRemainder * (lower ? yComplement : yRemainder);
+		float gamma = 1.0f - alpha - beta;
+		height[point] = alpha * upperLeft + beta * lowerRight + gamma * thirdHeight;
+		} // per point
+	} // getHeights()
+
+// batch version of getNormal()
+void Terrain::getNormals(const float *x, const float *y, float *normalX, float *normalY, float *normalZ, int count)
+	{ // getNormals()
+	if (heights.Empty() || faceNormals == NULL)
+		{ // no data
+		std::fill(normalX, normalX + count, 0.0f);
+		std::fill(normalY, normalY + count, 0.0f);
+		std::fill(normalZ, normalZ + count, 1.0f);
+		return;
+		} // no data
+
+	GridFrame frame = MakeGridFrame(heights.Rows(), heights.Columns(), xyScale);
+	const float *normalData = &faceNormals[0].x;
+
+	int point = 0;
+#if defined(__AVX2__)
+	__m256 originX = _mm256_set1_ps(frame.originX), originY = _mm256_set1_ps(frame.originY);
+	__m256 flip = _mm256_set1_ps(frame.flip), scale = _mm256_set1_ps(frame.scale);
+	__m256 maxX = _mm256_set1_ps(frame.maxX), maxY = _mm256_set1_ps(frame.maxY);
+	__m256i maxColumn = _mm256_set1_epi32(frame.maxColumn), maxRow = _mm256_set1_epi32(frame.maxRow);
+	__m256i squaresPerRow = _mm256_set1_epi32(frame.squaresPerRow);
+	__m256i one = _mm256_set1_epi32(1);
+	for (; point + 8 <= count; point += 8)
+		{ // eight at a time
+		__m256i column, row;
+		__m256 xRemainder, yRemainder;
+		LocateOnGrid8(_mm256_add_ps(_mm256_loadu_ps(x + point), originX), scale, maxX, maxColumn, column, xRemainder);
+		LocateOnGrid8(_mm256_sub_ps(flip, _mm256_add_ps(_mm256_loadu_ps(y + point), originY)), scale, maxY, maxRow, row, yRemainder);
+
+		// face 2 * square for the UR triangle, one more for the LL
+		__m256i lower = _mm256_castps_si256(_mm256_cmp_ps(xRemainder, yRemainder, _CMP_LT_OQ));
+		__m256i square = _mm256_add_epi32(_mm256_mullo_epi32(row, squaresPerRow), column);
+		__m256i face = _mm256_add_epi32(_mm256_add_epi32(square, square), _mm256_and_si256(lower, one));
+
+		// three floats per normal
+		__m256i base = _mm256_add_epi32(face, _mm256_add_epi32(face, face));
+		_mm256_storeu_ps(normalX + point, _mm256_i32gather_ps(normalData, base, 4));
+		_mm256_storeu_ps(normalY + point, _mm256_i32gather_ps(normalData + 1, base, 4));
+		_mm256_storeu_ps(normalZ + point, _mm256_i32gather_ps(normalData + 2, base, 4));
+		} // eight at a time
+#endif
+	// scalar tail
+	for (; point < count; point++)
+		{ // per point
+		int column, row;
+		float xRemainder, yRemainder;
+		LocateOnGrid(x[point] + frame.originX, frame.scale, frame.maxX, frame.maxColumn, column, xRemainder);
+		LocateOnGrid(frame.flip - (y[point] + frame.originY), frame.scale, frame.maxY, frame.maxRow, row, yRemainder);
+
+		int face = 2 * (row * frame.squaresPerRow + column) + (xRemainder < yRemainder ? 1 : 0);
+		normalX[point] = faceNormals[face].x;
+		normalY[point] = faceNormals[face].y;
+		normalZ[point] = faceNormals[face].z;
+		} // per point
+	} // getNormals()
+
+// sweep a ball from start to end against the terrain
+bool Terrain::SweepSphere(const Cartesian3 &start, const Cartesian3 &end, float radius, float &timeOfImpact, Cartesian3 &normal)
+	{ // SweepSphere()
+	// retrieve the number of rows and columns of the data
+	long nRows = GridRows(), nColumns = GridColumns();
+	if (nRows == 0 || nColumns == 0)
+		return false;
+
+	// convert both ends to fractional (column, row) grid coordinates, as in getHeight()
+	float originX = (nColumns / 2) * xyScale;
+	float originY = (nRows / 2) * xyScale;
+	float totalHeight = GridFlip(nRows);
+	float startColumn = (start.x + originX) / xyScale;
+	float startRow = (totalHeight - (start.y + originY)) / xyScale;
+	float deltaColumn = (end.x + originX) / xyScale - startColumn;
+	float deltaRow = (totalHeight - (end.y + originY)) / xyScale - startRow;
+
+	// clip the motion to the grid, staying just inside the last row and column
+	float tMin = 0.0, tMax = 1.0;
+	float limits[2] = { (float) (nColumns - 1) - 1.0e-3f, (float) (nRows - 1) - 1.0e-3f };
+	float origins[2] = { startColumn, startRow };
+	float deltas[2] = { deltaColumn, deltaRow };
+	for (int axis = 0; axis < 2; axis++)
+		{ // per axis
+		if (fabs(deltas[axis]) < 1.0e-12)
+			{ // parallel to the slab
+			if (origins[axis] < 0.0 || origins[axis] > limits[axis])
+				return false;
+			continue;
+			} // parallel to the slab
+		float t0 = (0.0 - origins[axis]) / deltas[axis];
+		float t1 = (limits[axis] - origins[axis]) / deltas[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		} // per axis
+	if (tMin > tMax)
+		return false;
+
+	// a motion that stays above everything beneath it can't touch
+	Cartesian3 lower(std::min(start.x, end.x), std::min(start.y, end.y), std::min(start.z, end.z) - radius);
+	Cartesian3 upper(std::max(start.x, end.x), std::max(start.y, end.y), std::max(start.z, end.z) + radius);
+	if (BoxClear(lower, upper))
+		return false;
+
+	// within each triangle getHeight() is a polynomial of degree two in the cell
+	// remainders, and the motion is linear, so the clearance above the surface
+	// is a quadratic in t between the points where the path crosses a grid line
+	// (integer column or row) or a diagonal (integer column - row).  It is not
+	// continuous across those lines, so each piece is fitted from its interior.
+	// A long motion is walked in windows that cross at most maxLines lines of
+	// each family, so that the breaks between pieces fit on the stack
+	const int maxLines = 16;
+	float breaks[2 + 3 * maxLines];
+	float deltaDiagonal = deltaColumn - deltaRow;
+	float lines[3][2] = { { startColumn, deltaColumn }, { startRow, deltaRow }, { startColumn - startRow, deltaDiagonal } };
+	float fastest = std::max(fabs(deltaColumn), std::max(fabs(deltaRow), fabs(deltaDiagonal)));
+	float window = fastest > 0.0 ? (maxLines - 1) / fastest : tMax - tMin;
+
+	Cartesian3 motion = end - start;
+
+	// the ball may already be touching where it enters the grid
+	Cartesian3 entry = start + motion * tMin;
+	if (entry.z - radius - getHeight(entry.x, entry.y) <= 0.0)
+		{ // touching at the start
+		timeOfImpact = tMin;
+		normal = getNormal(entry.x, entry.y);
+		return true;
+		} // touching at the start
+
+	for (float windowStart = tMin, windowEnd; windowStart < tMax; windowStart = windowEnd)
+		{ // per window
+		windowEnd = std::min(tMax, windowStart + window);
+		int nBreaks = 0;
+		breaks[nBreaks++] = windowStart;
+		breaks[nBreaks++] = windowEnd;
+		for (int family = 0; family < 3; family++)
+			{ // per family of lines
+			float origin = lines[family][0], delta = lines[family][1];
+			if (fabs(delta) < 1.0e-12)
+				continue;
+			float first = origin + delta * windowStart, last = origin + delta * windowEnd;
+			float low = std::min(first, last), high = std::max(first, last);
+			int nLines = 0;
+			for (float line = ceil(low); line <= high && nLines < maxLines; line += 1.0, nLines++)
+				breaks[nBreaks++] = (line - origin) / delta;
+			} // per family of lines
+		std::sort(breaks, breaks + nBreaks);
+
+		// now walk the pieces in order, looking for the first point of zero clearance
+		for (int piece = 1; piece < nBreaks; piece++)
+			{ // per piece
+			float t0 = breaks[piece - 1], t1 = breaks[piece];
+			if (t1 <= t0)
+				continue;
+
+			// sample at the quarter points, all strictly inside one triangle
+			float samples[3];
+			Cartesian3 middle;
+			for (int sample = 0; sample < 3; sample++)
+				{ // per sample
+				Cartesian3 point = start + motion * (t0 + (t1 - t0) * 0.25 * (sample + 1));
+				samples[sample] = point.z - radius - getHeight(point.x, point.y);
+				if (sample == 1)
+					middle = point;
+				} // per sample
+
+			// c(u) = A u^2 + B u + C, with u = -1, 0, 1 at the samples and -2, 2 at the ends
+			float A = 0.5 * (samples[0] + samples[2]) - samples[1];
+			float B = 0.5 * (samples[2] - samples[0]);
+			float C = samples[1];
+
+			// the first u in [-2, 2] at which the clearance reaches zero, if any
+			float hit = 3.0;
+			if (4.0 * A - 2.0 * B + C <= 0.0)
+				hit = -2.0;
+			else if (fabs(A) < 1.0e-6 * (fabs(B) + fabs(C)))
+				{ // effectively linear
+				if (B < 0.0)
+					hit = -C / B;
+				} // effectively linear
+			else
+				{ // quadratic
+				float discriminant = B * B - 4.0 * A * C;
+				if (discriminant >= 0.0)
+					{ // real roots
+					float root = sqrt(discriminant);
+					float u0 = (-B - root) / (2.0 * A), u1 = (-B + root) / (2.0 * A);
+					if (u0 > u1)
+						std::swap(u0, u1);
+					hit = (u0 >= -2.0) ? u0 : u1;
+					} // real roots
+				} // quadratic
+
+			if (hit >= -2.0 && hit <= 2.0)
+				{ // reached the surface in this piece
+				timeOfImpact = t0 + (t1 - t0) * 0.25 * (hit + 2.0);
+				// the middle of the piece is safely inside the triangle that was hit
+				normal = getNormal(middle.x, middle.y);
+				return true;
+				} // reached the surface in this piece
+			} // per piece
+		} // per window
+
+	return false;
+	} // SweepSphere()
+
+// the heights at the corners of a square
+void Terrain::SquareCorners(long row, long column, float &upperLeft, float &upperRight, float &lowerLeft, float &lowerRight)
+	{ // SquareCorners()
+	upperLeft = heights.At(row, column);
+	upperRight = heights.At(row, column + 1);
+	lowerLeft = heights.At(row + 1, column);
+	lowerRight = heights.At(row + 1, column + 1);
+	} // SquareCorners()
+
+// clip a grid ray to the block of squares with rows [firstRow, lastRow) and columns [firstColumn, lastColumn)
+// (in grid coordinates), narrowing [tEnter, tExit]; false if it misses
+static bool ClipToBlock(float row, float column, float dRow, float dColumn, float firstRow, float firstColumn, float lastRow, float lastColumn, float &tEnter, float &tExit)
+	{ // ClipToBlock()
+	// a little slack, so that a hit on the edge between blocks isn't lost to rounding
+	const float slack = 1.0e-4;
+	float origins[2] = { row, column }, deltas[2] = { dRow, dColumn };
+	float lows[2] = { firstRow - slack, firstColumn - slack }, highs[2] = { lastRow + slack, lastColumn + slack };
+	for (int axis = 0; axis < 2; axis++)
+		{ // per axis
+		if (fabs(deltas[axis]) < 1.0e-12)
+			{ // parallel to the slab
+			if (origins[axis] < lows[axis] || origins[axis] > highs[axis])
+				return false;
+			continue;
+			} // parallel to the slab
+		float t0 = (lows[axis] - origins[axis]) / deltas[axis];
+		float t1 = (highs[axis] - origins[axis]) / deltas[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tEnter = std::max(tEnter, t0);
+		tExit = std::min(tExit, t1);
+		} // per axis
+	return tEnter <= tExit;
+	} // ClipToBlock()
+
+// find where a ray first meets the terrain
+bool Terrain::Raycast(const Cartesian3 &origin, const Cartesian3 &direction, float maxT, TerrainHit &hit)
+	{ // Raycast()
+	hit.face = -1;
+	hit.t = maxT;
+	long nRows = GridRows(), nColumns = GridColumns();
+	if (nRows < 2 || nColumns < 2)
+		return false;
+
+	// convert to grid coordinates, as in getHeight()
+	GridRay ray;
+	ray.origin = origin;
+	ray.direction = direction;
+	float originX = (nColumns / 2) * xyScale;
+	float originY = (nRows / 2) * xyScale;
+	float totalHeight = GridFlip(nRows);
+	ray.column = (origin.x + originX) / xyScale;
+	ray.row = (totalHeight - (origin.y + originY)) / xyScale;
+	ray.dColumn = direction.x / xyScale;
+	ray.dRow = -direction.y / xyScale;
+
+	float tEnter = 0.0, tExit = maxT;
+	if (!ClipToBlock(ray.row, ray.column, ray.dRow, ray.dColumn, 0.0, 0.0, nRows - 1, nColumns - 1, tEnter, tExit))
+		return false;
+
+	// without a pyramid, every square along the way is tried
+	if (pyramid.Empty())
+		RaycastSquares(ray, 0, 0, nRows - 2, nColumns - 2, tEnter, tExit, hit);
+	else
+		RaycastCells(ray, (int) pyramid.levels.size() - 1, 0, 0, 0, 0, tEnter, tExit, hit);
+	if (hit.face < 0)
+		return false;
+	hit.point = origin + direction * hit.t;
+	return true;
+	} // Raycast()
+
+// cast a batch of rays
+int Terrain::Raycast(const Cartesian3 *origins, const Cartesian3 *directions, int count, float maxT, TerrainHit *hits)
+	{ // Raycast()
+	std::atomic<int> nHits(0);
+	auto castRange = [&](int begin, int end)
+		{ // castRange()
+		int rangeHits = 0;
+		for (int ray = begin; ray < end; ray++)
+			if (Raycast(origins[ray], directions[ray], maxT, hits[ray]))
+				rangeHits++;
+		nHits += rangeHits;
+		}; // castRange()
+
+	// rays vary a lot in cost, so the chunks are small enough to balance
+	const int raysPerJob = 256;
+	if (jobSystem != NULL)
+		jobSystem->ParallelFor(count, raysPerJob, castRange);
+	else
+		castRange(0, count);
+	return nHits;
+	} // Raycast()
+
+// a 2D DDA, visiting the cells of a block in the order a line crosses them
+struct GridWalk
+	{ // struct GridWalk
+	long row, column, stepRow, stepColumn;
+	// the t at which the line next crosses a row line and a column line, and
+	// the t between successive crossings
+	float tNextRow, tNextColumn, tDeltaRow, tDeltaColumn;
+
+	// start at tEnter on the line (row + dRow t, column + dColumn t), in cell units
+	GridWalk(float row0, float column0, float dRow, float dColumn, float tEnter, long firstRow, long firstColumn, long lastRow, long lastColumn)
+		{ // constructor
+		const float never = 1.0e30;
+		row = std::min(lastRow, std::max(firstRow, (long) floor(row0 + dRow * tEnter)));
+		column = std::min(lastColumn, std::max(firstColumn, (long) floor(column0 + dColumn * tEnter)));
+		stepRow = dRow > 0.0 ? 1 : -1;
+		stepColumn = dColumn > 0.0 ? 1 : -1;
+		bool rowFixed = fabs(dRow) < 1.0e-12, columnFixed = fabs(dColumn) < 1.0e-12;
+		tDeltaRow = rowFixed ? never : fabs(1.0 / dRow);
+		tDeltaColumn = columnFixed ? never : fabs(1.0 / dColumn);
+		tNextRow = rowFixed ? never : ((row + (stepRow > 0 ? 1 : 0)) - row0) / dRow;
+		tNextColumn = columnFixed ? never : ((column + (stepColumn > 0 ? 1 : 0)) - column0) / dColumn;
+		} // constructor
+
+	// the t at which the line leaves the current cell
+	float Exit() const { return std::min(tNextRow, tNextColumn); }
+
+	// move to the next cell
+	void Step()
+		{ // Step()
+		if (tNextColumn < tNextRow)
+			{ column += stepColumn; tNextColumn += tDeltaColumn; }
+		else
+			{ row += stepRow; tNextRow += tDeltaRow; }
+		} // Step()
+	}; // struct GridWalk
+
+// walk the cells of a level of the pyramid in the order the ray crosses them
+void Terrain::RaycastCells(const GridRay &ray, int level, long firstRow, long firstColumn, long lastRow, long lastColumn, float tEnter, float tExit, TerrainHit &hit)
+	{ // RaycastCells()
+	const HeightPyramid::Level &here = pyramid.levels[level];
+	long cellSquares = pyramid.cellSize << level;
+	GridWalk walk(ray.row / cellSquares, ray.column / cellSquares, ray.dRow / cellSquares, ray.dColumn / cellSquares,
+		tEnter, firstRow, firstColumn, lastRow, lastColumn);
+
+	// a small enough cell is cheaper to walk square by square than to split
+	const long walkSquares = 8;
+	float cellEnter = tEnter;
+	while (true)
+		{ // per cell
+		float cellExit = std::min(walk.Exit(), tExit);
+
+		// the ray can only meet the terrain in here if its height over the cell
+		// overlaps the heights in it
+		float zEnter = ray.origin.z + ray.direction.z * cellEnter;
+		float zExit = ray.origin.z + ray.direction.z * cellExit;
+		long cell = walk.row * here.nColumns + walk.column;
+		if (std::min(zEnter, zExit) <= here.high[cell] && std::max(zEnter, zExit) >= here.low[cell])
+			{ // may hit
+			if (level == 0 || cellSquares <= walkSquares)
+				RaycastSquares(ray, walk.row * cellSquares, walk.column * cellSquares,
+					std::min((walk.row + 1) * cellSquares, pyramid.nSquareRows) - 1, std::min((walk.column + 1) * cellSquares, pyramid.nSquareColumns) - 1,
+					cellEnter, cellExit, hit);
+			else
+				{ // split
+				const HeightPyramid::Level &below = pyramid.levels[level - 1];
+				RaycastCells(ray, level - 1, 2 * walk.row, 2 * walk.column,
+					std::min(2 * walk.row + 1, below.nRows - 1), std::min(2 * walk.column + 1, below.nColumns - 1),
+					cellEnter, cellExit, hit);
+				} // split
+			// the cells are in order, so the first hit is the nearest
+			if (hit.face >= 0)
+				return;
+			} // may hit
+
+		if (walk.Exit() >= tExit)
+			return;
+		cellEnter = cellExit;
+		walk.Step();
+		if (walk.row < firstRow || walk.row > lastRow || walk.column < firstColumn || walk.column > lastColumn)
+			return;
+		} // per cell
+	} // RaycastCells()
+
+// walk a block of squares in the order the ray crosses them
+void Terrain::RaycastSquares(const GridRay &ray, long firstRow, long firstColumn, long lastRow, long lastColumn, float tEnter, float tExit, TerrainHit &hit)
+	{ // RaycastSquares()
+	GridWalk walk(ray.row, ray.column, ray.dRow, ray.dColumn, tEnter, firstRow, firstColumn, lastRow, lastColumn);
+	while (true)
+		{ // per square
+		// the squares are in order, so the first hit is the nearest
+		if (RaycastSquare(ray, walk.row, walk.column, hit))
+			return;
+		if (walk.Exit() >= tExit)
+			return;
+		walk.Step();
+		if (walk.row < firstRow || walk.row > lastRow || walk.column < firstColumn || walk.column > lastColumn)
+			return;
+		} // per square
+	} // RaycastSquares()
+
+// intersect a ray with the two triangles of a square
+bool Terrain::RaycastSquare(const GridRay &ray, long row, long column, TerrainHit &hit)
+	{ // RaycastSquare()
+	float upperLeft, upperRight, lowerLeft, lowerRight;
+	SquareCorners(row, column, upperLeft, upperRight, lowerLeft, lowerRight);
+
+	// in the square, with remainders xr across and yr down as in getHeight(), the
+	// UR triangle (xr >= yr) is the plane UL + xr (UR - UL) + yr (LR - UR) and the
+	// LL triangle is UL + yr (LL - UL) + xr (LR - LL).  Along the ray xr, yr and z
+	// are all linear in t, so the height above each plane is too, and is zero at
+	// a single t.  A little slack on the edges stops a ray along the diagonal or
+	// a square edge slipping between triangles
+	const float slack = 1.0e-4;
+	float xr0 = ray.column - column, yr0 = ray.row - row;
+	float slopes[2][2] = { { upperRight - upperLeft, lowerRight - upperRight }, { lowerRight - lowerLeft, lowerLeft - upperLeft } };
+	bool found = false;
+	for (int triangle = 0; triangle < 2; triangle++)
+		{ // per triangle
+		float acrossSlope = slopes[triangle][0], downSlope = slopes[triangle][1];
+		float above0 = ray.origin.z - upperLeft - xr0 * acrossSlope - yr0 * downSlope;
+		float aboveRate = ray.direction.z - ray.dColumn * acrossSlope - ray.dRow * downSlope;
+		if (fabs(aboveRate) < 1.0e-12)
+			continue;
+		float t = -above0 / aboveRate;
+		if (t < 0.0 || t > hit.t || (t == hit.t && hit.face >= 0))
+			continue;
+
+		// and the point there has to be in the triangle
+		float xr = xr0 + ray.dColumn * t, yr = yr0 + ray.dRow * t;
+		if (xr < -slack || xr > 1.0 + slack || yr < -slack || yr > 1.0 + slack)
+			continue;
+		if (triangle == 0 ? xr < yr - slack : xr > yr + slack)
+			continue;
+
+		hit.t = t;
+		hit.face = 2 * (row * (GridColumns() - 1) + column) + triangle;
+		// -dh/dx, -dh/dy and 1, where y runs against the rows
+		hit.normal = Cartesian3(-acrossSlope / xyScale, downSlope / xyScale, 1.0).unit();
+		found = true;
+		} // per triangle
+	return found;
+	} // RaycastSquare()
@@ -15,33 +15,311 @@
 #define _TERRAIN_H
 
 #include <vector>
+#include <stdint.h>
 
 #include "IndexedFaceSurface.h"
+#include "HeightGrid.h"
+#include "HeightPyramid.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+#include "TerrainPatches.h"
+
+// the header of a binary terrain file (.bdem), which is followed by the samples
+// in the stored layout (padding included), optionally the face normals, and the
+// lowest and highest height over each block of squares
+struct BinaryTerrainHeader
+	{ // struct BinaryTerrainHeader
+	char magic[4];
+	// written as 0x01020304, to catch files from a machine of the other endianness
+	uint32_t byteOrder;
+	uint32_t version;
+	uint32_t nRows, nColumns;
+	uint32_t layout;
+	float xyScale;
+	float minHeight, maxHeight;
+	// 1 if the normals are present
+	uint32_t hasNormals;
+	// squares along the edge of a block of the bounds table
+	uint32_t boundsCellSize;
+	// byte offsets from the start of the file, multiples of 64
+	uint64_t samplesOffset, sampleCount;
+	uint64_t normalsOffset, normalCount;
+	// the bounds table: boundsCount lows, then as many highs, a block each, row-major
+	uint64_t boundsOffset, boundsCount;
+	}; // struct BinaryTerrainHeader
+
+// check that a header is one we can read and that its blocks fit in fileSize bytes
+bool CheckBinaryTerrainHeader(const BinaryTerrainHeader &header, uint64_t fileSize);
+
+// where a ray first meets the terrain
+struct TerrainHit
+	{ // struct TerrainHit
+	// the distance along the ray, in multiples of its direction
+	float t;
+	// the point hit
+	Cartesian3 point;
+	// the triangle hit (two per square, UR then LL, as in faceNormals), or -1 for a miss
+	long face;
+	// the unit normal of that triangle
+	Cartesian3 normal;
+	}; // struct TerrainHit
+
+// a rectangle of samples, rows [firstRow, lastRow] x columns [firstColumn, lastColumn]
+struct TerrainRect
+	{ // struct TerrainRect
+	long firstRow, firstColumn;
+	long lastRow, lastColumn;
+	}; // struct TerrainRect
+
+// the derivatives of the height at a sample, for the smooth samplers
+struct HeightDerivatives
+	{ // struct HeightDerivatives
+	// dh/dx and dh/dy in world units
+	float gradientX, gradientY;
+	// d2h/dxdy, the twist of the bicubic patch
+	float twist;
+	// the unit normal, (-dh/dx, -dh/dy, 1) normalised
+	Cartesian3 normal;
+	}; // struct HeightDerivatives
 
 class Terrain : public IndexedFaceSurface
 	{ // class Terrain
 	public:
-	// array to store the terrain data
-	std::vector<std::vector<float>> heightValues;
+	// the terrain data, in one contiguous (by default tiled) buffer
+	HeightGrid heights;
 	
 	// keep track of the xy scale that we are told about
 	float xyScale;
 
+	// the lowest and highest samples
+	float minHeight, maxHeight;
+
+	// the normal of each triangle (two per square, UR then LL), which is either
+	// the normals array or the normals stored in a mapped binary file
+	const Cartesian3 *faceNormals;
+
+	// the binary file the heights are mapped from, if any
+	MappedFile mappedFile;
+
+	// the lowest and highest height over blocks of squares, built on loading
+	HeightPyramid pyramid;
+
+	// the mesh cut into patches with levels of detail, built when first drawn
+	TerrainPatches patches;
+
+	// the derivatives at each sample, row-major, by central differences
+	// (one-sided at the edges), built on loading
+	std::vector<HeightDerivatives> derivatives;
+
+	// if set, the mesh and its normals are built, and batches of rays cast,
+	// across its threads
+	JobSystem *jobSystem;
+
+	// the samples edited since the patches were last sent them, as rectangles
+	// that don't overlap or touch
+	std::vector<TerrainRect> dirtyRects;
+
+	// the samples edited since whoever watches the terrain (such as the physics,
+	// to wake the bodies on them) last took them and cleared the list
+	std::vector<TerrainRect> editedRects;
+
 	// constructor will initialise to safe values
 	Terrain();
+
+	// subclasses may keep their heights elsewhere (see PagedTerrain)
+	virtual ~Terrain() {}
 	
 	// read routine returns true on success, failure otherwise
 	// xyScale gives the scale factor to use in the x-y directions
-	bool ReadFileTerrainData(const char *fileName, float XYScale);
+	// layout is the order the heights are stored in
+	bool ReadFileTerrainData(const char *fileName, float XYScale, HeightGrid::Layout layout = HeightGrid::Tiled);
+
+	// read a binary terrain (.bdem) by mapping it into memory, so that the heights,
+	// and the normals if it has them, are used where they lie without being copied
+	// the render mesh is then only built the first time it is drawn
+	bool ReadFileBinaryTerrain(const char *fileName);
+
+	// write the terrain as a .bdem file, optionally with the face normals
+	bool WriteFileBinaryTerrain(const char *fileName, bool withNormals = true);
+
+	// build the vertices and triangles of the render mesh from the heights,
+	// a band of rows per job if there is a job system
+	void BuildMesh();
+
+	// render the patches at the levels of detail the current view needs,
+	// building the mesh and the patches first if need be
+	virtual void Render();
+
+	// the size of the grid in samples
+	virtual long GridRows() const { return heights.Rows(); }
+	virtual long GridColumns() const { return heights.Columns(); }
 	
+	// test whether an (x,y) coordinate lies over the terrain grid
+	bool Contains(float x, float y);
+
+	// the lowest and highest terrain under the rectangle [minX, maxX] x [minY, maxY],
+	// from the pyramid; false if the rectangle is off the grid
+	bool HeightRange(float minX, float minY, float maxX, float maxY, float &low, float &high);
+
+	// true if the box from lower to upper is certainly clear of the terrain: above
+	// every height under it, or off the grid.  Large boxes are settled high in the
+	// pyramid, so this is cheap whether the answer is yes or no
+	bool BoxClear(const Cartesian3 &lower, const Cartesian3 &upper);
+
+	// the two triangles of each square under the rectangle [minX, maxX] x [minY, maxY],
+	// as three corners each wound counter-clockwise from above, the UR triangle of a
+	// square first as in the faces of the mesh, squares in row-major order.  At most
+	// maxTriangles are written, starting from triangle firstTriangle, so that a large
+	// rectangle can be taken in chunks; the number under the whole rectangle is returned
+	int TrianglesUnder(float minX, float minY, float maxX, float maxY, Cartesian3 *corners, int maxTriangles, int firstTriangle = 0);
+
+	// true if a ball is certainly clear of the terrain, by the same test as the
+	// contact (centre more than radius above the surface)
+	bool SphereClear(const Cartesian3 &centre, float radius);
+
+	// find where the ray origin + t direction, 0 <= t <= maxT, first meets the
+	// terrain, walking the squares it passes over in order and skipping the
+	// blocks of the pyramid it passes above or below.  Returns false on a miss,
+	// with hit.face set to -1
+	bool Raycast(const Cartesian3 &origin, const Cartesian3 &direction, float maxT, TerrainHit &hit);
+
+	// the same for the segment from start to end, with hit.t the fraction along it
+	bool RaycastSegment(const Cartesian3 &start, const Cartesian3 &end, TerrainHit &hit)
+		{ return Raycast(start, end - start, 1.0, hit); }
+
+	// cast count rays, split across the job system if the terrain has one, and
+	// return the number that hit.  May be called from several threads at once
+	int Raycast(const Cartesian3 *origins, const Cartesian3 *directions, int count, float maxT, TerrainHit *hits);
+
+	// compute the derivative field for the samples in rows [firstRow, lastRow]
+	// and columns [firstColumn, lastColumn] and their neighbours, after loading
+	// or changing them with heights.Set()
+	void UpdateDerivatives(long firstRow, long firstColumn, long lastRow, long lastColumn);
+
+	// bring the pyramid up to date after the samples in rows [firstRow, lastRow]
+	// and columns [firstColumn, lastColumn] have been changed with heights.Set()
+	void UpdatePyramid(long firstRow, long firstColumn, long lastRow, long lastColumn);
+
+	// editing: each edit changes the heights and brings the mesh vertices, the
+	// normals, the pyramid and height range and the derivatives up to date over
+	// the samples it touched, so that an edit costs in proportion to its area and
+	// every query sees it at once.  The samples are also marked dirty, and
+	// UploadEdits() sends the dirty rectangles to the patches that draw them.
+	// A mapped terrain is copied on its first edit, and a paged terrain can't be
+	// edited (these return false)
+	bool SetHeight(long row, long column, float height);
+
+	// lower the ground within radius of (x,y) into a bowl depth deep at the centre
+	bool Crater(float x, float y, float radius, float depth);
+
+	// raise the ground within radius of (x,y) by height at the centre, falling
+	// smoothly to nothing at the edge (a negative height lowers it)
+	bool Stamp(float x, float y, float radius, float height);
+
+	// copy the heights of a mapped terrain and build its mesh, so that it can be
+	// edited; false if the heights are held elsewhere
+	bool MakeEditable();
+
+	// bring everything up to date after samples were changed directly with
+	// heights.Set() (after MakeEditable()), and mark them dirty
+	void MarkDirty(long firstRow, long firstColumn, long lastRow, long lastColumn);
+
+	// update the patches over the dirty rectangles; Render() does this itself
+	void UploadEdits();
+
+	// the world rectangle covered by the squares the samples of rect are corners of
+	void RectBounds(const TerrainRect &rect, float &minX, float &minY, float &maxX, float &maxY);
+
+	// for a terrain that streams its heights in: start a round of requests,
+	// then ask for the heights within radius of each (x[i], y[i]) to be at hand.
+	// The whole of this one is always in memory, so there is nothing to do.
+	// No queries may run during either call
+	virtual void BeginStreaming() {}
+	virtual void StreamAround(const float * /* x */, const float * /* y */, int /* count */, float /* radius */) {}
+
 	// A function to find the height at a known (x,y) coordinate
-	float getHeight(float x, float y);
-	// height but interpolated between the triangles
-	float getHeightBilinear(float x, float y);
+	virtual float getHeight(float x, float y);
 	
 	// A related function to find the normal vector at a given (x,y) coordinate
-	Cartesian3 getNormal(float x, float y); 
-	
+	virtual Cartesian3 getNormal(float x, float y);
+
+	// smooth samplers, which unlike the flat faces have no creases at the
+	// triangle edges, so contacts don't jump as a ball rolls across them.
+	// Bilinear blends the heights and the precomputed sample normals of the
+	// square; bicubic fits a Hermite patch to the heights and the derivative
+	// field, giving a surface whose normal is continuous everywhere, but which
+	// may overshoot the samples a little.  Points off the grid are clamped to it
+	virtual float getHeightBilinear(float x, float y);
+	virtual Cartesian3 getNormalBilinear(float x, float y);
+	virtual float getHeightBicubic(float x, float y);
+	virtual Cartesian3 getNormalBicubic(float x, float y);
+
+	// batch versions of getHeight() and getNormal() for count points (x[i], y[i]),
+	// eight at a time with AVX2 gathers where available.  They agree with the
+	// single-point versions to within rounding, and points off the grid are
+	// clamped to its edge rather than read out of bounds
+	virtual void getHeights(const float *x, const float *y, float *height, int count);
+	virtual void getNormals(const float *x, const float *y, float *normalX, float *normalY, float *normalZ, int count);
+
+	// sweep a ball from start to end, where touching means the centre is within
+	// radius above the surface (the same test as the discrete contact)
+	// returns true on a hit, with the fraction of the way along the motion
+	// at first touch in timeOfImpact and the face normal there in normal
+	bool SweepSphere(const Cartesian3 &start, const Cartesian3 &end, float radius, float &timeOfImpact, Cartesian3 &normal);
+
+	protected:
+	// a ray in grid coordinates (column across, row down, as in getHeight())
+	struct GridRay
+		{ // struct GridRay
+		Cartesian3 origin, direction;
+		float column, row, dColumn, dRow;
+		}; // struct GridRay
+
+	// the heights at the corners of a square
+	virtual void SquareCorners(long row, long column, float &upperLeft, float &upperRight, float &lowerLeft, float &lowerRight);
+
+	// walk the cells [firstRow, lastRow] x [firstColumn, lastColumn] of a level of the
+	// pyramid in the order the ray crosses them in [tEnter, tExit], skipping those it
+	// passes above or below and descending into the rest, until one is hit
+	void RaycastCells(const GridRay &ray, int level, long firstRow, long firstColumn, long lastRow, long lastColumn, float tEnter, float tExit, TerrainHit &hit);
+
+	// walk the squares [firstRow, lastRow] x [firstColumn, lastColumn] in the order the
+	// ray crosses them in [tEnter, tExit], stopping at the first one it hits
+	void RaycastSquares(const GridRay &ray, long firstRow, long firstColumn, long lastRow, long lastColumn, float tEnter, float tExit, TerrainHit &hit);
+
+	// intersect a ray with the two triangles of a square, keeping the hit if it is nearer
+	// returns true if either was hit
+	bool RaycastSquare(const GridRay &ray, long row, long column, TerrainHit &hit);
+
+	// the squares under a rectangle, clamped to the grid; false if it is off the grid
+	bool SquaresUnder(float minX, float minY, float maxX, float maxY, long &firstRow, long &firstColumn, long &lastRow, long &lastColumn);
+
+	// the length of an nRows grid down the map, from which y is flipped into
+	// rows; getHeight() has always truncated it to a whole number, so every
+	// conversion to rows must use this to agree on the square a point is in
+	float GridFlip(long nRows) const { return (float) (long) ((nRows - 1) * xyScale); }
+
+	// find the square of an nRows x nColumns grid that (x,y) lies in, and
+	// the fractional position within it
+	void LocateSquare(float x, float y, long nRows, long nColumns, long &row, long &column, float &xRemainder, float &yRemainder);
+
+	// bring the mesh vertices, normals, pyramid and derivatives up to date over edited samples
+	void UpdateEdited(const TerrainRect &rect);
+
+	// the samples within radius of (x,y), false if there are none
+	bool DiscSamples(float x, float y, float radius, long &firstRow, long &firstColumn, long &lastRow, long &lastColumn);
+
+	// find the square (x,y) lies in as LocateSquare() does, but kept on the grid
+	void ClampedSquare(float x, float y, long &row, long &column, float &xRemainder, float &yRemainder);
+
+	// the Hermite patch over a square at (xRemainder, yRemainder), and its
+	// gradient in world units; the corners are UL, UR, LL, LR
+	void HermitePatch(const float *cornerHeights, const HeightDerivatives *const *cornerDerivatives,
+		float xRemainder, float yRemainder, float &height, float &gradientX, float &gradientY);
+
+	// interpolate the height in a square from its corners, on whichever side
+	// of the diagonal the fractional position lies
+	static float InterpolateSquare(float upperLeft, float upperRight, float lowerLeft, float lowerRight, float xRemainder, float yRemainder);
 	}; // class Terrain
 
 #endif
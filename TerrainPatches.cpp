@@ -0,0 +1,432 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	TerrainPatches.cpp
+//	------------------------
+//
+//	Geomipmapped rendering of a terrain mesh: the
+//	grid is cut into square patches, each with
+//	precomputed triangles at several levels of
+//	detail, chosen per patch by screen-space error
+//	and stitched together along the seams
+//
+///////////////////////////////////////////////////
+
+#include <algorithm>
+#include <math.h>
+
+#include "TerrainPatches.h"
+
+// PHYSICS_HEADLESS builds have no GL, and Render() does nothing
+#ifndef PHYSICS_HEADLESS
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+#endif
+
+// constructor
+TerrainPatches::TerrainPatches()
+	:
+	maxScreenError(2.0),
+	patchRows(0),
+	patchColumns(0),
+	maxLevels(0)
+	{ // constructor
+	} // constructor
+
+// drop the patches
+void TerrainPatches::Clear()
+	{ // Clear()
+	patches.clear();
+	vertexNormals.clear();
+	levels.clear();
+	patchRows = patchColumns = 0;
+	maxLevels = 0;
+	} // Clear()
+
+// the rows (or columns) kept along a patch side at a level
+void TerrainPatches::LevelSamples(long squares, int level, std::vector<long> &samples)
+	{ // LevelSamples()
+	// every 2^level-th, and always the last, so that a patch that isn't a
+	// multiple of the step still reaches its edge
+	samples.clear();
+	for (long sample = 0; sample < squares; sample += 1L << level)
+		samples.push_back(sample);
+	samples.push_back(squares);
+	} // LevelSamples()
+
+// cut the mesh of a grid into patches
+void TerrainPatches::Build(long nRows, long nColumns, const std::vector<Cartesian3> &vertices, const Cartesian3 *faceNormals)
+	{ // Build()
+	Clear();
+	long squareRows = nRows - 1, squareColumns = nColumns - 1;
+	if (squareRows < 1 || squareColumns < 1 || (long) vertices.size() != nRows * nColumns)
+		return;
+
+	// a normal per vertex from the two faces of each square around it
+	vertexNormals.resize(vertices.size());
+	for (long row = 0; row < nRows; row++)
+		for (long column = 0; column < nColumns; column++)
+			vertexNormals[row * nColumns + column] = VertexNormal(row, column, nRows, nColumns, faceNormals);
+
+	// a last patch of a single square would have no inner ring, so it joins the one before
+	long sizes[2] = { squareRows, squareColumns };
+	long counts[2];
+	for (int axis = 0; axis < 2; axis++)
+		{ // per axis
+		counts[axis] = (sizes[axis] + patchSize - 1) / patchSize;
+		if (counts[axis] > 1 && sizes[axis] % patchSize == 1)
+			counts[axis]--;
+		} // per axis
+	patchRows = counts[0];
+	patchColumns = counts[1];
+
+	// size them all first, since the seams need the most levels of any
+	patches.resize(patchRows * patchColumns);
+	for (long patchRow = 0; patchRow < patchRows; patchRow++)
+		for (long patchColumn = 0; patchColumn < patchColumns; patchColumn++)
+			{ // per patch
+			Patch &patch = patches[patchRow * patchColumns + patchColumn];
+			patch.firstRow = patchRow * patchSize;
+			patch.firstColumn = patchColumn * patchSize;
+			patch.nRows = patchRow == patchRows - 1 ? squareRows - patch.firstRow : patchSize;
+			patch.nColumns = patchColumn == patchColumns - 1 ? squareColumns - patch.firstColumn : patchSize;
+
+			// the coarsest level still has a cell inside its outer ring
+			patch.nLevels = 1;
+			while ((1L << patch.nLevels) < std::min(patch.nRows, patch.nColumns))
+				patch.nLevels++;
+			maxLevels = std::max(maxLevels, patch.nLevels);
+			} // per patch
+
+	for (Patch &patch : patches)
+		BuildPatch(patch, nColumns, vertices);
+	levels.assign(patches.size(), 0);
+	} // Build()
+
+// fill in the triangles of a patch
+void TerrainPatches::BuildPatch(Patch &patch, long nColumns, const std::vector<Cartesian3> &vertices)
+	{ // BuildPatch()
+	// the vertex at a row and column of the patch
+	auto vertexID = [&](long row, long column)
+		{ return (unsigned int) ((patch.firstRow + row) * nColumns + patch.firstColumn + column); };
+
+	patch.interior.assign(patch.nLevels, std::vector<unsigned int>());
+	for (int side = 0; side < 4; side++)
+		patch.sides[side].assign(patch.nLevels * maxLevels, std::vector<unsigned int>());
+
+	// a patch only one square across has no ring, and is drawn whole
+	if (patch.nRows < 2 || patch.nColumns < 2)
+		{ // too thin
+		for (long row = 0; row < patch.nRows; row++)
+			for (long column = 0; column < patch.nColumns; column++)
+				{ // per square
+				unsigned int triangles[6] = { vertexID(row, column), vertexID(row + 1, column + 1), vertexID(row, column + 1),
+					vertexID(row, column), vertexID(row + 1, column), vertexID(row + 1, column + 1) };
+				patch.interior[0].insert(patch.interior[0].end(), triangles, triangles + 6);
+				} // per square
+		MeasurePatch(patch, nColumns, vertices);
+		return;
+		} // too thin
+
+	std::vector<long> rows, columns, edge, innerPositions;
+	std::vector<unsigned int> outer, inner;
+	for (int level = 0; level < patch.nLevels; level++)
+		{ // per level
+		LevelSamples(patch.nRows, level, rows);
+		LevelSamples(patch.nColumns, level, columns);
+		long nRowSamples = rows.size(), nColumnSamples = columns.size();
+
+		// the cells inside the outer ring, split on the same diagonal as the full mesh
+		std::vector<unsigned int> &interior = patch.interior[level];
+		for (long row = 1; row < nRowSamples - 2; row++)
+			for (long column = 1; column < nColumnSamples - 2; column++)
+				{ // per cell
+				unsigned int upperLeft = vertexID(rows[row], columns[column]), upperRight = vertexID(rows[row], columns[column + 1]);
+				unsigned int lowerLeft = vertexID(rows[row + 1], columns[column]), lowerRight = vertexID(rows[row + 1], columns[column + 1]);
+				unsigned int triangles[6] = { upperLeft, lowerRight, upperRight, upperLeft, lowerLeft, lowerRight };
+				interior.insert(interior.end(), triangles, triangles + 6);
+				} // per cell
+
+		// and the ring, one side at a time, from the inner ring at this level out
+		// to the edge at this level or any coarser one a neighbour might have
+		for (int edgeLevel = level; edgeLevel < maxLevels; edgeLevel++)
+			for (int side = 0; side < 4; side++)
+				{ // per side
+				bool across = side == Top || side == Bottom;
+				LevelSamples(across ? patch.nColumns : patch.nRows, edgeLevel, edge);
+				const std::vector<long> &innerSamples = across ? columns : rows;
+				long outerLine = side == Top || side == Left ? 0 : (across ? patch.nRows : patch.nColumns);
+				long innerLine = across ? (side == Top ? rows[1] : rows[nRowSamples - 2]) : (side == Left ? columns[1] : columns[nColumnSamples - 2]);
+
+				outer.clear();
+				for (long sample : edge)
+					outer.push_back(across ? vertexID(outerLine, sample) : vertexID(sample, outerLine));
+				inner.clear();
+				innerPositions.assign(innerSamples.begin() + 1, innerSamples.end() - 1);
+				for (long sample : innerPositions)
+					inner.push_back(across ? vertexID(innerLine, sample) : vertexID(sample, innerLine));
+				Zip(outer, edge, inner, innerPositions, vertices, patch.sides[side][level * maxLevels + edgeLevel]);
+				} // per side
+		} // per level
+	MeasurePatch(patch, nColumns, vertices);
+	} // BuildPatch()
+
+// find the box and the errors of the levels of a patch
+void TerrainPatches::MeasurePatch(Patch &patch, long nColumns, const std::vector<Cartesian3> &vertices)
+	{ // MeasurePatch()
+	// the box around it
+	long first = patch.firstRow * nColumns + patch.firstColumn;
+	patch.lower = patch.upper = vertices[first];
+	for (long row = 0; row <= patch.nRows; row++)
+		for (long column = 0; column <= patch.nColumns; column++)
+			{ // per vertex
+			const Cartesian3 &vertex = vertices[first + row * nColumns + column];
+			patch.lower = Cartesian3(std::min(patch.lower.x, vertex.x), std::min(patch.lower.y, vertex.y), std::min(patch.lower.z, vertex.z));
+			patch.upper = Cartesian3(std::max(patch.upper.x, vertex.x), std::max(patch.upper.y, vertex.y), std::max(patch.upper.z, vertex.z));
+			} // per vertex
+
+	// no coarser level may look better than a finer one
+	patch.error.assign(patch.nLevels, 0.0);
+	if (patch.nRows < 2 || patch.nColumns < 2)
+		return;
+	for (int level = 1; level < patch.nLevels; level++)
+		patch.error[level] = std::max(LevelError(patch, level, nColumns, vertices), patch.error[level - 1]);
+	} // MeasurePatch()
+
+// the normal of a vertex from the faces of the squares around it
+Cartesian3 TerrainPatches::VertexNormal(long row, long column, long nRows, long nColumns, const Cartesian3 *faceNormals)
+	{ // VertexNormal()
+	// the vertex is the upper left of one square, the upper right of the one
+	// before, and so on; UL and LR corners touch both faces, the others one
+	long squareColumns = nColumns - 1;
+	Cartesian3 sum(0.0, 0.0, 0.0);
+	if (row < nRows - 1 && column < squareColumns)
+		sum = sum + faceNormals[2 * (row * squareColumns + column)] + faceNormals[2 * (row * squareColumns + column) + 1];
+	if (row < nRows - 1 && column > 0)
+		sum = sum + faceNormals[2 * (row * squareColumns + column - 1)];
+	if (row > 0 && column < squareColumns)
+		sum = sum + faceNormals[2 * ((row - 1) * squareColumns + column) + 1];
+	if (row > 0 && column > 0)
+		sum = sum + faceNormals[2 * ((row - 1) * squareColumns + column - 1)] + faceNormals[2 * ((row - 1) * squareColumns + column - 1) + 1];
+	return sum.unit();
+	} // VertexNormal()
+
+// bring the patches up to date after some vertices have moved
+void TerrainPatches::Update(long firstRow, long firstColumn, long lastRow, long lastColumn, long nRows, long nColumns,
+	const std::vector<Cartesian3> &vertices, const Cartesian3 *faceNormals)
+	{ // Update()
+	if (patches.empty())
+		return;
+
+	// a vertex's normal comes from the faces around it, which its neighbours share
+	long normalFirstRow = std::max(firstRow - 1, 0L), normalLastRow = std::min(lastRow + 1, nRows - 1);
+	long normalFirstColumn = std::max(firstColumn - 1, 0L), normalLastColumn = std::min(lastColumn + 1, nColumns - 1);
+	for (long row = normalFirstRow; row <= normalLastRow; row++)
+		for (long column = normalFirstColumn; column <= normalLastColumn; column++)
+			vertexNormals[row * nColumns + column] = VertexNormal(row, column, nRows, nColumns, faceNormals);
+
+	// and the patches holding a moved vertex, counting those it is the edge of
+	// (the last patch on each axis may run past patchSize)
+	long firstPatchRow = std::min(std::max(firstRow - 1, 0L) / patchSize, patchRows - 1);
+	long lastPatchRow = std::min(lastRow / patchSize, patchRows - 1);
+	long firstPatchColumn = std::min(std::max(firstColumn - 1, 0L) / patchSize, patchColumns - 1);
+	long lastPatchColumn = std::min(lastColumn / patchSize, patchColumns - 1);
+	for (long patchRow = firstPatchRow; patchRow <= lastPatchRow; patchRow++)
+		for (long patchColumn = firstPatchColumn; patchColumn <= lastPatchColumn; patchColumn++)
+			{ // per patch
+			Patch &patch = patches[patchRow * patchColumns + patchColumn];
+			if (patch.firstRow <= lastRow && patch.firstRow + patch.nRows >= firstRow
+					&& patch.firstColumn <= lastColumn && patch.firstColumn + patch.nColumns >= firstColumn)
+				MeasurePatch(patch, nColumns, vertices);
+			} // per patch
+	} // Update()
+
+// the largest height error of a level of a patch
+float TerrainPatches::LevelError(const Patch &patch, int level, long nColumns, const std::vector<Cartesian3> &vertices)
+	{ // LevelError()
+	if (level == 0)
+		return 0.0;
+	std::vector<long> rows, columns;
+	LevelSamples(patch.nRows, level, rows);
+	LevelSamples(patch.nColumns, level, columns);
+	auto height = [&](long row, long column)
+		{ return vertices[(patch.firstRow + row) * nColumns + patch.firstColumn + column].z; };
+
+	// measured against the cells of the level as if there were no ring, which
+	// is close enough to choose by
+	float error = 0.0;
+	long cellRow = 0;
+	for (long row = 0; row <= patch.nRows; row++)
+		{ // per row
+		while (cellRow < (long) rows.size() - 2 && row > rows[cellRow + 1])
+			cellRow++;
+		long cellColumn = 0;
+		for (long column = 0; column <= patch.nColumns; column++)
+			{ // per column
+			while (cellColumn < (long) columns.size() - 2 && column > columns[cellColumn + 1])
+				cellColumn++;
+			long top = rows[cellRow], bottom = rows[cellRow + 1], left = columns[cellColumn], right = columns[cellColumn + 1];
+			float xr = (float) (column - left) / (right - left), yr = (float) (row - top) / (bottom - top);
+			float upperLeft = height(top, left), upperRight = height(top, right);
+			float lowerLeft = height(bottom, left), lowerRight = height(bottom, right);
+			float planar = xr >= yr
+				? upperLeft + xr * (upperRight - upperLeft) + yr * (lowerRight - upperRight)
+				: upperLeft + yr * (lowerLeft - upperLeft) + xr * (lowerRight - lowerLeft);
+			error = std::max(error, (float) fabs(height(row, column) - planar));
+			} // per column
+		} // per row
+	return error;
+	} // LevelError()
+
+// triangulate the strip between two rows of vertices along a side
+void TerrainPatches::Zip(const std::vector<unsigned int> &outer, const std::vector<long> &outerPositions,
+	const std::vector<unsigned int> &inner, const std::vector<long> &innerPositions,
+	const std::vector<Cartesian3> &vertices, std::vector<unsigned int> &triangles)
+	{ // Zip()
+	triangles.clear();
+	size_t o = 0, i = 0;
+	while (o + 1 < outer.size() || i + 1 < inner.size())
+		{ // per triangle
+		// step along whichever row is behind
+		bool stepOuter = i + 1 >= inner.size() || (o + 1 < outer.size() && outerPositions[o + 1] <= innerPositions[i + 1]);
+		unsigned int triangle[3] = { outer[o], stepOuter ? outer[o + 1] : inner[i + 1], inner[i] };
+		if (stepOuter)
+			o++;
+		else
+			i++;
+
+		// the sides run both ways round the patch, so fix the winding here
+		Cartesian3 u = vertices[triangle[1]] - vertices[triangle[0]];
+		Cartesian3 v = vertices[triangle[2]] - vertices[triangle[0]];
+		if (u.x * v.y - u.y * v.x < 0.0)
+			std::swap(triangle[1], triangle[2]);
+		triangles.insert(triangles.end(), triangle, triangle + 3);
+		} // per triangle
+	} // Zip()
+
+// choose the level of each patch for a viewer
+void TerrainPatches::SelectLevels(const Cartesian3 &eye, float pixelScale, const float (*planes)[4])
+	{ // SelectLevels()
+	levels.assign(patches.size(), -1);
+	for (long index = 0; index < (long) patches.size(); index++)
+		{ // per patch
+		const Patch &patch = patches[index];
+
+		// out of view if the box is wholly outside any plane: test the corner
+		// furthest along the plane's normal
+		bool visible = true;
+		for (int plane = 0; planes != NULL && plane < 6 && visible; plane++)
+			{ // per plane
+			const float *p = planes[plane];
+			float x = p[0] >= 0.0 ? patch.upper.x : patch.lower.x;
+			float y = p[1] >= 0.0 ? patch.upper.y : patch.lower.y;
+			float z = p[2] >= 0.0 ? patch.upper.z : patch.lower.z;
+			visible = p[0] * x + p[1] * y + p[2] * z + p[3] >= 0.0;
+			} // per plane
+		if (!visible)
+			continue;
+
+		// the error shrinks with the distance to the nearest point of the box
+		float dx = std::max(std::max(patch.lower.x - eye.x, eye.x - patch.upper.x), 0.0f);
+		float dy = std::max(std::max(patch.lower.y - eye.y, eye.y - patch.upper.y), 0.0f);
+		float dz = std::max(std::max(patch.lower.z - eye.z, eye.z - patch.upper.z), 0.0f);
+		float distance = std::max((float) sqrt(dx * dx + dy * dy + dz * dz), 1.0e-3f);
+
+		// the coarsest level that is good enough
+		int level = patch.nLevels - 1;
+		while (level > 0 && patch.error[level] * pixelScale > maxScreenError * distance)
+			level--;
+		levels[index] = level;
+		} // per patch
+	} // SelectLevels()
+
+// append the triangles of a patch at its chosen level
+void TerrainPatches::AppendPatch(long index, std::vector<unsigned int> &indices) const
+	{ // AppendPatch()
+	int level = levels[index];
+	if (level < 0)
+		return;
+	const Patch &patch = patches[index];
+	indices.insert(indices.end(), patch.interior[level].begin(), patch.interior[level].end());
+
+	long patchRow = index / patchColumns, patchColumn = index % patchColumns;
+	long neighbours[4] =
+		{
+		patchRow > 0 ? index - patchColumns : -1,
+		patchColumn < patchColumns - 1 ? index + 1 : -1,
+		patchRow < patchRows - 1 ? index + patchColumns : -1,
+		patchColumn > 0 ? index - 1 : -1
+		};
+	for (int side = 0; side < 4; side++)
+		{ // per side
+		// both sides of a seam use the coarser level along it, so their vertices match
+		int edgeLevel = level;
+		if (neighbours[side] >= 0)
+			edgeLevel = std::max(edgeLevel, levels[neighbours[side]]);
+		const std::vector<unsigned int> &triangles = patch.sides[side][level * maxLevels + edgeLevel];
+		indices.insert(indices.end(), triangles.begin(), triangles.end());
+		} // per side
+	} // AppendPatch()
+
+// draw the patches in view
+void TerrainPatches::Render(const std::vector<Cartesian3> &vertices)
+	{ // Render()
+#ifndef PHYSICS_HEADLESS
+	if (patches.empty())
+		return;
+
+	// the view comes from whatever matrices are current
+	GLfloat modelView[16], projection[16];
+	GLint viewport[4];
+	glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// the eye is minus the translation, rotated back (the matrices are column-major)
+	Cartesian3 eye;
+	for (int axis = 0; axis < 3; axis++)
+		(&eye.x)[axis] = -(modelView[4 * axis] * modelView[12] + modelView[4 * axis + 1] * modelView[13] + modelView[4 * axis + 2] * modelView[14]);
+
+	// the frustum planes are sums and differences of the rows of projection x modelView
+	float clip[4][4];
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			{ // per entry
+			clip[row][column] = 0.0;
+			for (int k = 0; k < 4; k++)
+				clip[row][column] += projection[4 * k + row] * modelView[4 * column + k];
+			} // per entry
+	float planes[6][4];
+	for (int plane = 0; plane < 6; plane++)
+		for (int column = 0; column < 4; column++)
+			planes[plane][column] = clip[3][column] + (plane % 2 == 0 ? 1.0 : -1.0) * clip[plane / 2][column];
+
+	// a unit at unit distance covers half the viewport height times the focal scale
+	float pixelScale = 0.5 * viewport[3] * projection[5];
+	SelectLevels(eye, pixelScale, planes);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(Cartesian3), &vertices[0].x);
+	glNormalPointer(GL_FLOAT, sizeof(Cartesian3), &vertexNormals[0].x);
+	for (long index = 0; index < (long) patches.size(); index++)
+		{ // per patch
+		if (levels[index] < 0)
+			continue;
+		drawIndices.clear();
+		AppendPatch(index, drawIndices);
+		glDrawElements(GL_TRIANGLES, (GLsizei) drawIndices.size(), GL_UNSIGNED_INT, drawIndices.data());
+		} // per patch
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+#else
+	// nothing is drawn without GL
+	(void) vertices;
+#endif
+	} // Render()
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	TerrainPatches.h
+//	------------------------
+//
+//	Geomipmapped rendering of a terrain mesh: the
+//	grid is cut into square patches, each with
+//	precomputed triangles at several levels of
+//	detail, chosen per patch by screen-space error
+//	and stitched together along the seams
+//
+///////////////////////////////////////////////////
+
+#ifndef _TERRAIN_PATCHES_H
+#define _TERRAIN_PATCHES_H
+
+#include <vector>
+
+#include "Cartesian3.h"
+
+class TerrainPatches
+	{ // class TerrainPatches
+	public:
+	// squares along the edge of a patch (a power of two); a patch at the far
+	// edge of the grid may be smaller, or up to one square larger
+	static const long patchSize = 32;
+
+	// the largest error allowed on screen, in pixels
+	float maxScreenError;
+
+	// the sides of a patch, for its seams
+	enum Side { Top, Right, Bottom, Left };
+
+	// one patch
+	struct Patch
+		{ // struct Patch
+		// the first square, and the number of squares down and across
+		long firstRow, firstColumn;
+		long nRows, nColumns;
+		// number of levels of detail: level l samples every 2^l-th row and column
+		int nLevels;
+		// the corners of the box around the patch
+		Cartesian3 lower, upper;
+		// the largest height error of each level against the full grid
+		std::vector<float> error;
+		// the triangles of each level inside its outer ring of cells
+		std::vector<std::vector<unsigned int> > interior;
+		// the triangles of the outer ring along each side, for each level and each
+		// coarser level of the edge, at [level * maxLevels + edgeLevel]
+		std::vector<std::vector<unsigned int> > sides[4];
+		}; // struct Patch
+
+	// the patches, row-major
+	std::vector<Patch> patches;
+	long patchRows, patchColumns;
+
+	// the most levels any patch has
+	int maxLevels;
+
+	// a normal per vertex, averaged from the faces around it, since the
+	// triangles of a coarse level don't match the faces of the full mesh
+	std::vector<Cartesian3> vertexNormals;
+
+	// the level chosen for each patch by SelectLevels(), or -1 if it is out of view
+	std::vector<int> levels;
+
+	// constructor
+	TerrainPatches();
+
+	// cut the mesh of an nRows x nColumns grid (vertices row-major, two faces per
+	// square as Terrain::BuildMesh() makes them) into patches
+	void Build(long nRows, long nColumns, const std::vector<Cartesian3> &vertices, const Cartesian3 *faceNormals);
+
+	// bring the patches up to date after the heights of the vertices in rows
+	// [firstRow, lastRow] and columns [firstColumn, lastColumn] have changed and
+	// the faces around them have new normals: the vertex normals near them, and
+	// the boxes and errors of the patches they touch.  The triangles don't change
+	void Update(long firstRow, long firstColumn, long lastRow, long lastColumn, long nRows, long nColumns,
+		const std::vector<Cartesian3> &vertices, const Cartesian3 *faceNormals);
+
+	// drop the patches, so that they are rebuilt from a new mesh
+	void Clear();
+	bool Empty() const { return patches.empty(); }
+
+	// choose the level of each patch for a viewer at eye, where pixelScale is the
+	// size in pixels of a unit at unit distance; patches wholly outside the six
+	// planes (ax + by + cz + d >= 0 inside) are culled, unless planes is NULL
+	void SelectLevels(const Cartesian3 &eye, float pixelScale, const float (*planes)[4]);
+
+	// append the triangles of a patch at its chosen level, with each side
+	// stitched to the coarser of its own level and its neighbour's
+	void AppendPatch(long patch, std::vector<unsigned int> &indices) const;
+
+	// draw the patches in view, one call per patch, choosing the levels from
+	// the current GL matrices
+	void Render(const std::vector<Cartesian3> &vertices);
+
+	private:
+	// the rows (or columns) kept along a patch side of length squares at a level,
+	// as offsets from its first
+	static void LevelSamples(long squares, int level, std::vector<long> &samples);
+
+	// fill in the triangles of a patch, nColumns being that of the grid
+	void BuildPatch(Patch &patch, long nColumns, const std::vector<Cartesian3> &vertices);
+
+	// find the box and the errors of the levels of a patch
+	void MeasurePatch(Patch &patch, long nColumns, const std::vector<Cartesian3> &vertices);
+
+	// the normal of a vertex, averaged from the faces of the squares around it
+	static Cartesian3 VertexNormal(long row, long column, long nRows, long nColumns, const Cartesian3 *faceNormals);
+
+	// the largest height error of a level of a patch against the full grid
+	float LevelError(const Patch &patch, int level, long nColumns, const std::vector<Cartesian3> &vertices);
+
+	// triangulate the strip between the outer and inner rows of vertices along a
+	// side, each in order along it, wound counter-clockwise from above
+	static void Zip(const std::vector<unsigned int> &outer, const std::vector<long> &outerPositions,
+		const std::vector<unsigned int> &inner, const std::vector<long> &innerPositions,
+		const std::vector<Cartesian3> &vertices, std::vector<unsigned int> &triangles);
+
+	// scratch for the indices drawn
+	std::vector<unsigned int> drawIndices;
+	}; // class TerrainPatches
+
+#endif
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PhysicsBench.cpp
+//	------------------------
+//
+//	Headless benchmark for the ball simulation: steps
+//	every terrain with every ball model at a range
+//	of body counts and reports the timings as CSV
+//
+///////////////////////////////////////////////////
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "PhysicsWorld.h"
+#include "JobSystem.h"
+#include "Terrain.h"
+#include "PagedTerrain.h"
+#include "IndexedFaceSurface.h"
+
+// the scenes that are timed
+static const char *terrainNames[] = { "flatland", "stripeland", "rollingland" };
+static const char *bodyModelNames[] = { "spheroid", "dodecahedron" };
+
+// settings from the command line
+struct BenchSettings
+	{ // struct BenchSettings
+	std::string modelDirectory;
+	std::vector<int> bodyCounts;
+	int steps;
+	int warmupSteps;
+	int threads;
+	unsigned int seed;
+	std::string outputFileName;
+	// page the terrains from .bdem files instead of loading them whole (0 to load them)
+	long pageSize;
+	long maxResidentPages;
+	// how the balls sample the ground
+	PhysicsWorld::TerrainSampling sampling;
+	// how the balls meet the ground
+	PhysicsWorld::BodyContact contact;
+	}; // struct BenchSettings
+
+// print the usage message
+static void Usage(const char *program)
+	{ // Usage()
+	std::cerr << "Usage: " << program << " [options]" << std::endl
+		<< "  --models <dir>       directory holding the .dem and .face files (./models)" << std::endl
+		<< "  --bodies <n,n,...>   body counts to simulate (100,1000,10000)" << std::endl
+		<< "  --steps <n>          timed steps per run (600)" << std::endl
+		<< "  --warmup <n>         untimed steps before timing (120)" << std::endl
+		<< "  --threads <n>        job system threads, 0 for one per core, 1 for serial (0)" << std::endl
+		<< "  --seed <n>           seed for the starting positions (1)" << std::endl
+		<< "  --output <file>      write the CSV to a file instead of standard output" << std::endl
+		<< "  --paged <size,pages> page the terrains from .bdem files in pages of size x size squares," << std::endl
+		<< "                       keeping at most pages of them, and report the paging on standard error" << std::endl
+		<< "  --sampling <mode>    ground under the balls: face, bilinear or bicubic (face)" << std::endl
+		<< "  --contact <mode>     how the balls meet the ground: sphere, or hull for GJK/EPA (sphere)" << std::endl;
+	} // Usage()
+
+// parse a comma-separated list of body counts
+static bool ParseCounts(const char *text, std::vector<int> &counts)
+	{ // ParseCounts()
+	counts.clear();
+	std::stringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		{ // per item
+		int count = atoi(item.c_str());
+		if (count <= 0)
+			return false;
+		counts.push_back(count);
+		} // per item
+	return !counts.empty();
+	} // ParseCounts()
+
+// drop count balls in layers over the middle of the terrain, spaced so that
+// none start overlapping
+static void SpawnBodies(PhysicsWorld &world, Terrain &terrain, int count, unsigned int seed)
+	{ // SpawnBodies()
+	std::mt19937 random(seed);
+
+	// the usable area, in world units, leaving a margin around the edge
+	float halfWidth = 0.5 * (terrain.GridColumns() - 1) * terrain.xyScale - 4.0 * world.ballRadius;
+	float halfDepth = 0.5 * (terrain.GridRows() - 1) * terrain.xyScale - 4.0 * world.ballRadius;
+	float spacing = 2.5 * world.ballRadius;
+	int perRow = std::max(1, (int) (2.0 * halfWidth / spacing));
+	int perLayer = perRow * std::max(1, (int) (2.0 * halfDepth / spacing));
+
+	for (int body = 0; body < count; body++)
+		{ // per body
+		int layer = body / perLayer;
+		int row = (body % perLayer) / perRow;
+		int column = body % perRow;
+		float x = -halfWidth + (column + 0.5) * spacing;
+		float y = -halfDepth + (row + 0.5) * spacing;
+		float z = terrain.getHeight(x, y) + 2.0 * world.ballRadius + layer * spacing + (random() % 100) * 0.01;
+
+		// a small random spin so that the contact vertex search has work to do
+		Cartesian3 spin((random() % 200) * 0.01 - 1.0, (random() % 200) * 0.01 - 1.0, (random() % 200) * 0.01 - 1.0);
+		world.AddBody(0, Cartesian3(x, y, z), spin);
+		} // per body
+	} // SpawnBodies()
+
+int main(int argc, char **argv)
+	{ // main()
+	BenchSettings settings;
+	settings.modelDirectory = "./models";
+	settings.bodyCounts.push_back(100);
+	settings.bodyCounts.push_back(1000);
+	settings.bodyCounts.push_back(10000);
+	settings.steps = 600;
+	settings.warmupSteps = 120;
+	settings.threads = 0;
+	settings.seed = 1;
+	settings.pageSize = 0;
+	settings.maxResidentPages = 0;
+	settings.sampling = PhysicsWorld::FaceSampling;
+	settings.contact = PhysicsWorld::SphereContact;
+
+	for (int arg = 1; arg < argc; arg++)
+		{ // per argument
+		bool hasValue = arg + 1 < argc;
+		if (strcmp(argv[arg], "--models") == 0 && hasValue)
+			settings.modelDirectory = argv[++arg];
+		else if (strcmp(argv[arg], "--bodies") == 0 && hasValue)
+			{ // body counts
+			if (!ParseCounts(argv[++arg], settings.bodyCounts))
+				{ Usage(argv[0]); return 1; }
+			} // body counts
+		else if (strcmp(argv[arg], "--steps") == 0 && hasValue)
+			settings.steps = std::max(1, atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "--warmup") == 0 && hasValue)
+			settings.warmupSteps = std::max(0, atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "--threads") == 0 && hasValue)
+			settings.threads = std::max(0, atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "--seed") == 0 && hasValue)
+			settings.seed = (unsigned int) strtoul(argv[++arg], NULL, 10);
+		else if (strcmp(argv[arg], "--output") == 0 && hasValue)
+			settings.outputFileName = argv[++arg];
+		else if (strcmp(argv[arg], "--paged") == 0 && hasValue)
+			{ // paging
+			std::vector<int> values;
+			if (!ParseCounts(argv[++arg], values) || values.size() != 2)
+				{ Usage(argv[0]); return 1; }
+			settings.pageSize = values[0];
+			settings.maxResidentPages = values[1];
+			} // paging
+		else if (strcmp(argv[arg], "--sampling") == 0 && hasValue)
+			{ // sampling
+			const char *mode = argv[++arg];
+			if (strcmp(mode, "face") == 0)
+				settings.sampling = PhysicsWorld::FaceSampling;
+			else if (strcmp(mode, "bilinear") == 0)
+				settings.sampling = PhysicsWorld::BilinearSampling;
+			else if (strcmp(mode, "bicubic") == 0)
+				settings.sampling = PhysicsWorld::BicubicSampling;
+			else
+				{ Usage(argv[0]); return 1; }
+			} // sampling
+		else if (strcmp(argv[arg], "--contact") == 0 && hasValue)
+			{ // contact
+			const char *mode = argv[++arg];
+			if (strcmp(mode, "sphere") == 0)
+				settings.contact = PhysicsWorld::SphereContact;
+			else if (strcmp(mode, "hull") == 0)
+				settings.contact = PhysicsWorld::HullContact;
+			else
+				{ Usage(argv[0]); return 1; }
+			} // contact
+		else
+			{ // unknown
+			Usage(argv[0]);
+			return 1;
+			} // unknown
+		} // per argument
+
+	// one pool for loading and every run; a single thread means stepping serially
+	JobSystem jobSystem(settings.threads);
+
+	// load the models once
+	const int nTerrains = sizeof(terrainNames) / sizeof(terrainNames[0]);
+	const int nBodyModels = sizeof(bodyModelNames) / sizeof(bodyModelNames[0]);
+	Terrain wholeTerrains[nTerrains];
+	PagedTerrain pagedTerrains[nTerrains];
+	Terrain *terrains[nTerrains];
+	IndexedFaceSurface bodyModels[nBodyModels];
+	for (int terrain = 0; terrain < nTerrains; terrain++)
+		{ // per terrain
+		std::string fileName = settings.modelDirectory + "/" + terrainNames[terrain] + (settings.pageSize > 0 ? ".bdem" : ".dem");
+		terrains[terrain] = settings.pageSize > 0 ? &pagedTerrains[terrain] : &wholeTerrains[terrain];
+		wholeTerrains[terrain].jobSystem = jobSystem.ThreadCount() > 1 ? &jobSystem : NULL;
+		bool loaded = settings.pageSize > 0
+			? pagedTerrains[terrain].Open(fileName.c_str(), settings.pageSize, settings.maxResidentPages)
+			: wholeTerrains[terrain].ReadFileTerrainData(fileName.c_str(), 3);
+		if (!loaded)
+			{ // failed
+			std::cerr << "Unable to read " << fileName << std::endl;
+			return 1;
+			} // failed
+		} // per terrain
+	for (int model = 0; model < nBodyModels; model++)
+		{ // per model
+		std::string fileName = settings.modelDirectory + "/" + bodyModelNames[model] + ".face";
+		if (!bodyModels[model].ReadFileIndexedFace(fileName.c_str()))
+			{ // failed
+			std::cerr << "Unable to read " << fileName << std::endl;
+			return 1;
+			} // failed
+		} // per model
+
+	std::ofstream outFile;
+	if (!settings.outputFileName.empty())
+		{ // open output
+		outFile.open(settings.outputFileName.c_str());
+		if (!outFile.good())
+			{ // failed
+			std::cerr << "Unable to write " << settings.outputFileName << std::endl;
+			return 1;
+			} // failed
+		} // open output
+	std::ostream &out = settings.outputFileName.empty() ? std::cout : outFile;
+
+	out << "terrain,body_model,bodies,threads,steps,seconds,steps_per_sec,ns_per_body_step,"
+		<< "terrain_contacts_per_step,body_contacts_per_step,awake_bodies" << std::endl;
+
+	for (int terrain = 0; terrain < nTerrains; terrain++)
+		for (int model = 0; model < nBodyModels; model++)
+			for (int count : settings.bodyCounts)
+				{ // per run
+				PhysicsWorld world;
+				world.SetCapacity(count);
+				world.SetTerrain(terrains[terrain]);
+				world.SetBodyModel(&bodyModels[model]);
+				world.jobSystem = jobSystem.ThreadCount() > 1 ? &jobSystem : NULL;
+				world.terrainSampling = settings.sampling;
+				world.bodyContact = settings.contact;
+				SpawnBodies(world, *terrains[terrain], count, settings.seed);
+				PagedTerrain::PageStats startStats = pagedTerrains[terrain].Stats();
+
+				// let the drop settle into its steady state before timing
+				world.Step(settings.warmupSteps);
+
+				long long terrainContacts = 0, bodyContacts = 0;
+				auto startTime = std::chrono::steady_clock::now();
+				for (int step = 0; step < settings.steps; step++)
+					{ // per step
+					world.Step();
+					terrainContacts += world.terrainContactCount;
+					bodyContacts += world.bodyContactCount;
+					} // per step
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+				out << terrainNames[terrain] << "," << bodyModelNames[model] << ","
+					<< count << "," << jobSystem.ThreadCount() << "," << settings.steps << ","
+					<< seconds << "," << settings.steps / seconds << ","
+					<< seconds * 1.0e9 / ((double) settings.steps * count) << ","
+					<< (double) terrainContacts / settings.steps << ","
+					<< (double) bodyContacts / settings.steps << ","
+					<< world.awakeCount << std::endl;
+
+				if (settings.pageSize > 0)
+					{ // paging
+					PagedTerrain::PageStats stats = pagedTerrains[terrain].Stats();
+					std::cerr << terrainNames[terrain] << " " << bodyModelNames[model] << " " << count << ": "
+						<< stats.residentPages << " pages resident, "
+						<< stats.demandLoads - startStats.demandLoads << " demand loads, "
+						<< stats.prefetchLoads - startStats.prefetchLoads << " prefetched, "
+						<< stats.evictions - startStats.evictions << " evicted" << std::endl;
+					} // paging
+				} // per run
+
+	return 0;
+	} // main()
@@ -14,12 +14,30 @@
 #include "AnimationCycleWidget.h"
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
 
 int main(int argc, char **argv)
 { // main()
-    // initialize QT
-    QApplication app(argc, argv);
-
+    // optional arguments for recording and replaying a run:
+    //   --record <file> [--seed <n>]   record keypresses and frame hashes
+    //   --replay <file> [--headless]   play a recording back, headless at full speed
+    const char *recordFile = NULL;
+    const char *replayFile = NULL;
+    unsigned int seed = 1;
+    bool headless = false;
+    for (int arg = 1; arg < argc; arg++)
+    { // per argument
+        if (strcmp(argv[arg], "--record") == 0 && arg + 1 < argc)
+            recordFile = argv[++arg];
+        else if (strcmp(argv[arg], "--replay") == 0 && arg + 1 < argc)
+            replayFile = argv[++arg];
+        else if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc)
+            seed = (unsigned int) strtoul(argv[++arg], NULL, 10);
+        else if (strcmp(argv[arg], "--headless") == 0)
+            headless = true;
+    } // per argument
 
     //	create a window
     try
@@ -27,6 +45,28 @@ int main(int argc, char **argv)
         // we want a single instance of the scene model
         SceneModel theScene;
 
+        if (replayFile != NULL && !theScene.StartReplay(replayFile))
+            return 1;
+        else if (recordFile != NULL)
+            theScene.StartRecording(recordFile, seed);
+
+        if (replayFile != NULL && headless)
+        { // headless replay
+            // no window: update as fast as possible and report
+            auto startTime = std::chrono::steady_clock::now();
+            while (!theScene.ReplayFinished())
+                theScene.Update();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+            std::cout << "Replayed " << theScene.replayFrame << " frames in " << seconds << " s ("
+                      << theScene.replayFrame / seconds << " frames/s), "
+                      << theScene.replayMismatches << " hash mismatches" << std::endl;
+            return theScene.replayMismatches == 0 ? 0 : 1;
+        } // headless replay
+
+        // initialize QT
+        QApplication app(argc, argv);
+
         // create the widget with no parent
         AnimationCycleWidget animationWindow(NULL, &theScene);
 
@@ -37,7 +77,9 @@ int main(int argc, char **argv)
         animationWindow.show();
 
         // set QT running
-        return QApplication::exec();
+        int result = QApplication::exec();
+        theScene.StopRecording();
+        return result;
     } // try block
     catch (std::string errorString)
     { // catch block
@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	DemConvert.cpp
+//	------------------------
+//
+//	Converts a text .dem terrain into the binary
+//	.bdem format that Terrain maps straight into
+//	memory
+//
+///////////////////////////////////////////////////
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#include "Terrain.h"
+
+// print the usage message
+static void Usage(const char *program)
+	{ // Usage()
+	std::cerr << "Usage: " << program << " <input.dem> <output.bdem> [options]" << std::endl
+		<< "  --scale <s>                     xy scale of the grid (3, as the scene uses)" << std::endl
+		<< "  --layout rowmajor|tiled|morton  order of the stored heights (tiled)" << std::endl
+		<< "  --no-normals                    leave out the face normals (smaller file, slower load)" << std::endl;
+	} // Usage()
+
+int main(int argc, char **argv)
+	{ // main()
+	if (argc < 3)
+		{ Usage(argv[0]); return 1; }
+
+	const char *inputName = argv[1];
+	const char *outputName = argv[2];
+	float scale = 3.0;
+	HeightGrid::Layout layout = HeightGrid::Tiled;
+	bool withNormals = true;
+
+	for (int arg = 3; arg < argc; arg++)
+		{ // per argument
+		if (strcmp(argv[arg], "--scale") == 0 && arg + 1 < argc)
+			scale = (float) atof(argv[++arg]);
+		else if (strcmp(argv[arg], "--layout") == 0 && arg + 1 < argc)
+			{ // layout
+			const char *name = argv[++arg];
+			if (strcmp(name, "rowmajor") == 0)
+				layout = HeightGrid::RowMajor;
+			else if (strcmp(name, "tiled") == 0)
+				layout = HeightGrid::Tiled;
+			else if (strcmp(name, "morton") == 0)
+				layout = HeightGrid::Morton;
+			else
+				{ Usage(argv[0]); return 1; }
+			} // layout
+		else if (strcmp(argv[arg], "--no-normals") == 0)
+			withNormals = false;
+		else
+			{ Usage(argv[0]); return 1; }
+		} // per argument
+
+	// build the mesh (for the normals) on every core
+	JobSystem jobSystem;
+	Terrain terrain;
+	terrain.jobSystem = &jobSystem;
+	if (!terrain.ReadFileTerrainData(inputName, scale, layout) || terrain.heights.Empty())
+		{ // failed
+		std::cerr << "Unable to read " << inputName << std::endl;
+		return 1;
+		} // failed
+
+	if (!terrain.WriteFileBinaryTerrain(outputName, withNormals))
+		{ // failed
+		std::cerr << "Unable to write " << outputName << std::endl;
+		return 1;
+		} // failed
+
+	std::cout << inputName << ": " << terrain.heights.Rows() << " x " << terrain.heights.Columns()
+		<< ", heights " << terrain.minHeight << " to " << terrain.maxHeight << " -> " << outputName << std::endl;
+	return 0;
+	} // main()
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	FaceConvert.cpp
+//	------------------------
+//
+//	Converts text .face meshes into the binary
+//	.bface format that is mapped and copied in
+//	without parsing
+//
+///////////////////////////////////////////////////
+
+#include <iostream>
+#include <string>
+
+#include "IndexedFaceSurface.h"
+#include "MeshOptimizer.h"
+
+// print the usage message
+static void Usage(const char *program)
+	{ // Usage()
+	std::cerr << "Usage: " << program << " <input.face> <output.bface>" << std::endl
+		<< "       " << program << " <input.face>...   (each written beside it as .bface)" << std::endl;
+	} // Usage()
+
+// the indices of the mesh as drawn, whichever width they are held in
+static std::vector<unsigned int> RenderIndices(const IndexedFaceSurface &mesh)
+	{ // RenderIndices()
+	if (!mesh.renderShortIndices.empty())
+		return std::vector<unsigned int>(mesh.renderShortIndices.begin(), mesh.renderShortIndices.end());
+	return mesh.renderIndices;
+	} // RenderIndices()
+
+// report how the mesh as drawn uses the vertex cache in file order and once optimized
+static void ReportVertexCache(IndexedFaceSurface &mesh)
+	{ // ReportVertexCache()
+	mesh.BuildRenderMesh(false);
+	float before = MeshOptimizer::ACMR(RenderIndices(mesh), (long) mesh.renderVertices.size());
+	mesh.BuildRenderMesh();
+	float after = MeshOptimizer::ACMR(RenderIndices(mesh), (long) mesh.renderVertices.size());
+	long indexBytes = mesh.renderShortIndices.empty() ? 4 : 2;
+	std::cout << "  drawn as " << mesh.renderVertices.size() << " corners: ACMR " << before << " -> " << after
+		<< ", indices " << mesh.RenderIndexCount() * 4 << " -> "
+		<< mesh.RenderIndexCount() * indexBytes << " bytes" << std::endl;
+	} // ReportVertexCache()
+
+// convert one mesh
+static bool Convert(const std::string &inputName, const std::string &outputName)
+	{ // Convert()
+	IndexedFaceSurface mesh;
+	if (!mesh.ReadFileIndexedFace(inputName.c_str()))
+		{ // failed
+		std::cerr << "Unable to read " << inputName << std::endl;
+		return false;
+		} // failed
+	// the faces in cache order, so that anything indexing the vertices benefits
+	std::vector<unsigned int> fileOrder(mesh.faceVertices.begin(), mesh.faceVertices.end());
+	float fileACMR = MeshOptimizer::ACMR(fileOrder, (long) mesh.vertices.size());
+	mesh.OptimizeFaceOrder();
+	std::vector<unsigned int> cacheOrder(mesh.faceVertices.begin(), mesh.faceVertices.end());
+	float cacheACMR = MeshOptimizer::ACMR(cacheOrder, (long) mesh.vertices.size());
+
+	if (!mesh.WriteFileBinaryMesh(outputName.c_str()))
+		{ // failed
+		std::cerr << "Unable to write " << outputName << std::endl;
+		return false;
+		} // failed
+	std::cout << inputName << ": " << mesh.vertices.size() << " vertices, " << mesh.normals.size()
+		<< " faces -> " << outputName << std::endl;
+	std::cout << "  faces: ACMR " << fileACMR << " -> " << cacheACMR << " (cache of " << MeshOptimizer::cacheSize << ")" << std::endl;
+	ReportVertexCache(mesh);
+	return true;
+	} // Convert()
+
+int main(int argc, char **argv)
+	{ // main()
+	if (argc < 2)
+		{ Usage(argv[0]); return 1; }
+
+	// an explicit output name, or many inputs converted in place
+	std::string second = argc == 3 ? argv[2] : "";
+	if (argc == 3 && second.size() > 6 && second.compare(second.size() - 6, 6, ".bface") == 0)
+		return Convert(argv[1], second) ? 0 : 1;
+
+	bool allConverted = true;
+	for (int arg = 1; arg < argc; arg++)
+		{ // per input
+		std::string inputName = argv[arg];
+		std::string baseName = inputName.size() > 5 && inputName.compare(inputName.size() - 5, 5, ".face") == 0
+			? inputName.substr(0, inputName.size() - 5) : inputName;
+		allConverted = Convert(inputName, baseName + ".bface") && allConverted;
+		} // per input
+	return allConverted ? 0 : 1;
+	} // main()